@@ -0,0 +1,377 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#include "breakpoints.h"
+#include "rv32i_hart.h"
+#include <cctype>
+#include <sstream>
+
+constexpr size_t breakpoints::max_depth;
+
+/**
+ * add() parses a -b argument and sets the breakpoint.
+ *
+ * The argument is a hex pc, optionally followed by ':' and a condition:
+ *
+ *     cond    := and ('||' and)*
+ *     and     := compare ('&&' compare)*
+ *     compare := sum [('=='|'!='|'<'|'<='|'>'|'>=') sum]
+ *     sum     := operand (('+'|'-') operand)*
+ *     operand := ['-'] (number | register | 'pc' | ('m8'|'m16'|'m32') '(' sum ')' | '(' cond ')')
+ *
+ * Registers are x0-x31 or their ABI names. Numbers are decimal or 0x hex.
+ * Comparisons are signed. A bare sum is true if it is not zero.
+ *
+ * @param spec The breakpoint, e.g. "1a4" or "0x1a4:a0==3&&m8(s0+1)!=0".
+ * @param error Set to a message when the spec cannot be parsed.
+ *
+ * @return false if the spec is not valid.
+ *
+ ********************************************************************************/
+
+bool breakpoints::add(const std::string &spec, std::string &error)
+{
+    size_t colon = spec.find(':');
+    std::string addr = spec.substr(0, colon);
+
+    std::istringstream iss(addr);
+    uint32_t pc;
+    if (!(iss >> std::hex >> pc) || !iss.eof() || (pc & 1))
+    {
+        error = "bad breakpoint address '" + addr + "'";
+        return false;
+    }
+
+    program p;
+    if (colon != std::string::npos)
+    {
+        compiler c(spec.substr(colon+1));
+        if (!c.compile(p, error))
+            return false;
+    }
+
+    uint32_t i = pc >> 1;
+    if ((i >> 6) >= bitmap.size())
+        bitmap.resize((i >> 6) + 1, 0);
+    bitmap[i >> 6] |= uint64_t(1) << (i & 63);
+
+    conds[pc].push_back(p);
+    return true;
+}
+
+/**
+ * check() decides whether execution should stop at a marked pc.
+ *
+ * @return true if any breakpoint at pc is unconditional or its condition holds.
+ *
+ ********************************************************************************/
+
+bool breakpoints::check(uint32_t pc, const rv32i_hart &hart, const memory &mem) const
+{
+    auto it = conds.find(pc);
+    if (it == conds.end())
+        return false;
+
+    for (const program &p : it->second)
+    {
+        if (p.empty() || eval(p, pc, hart, mem))
+            return true;
+    }
+    return false;
+}
+
+/**
+ * eval() runs a compiled condition on a small value stack.
+ *
+ * The compiler rejects conditions that need more than max_depth values,
+ * so the stack is a fixed array and a hit allocates nothing.
+ *
+ ********************************************************************************/
+
+bool breakpoints::eval(const program &p, uint32_t pc, const rv32i_hart &hart, const memory &mem)
+{
+    int32_t stack[max_depth];
+    size_t sp = 0;
+
+    for (const op &o : p)
+    {
+        if (o.code == op_const)
+        {
+            stack[sp++] = o.arg;
+            continue;
+        }
+        if (o.code == op_reg)
+        {
+            stack[sp++] = hart.get_reg(o.arg);
+            continue;
+        }
+        if (o.code == op_pc)
+        {
+            stack[sp++] = pc;
+            continue;
+        }
+
+        int32_t &top = stack[sp-1];
+        switch (o.code)
+        {
+        case op_load8: top = mem.peek8(top); continue;
+        case op_load16: top = mem.peek16(top); continue;
+        case op_load32: top = mem.peek32(top); continue;
+        default: break;
+        }
+
+        int32_t rhs = stack[--sp];
+        int32_t &lhs = stack[sp-1];
+
+        switch (o.code)
+        {
+        case op_add: lhs = uint32_t(lhs) + uint32_t(rhs); break;
+        case op_sub: lhs = uint32_t(lhs) - uint32_t(rhs); break;
+        case op_eq: lhs = lhs == rhs; break;
+        case op_ne: lhs = lhs != rhs; break;
+        case op_lt: lhs = lhs < rhs; break;
+        case op_le: lhs = lhs <= rhs; break;
+        case op_gt: lhs = lhs > rhs; break;
+        case op_ge: lhs = lhs >= rhs; break;
+        case op_and: lhs = lhs && rhs; break;
+        case op_or: lhs = lhs || rhs; break;
+        default: break;
+        }
+    }
+
+    return stack[sp-1] != 0;
+}
+
+/**
+ * compile() parses a condition into p and checks that eval() can run it.
+ *
+ * @return false if the condition is not valid or needs more than
+ *         max_depth values on the stack.
+ *
+ ********************************************************************************/
+
+bool breakpoints::compiler::compile(program &p, std::string &error)
+{
+    if (!parse_or(p) || (skip_space(), pos != src.size()))
+    {
+        error = "bad breakpoint condition '" + src + "'" + (err.empty() ? "" : ": " + err);
+        return false;
+    }
+
+    size_t depth = 0;
+    for (const op &o : p)
+    {
+        if (o.code == op_const || o.code == op_reg || o.code == op_pc)
+        {
+            if (++depth > max_depth)
+            {
+                error = "breakpoint condition '" + src + "' is nested too deeply";
+                return false;
+            }
+        }
+        else if (o.code != op_load8 && o.code != op_load16 && o.code != op_load32)
+        {
+            --depth;
+        }
+    }
+    return true;
+}
+
+bool breakpoints::compiler::parse_or(program &p)
+{
+    if (!parse_and(p))
+        return false;
+    while (accept("||"))
+    {
+        if (!parse_and(p))
+            return false;
+        p.push_back({ op_or, 0 });
+    }
+    return true;
+}
+
+bool breakpoints::compiler::parse_and(program &p)
+{
+    if (!parse_compare(p))
+        return false;
+    while (accept("&&"))
+    {
+        if (!parse_compare(p))
+            return false;
+        p.push_back({ op_and, 0 });
+    }
+    return true;
+}
+
+bool breakpoints::compiler::parse_compare(program &p)
+{
+    if (!parse_sum(p))
+        return false;
+
+    // longer operators first so that "<=" is not taken as "<"
+    static const std::pair<const char*, opcode> ops[] =
+    {
+        { "==", op_eq }, { "!=", op_ne }, { "<=", op_le }, { ">=", op_ge }, { "<", op_lt }, { ">", op_gt }
+    };
+
+    for (const auto &o : ops)
+    {
+        if (accept(o.first))
+        {
+            if (!parse_sum(p))
+                return false;
+            p.push_back({ o.second, 0 });
+            return true;
+        }
+    }
+    return true;
+}
+
+bool breakpoints::compiler::parse_sum(program &p)
+{
+    if (!parse_operand(p))
+        return false;
+    while (true)
+    {
+        opcode code;
+        if (accept("+"))
+            code = op_add;
+        else if (accept("-"))
+            code = op_sub;
+        else
+            return true;
+
+        if (!parse_operand(p))
+            return false;
+        p.push_back({ code, 0 });
+    }
+}
+
+bool breakpoints::compiler::parse_operand(program &p)
+{
+    skip_space();
+
+    if (accept("("))
+        return parse_or(p) && accept(")");
+
+    if (accept("-"))
+    {
+        p.push_back({ op_const, 0 });
+        if (!parse_operand(p))
+            return false;
+        p.push_back({ op_sub, 0 });
+        return true;
+    }
+
+    if (pos < src.size() && isdigit(src[pos]))
+    {
+        int32_t v;
+        if (!parse_number(v))
+            return false;
+        p.push_back({ op_const, v });
+        return true;
+    }
+
+    std::string name;
+    if (!parse_name(name))
+    {
+        err = "expected a number, register or m8/m16/m32";
+        return false;
+    }
+
+    if (name == "m8" || name == "m16" || name == "m32")
+    {
+        if (!accept("(") || !parse_sum(p) || !accept(")"))
+        {
+            err = "expected " + name + "(address)";
+            return false;
+        }
+        p.push_back({ name == "m8" ? op_load8 : name == "m16" ? op_load16 : op_load32, 0 });
+        return true;
+    }
+
+    if (name == "pc")
+    {
+        p.push_back({ op_pc, 0 });
+        return true;
+    }
+
+    static const char *abi[32] =
+    {
+        "zero", "ra", "sp", "gp", "tp", "t0", "t1", "t2",
+        "s0", "s1", "a0", "a1", "a2", "a3", "a4", "a5",
+        "a6", "a7", "s2", "s3", "s4", "s5", "s6", "s7",
+        "s8", "s9", "s10", "s11", "t3", "t4", "t5", "t6"
+    };
+
+    for (int32_t r = 0; r < 32; ++r)
+    {
+        if (name == abi[r] || name == "x" + std::to_string(r) || (r == 8 && name == "fp"))
+        {
+            p.push_back({ op_reg, r });
+            return true;
+        }
+    }
+
+    err = "unknown register '" + name + "'";
+    return false;
+}
+
+bool breakpoints::compiler::parse_number(int32_t &v)
+{
+    size_t end = pos;
+    while (end < src.size() && isalnum(src[end]))
+        ++end;
+
+    std::string tok = src.substr(pos, end - pos);
+    std::istringstream iss(tok);
+    uint32_t u;
+
+    if (tok.size() > 2 && tok[0] == '0' && (tok[1] == 'x' || tok[1] == 'X'))
+        iss >> std::hex >> u;
+    else
+        iss >> std::dec >> u;
+
+    if (!iss || !iss.eof())
+    {
+        err = "bad number '" + tok + "'";
+        return false;
+    }
+
+    v = u;
+    pos = end;
+    return true;
+}
+
+bool breakpoints::compiler::parse_name(std::string &name)
+{
+    size_t end = pos;
+    while (end < src.size() && isalnum(src[end]))
+        ++end;
+
+    if (end == pos)
+        return false;
+
+    name = src.substr(pos, end - pos);
+    pos = end;
+    return true;
+}
+
+bool breakpoints::compiler::accept(const std::string &tok)
+{
+    skip_space();
+    if (src.compare(pos, tok.size(), tok) != 0)
+        return false;
+    pos += tok.size();
+    return true;
+}
+
+void breakpoints::compiler::skip_space()
+{
+    while (pos < src.size() && isspace(src[pos]))
+        ++pos;
+}
@@ -0,0 +1,91 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#ifndef H_BREAKPOINTS
+#define H_BREAKPOINTS
+
+#include "hex.h"
+#include "memory.h"
+#include <map>
+#include <string>
+#include <vector>
+
+class rv32i_hart;
+
+/**
+ * breakpoints is a set of pc breakpoints, each with an optional condition.
+ *
+ * Breakpoint pcs are marked in a bitmap with one bit per halfword, so the
+ * run loop only needs one bit test per instruction. Conditions such as
+ * "a0==5 && m32(sp+8)!=0" are compiled once, when the breakpoint is added,
+ * into a short postfix program that check() evaluates on a hit.
+ *
+ ********************************************************************************/
+
+class breakpoints : public hex
+{
+public:
+    bool add(const std::string &spec, std::string &error);
+    bool empty() const { return conds.empty(); }
+
+    bool is_set(uint32_t pc) const
+    {
+        uint32_t i = pc >> 1;
+        return (i >> 6) < bitmap.size() && (bitmap[i >> 6] >> (i & 63)) & 1;
+    }
+
+    bool check(uint32_t pc, const rv32i_hart &hart, const memory &mem) const;
+
+private:
+    enum opcode
+    {
+        op_const, op_reg, op_pc,
+        op_load8, op_load16, op_load32,
+        op_add, op_sub,
+        op_eq, op_ne, op_lt, op_le, op_gt, op_ge,
+        op_and, op_or
+    };
+
+    struct op
+    {
+        opcode code;
+        int32_t arg;
+    };
+
+    typedef std::vector<op> program;    ///< Empty means unconditional.
+
+    static constexpr size_t max_depth = 32;    ///< Deepest value stack eval() supports.
+
+    class compiler
+    {
+    public:
+        compiler(const std::string &s) : src(s) { }
+        bool compile(program &p, std::string &error);
+
+    private:
+        bool parse_or(program &p);
+        bool parse_and(program &p);
+        bool parse_compare(program &p);
+        bool parse_sum(program &p);
+        bool parse_operand(program &p);
+        bool parse_number(int32_t &v);
+        bool parse_name(std::string &name);
+        bool accept(const std::string &tok);
+        void skip_space();
+
+        std::string src;
+        size_t pos = { 0 };
+        std::string err;
+    };
+
+    static bool eval(const program &p, uint32_t pc, const rv32i_hart &hart, const memory &mem);
+
+    std::vector<uint64_t> bitmap;
+    std::map<uint32_t, std::vector<program>> conds;
+};
+
+#endif
@@ -0,0 +1,340 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#include "cpu_multi_instance.h"
+#include "rv32i_predecode.h"
+#include <iostream>
+
+cpu_multi_instance::cpu_multi_instance(uint32_t count, uint32_t mem_size, bool rvc)
+    : n(count), mem_size(mem_size), rvc(rvc), inst(count), ops(op_cache_size)
+{
+    for (auto &r : x)
+        r.resize(n, 0);
+    pc.resize(n, 0);
+    insns.resize(n, 0);
+    running.resize(n, 0);
+    in_group.resize(n, 0);
+}
+
+/**
+ * start() gives every instance a fresh memory and hart, has setup load
+ * and configure them, and takes the registers over from the harts. Each
+ * hart's mhartid is its instance number.
+ *
+ * @return false if setup fails for any instance.
+ *
+ ********************************************************************************/
+
+bool cpu_multi_instance::start(const setup_fn &setup)
+{
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        inst[i].mem.reset(new memory(mem_size));
+        inst[i].core.reset(new cpu_single_hart(*inst[i].mem));
+        inst[i].core->set_mhartid(i);
+        if (!setup(*inst[i].mem, *inst[i].core, i))
+            return false;
+
+        from_core(i);
+        running[i] = !inst[i].core->is_halted();
+    }
+    return true;
+}
+
+/**
+ * run() steps the instances until every one has halted or executed
+ * exec_limit instructions, then prints a line for each and a summary of
+ * how much ran in groups.
+ *
+ * @param exec_limit Maximum number of instructions for each instance, 0 = no limit.
+ *
+ ********************************************************************************/
+
+void cpu_multi_instance::run(uint64_t exec_limit)
+{
+    for (;;)
+    {
+        uint32_t at = 0xffffffff;
+        bool any = false;
+        for (uint32_t i = 0; i < n; ++i)
+        {
+            if (running[i] && (!any || pc[i] < at))
+            {
+                at = pc[i];
+                any = true;
+            }
+        }
+        if (!any)
+            break;
+
+        for (uint32_t i = 0; i < n; ++i)
+            in_group[i] = running[i] && pc[i] == at;
+
+        step(at);
+
+        for (uint32_t i = 0; i < n; ++i)
+        {
+            if (running[i] && exec_limit != 0 && insns[i] >= exec_limit)
+                running[i] = 0;
+        }
+    }
+
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        to_core(i);
+        const cpu_single_hart &c = *inst[i].core;
+        std::cout << "Instance " << std::dec << i << ": ";
+        if (c.is_halted() && c.get_halt_reason() != "none")
+            std::cout << "Execution terminated. Reason: " << c.get_halt_reason() << ", ";
+        std::cout << insns[i] << " instructions executed" << std::endl;
+        total += insns[i];
+    }
+
+    std::cout << std::dec << n << " instances, " << total << " instructions executed, "
+              << group_insns << " of them in " << group_steps << " group steps" << std::endl;
+}
+
+/**
+ * dump() shows the registers and memory of every instance.
+ *
+ ********************************************************************************/
+
+void cpu_multi_instance::dump() const
+{
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        std::cout << "Instance " << std::dec << i << ":" << std::endl;
+        inst[i].core->dump("");
+        inst[i].mem->dump();
+    }
+}
+
+/**
+ * step() executes one instruction for the group at "at". Members whose
+ * code there is not the group's, or whose load or store misses RAM, step
+ * alone, and so does everyone if the instruction is not one the group
+ * loop carries out.
+ *
+ ********************************************************************************/
+
+void cpu_multi_instance::step(uint32_t at)
+{
+    uint32_t first = 0;
+    while (!in_group[first])
+        ++first;
+
+    const group_op &o = lookup(at, first);
+    uint32_t count = 0;
+    for (uint32_t i = first; i < n; ++i)
+    {
+        if (!in_group[i])
+            continue;
+
+        if (!o.grouped || bits_at(i, at, o.size) != o.bits || !in_ram(i, o))
+        {
+            in_group[i] = 0;
+            step_alone(i);
+        }
+        else
+        {
+            ++count;
+        }
+    }
+
+    if (count == 0)
+        return;
+
+    exec_group(o, at);
+    for (uint32_t i = 0; i < n; ++i)
+        insns[i] += in_group[i];
+
+    ++group_steps;
+    group_insns += count;
+}
+
+/**
+ * lookup() returns the instruction at "at" as decoded from the memory of
+ * instance "first", from the cache if its bits there have not changed.
+ *
+ ********************************************************************************/
+
+const cpu_multi_instance::group_op &cpu_multi_instance::lookup(uint32_t at, uint32_t first)
+{
+    static const group_op alone;
+    if ((at & (rvc ? 1 : 3)) != 0 || uint64_t(at) + 4 > mem_size)
+        return alone;
+
+    group_op &o = ops[(at >> 1) & (op_cache_size-1)];
+    if (o.pc == at && bits_at(first, at, o.size) == o.bits)
+        return o;
+
+    uint32_t insn;
+    uint8_t size;
+    o = group_op();
+    if (!rv32i_predecode::fetch(*inst[first].mem, at, rvc, insn, size))
+        return alone;
+
+    rv32i_decode::decoded_insn d = rv32i_decode::decode_insn(at, insn);
+    o.pc = at;
+    o.size = size;
+    o.bits = bits_at(first, at, size);
+    o.id = d.id;
+    o.rd = d.rd;
+    o.rs1 = d.rs1;
+    o.rs2 = d.rs2;
+    o.imm = (d.fmt == rv32i_isa::fmt_u) ? rv32i_isa::get_imm_u(insn) : d.imm;
+    o.grouped = d.id != rv32i_isa::id_illegal && d.id < rv32i_isa::id_ecall;
+    switch (d.id)
+    {
+        case rv32i_isa::id_lb: case rv32i_isa::id_lbu: case rv32i_isa::id_sb: o.len = 1; break;
+        case rv32i_isa::id_lh: case rv32i_isa::id_lhu: case rv32i_isa::id_sh: o.len = 2; break;
+        case rv32i_isa::id_lw: case rv32i_isa::id_sw: o.len = 4; break;
+        default: break;
+    }
+    return o;
+}
+
+uint32_t cpu_multi_instance::bits_at(uint32_t i, uint32_t at, uint8_t size) const
+{
+    return size == 2 ? inst[i].mem->peek16(at) : inst[i].mem->peek32(at);
+}
+
+/// False if o is a load or store that leaves instance i's RAM, e.g. for a device.
+bool cpu_multi_instance::in_ram(uint32_t i, const group_op &o) const
+{
+    return o.len == 0 || uint64_t(x[o.rs1][i] + o.imm) + o.len <= inst[i].mem->get_size();
+}
+
+/**
+ * exec_group() carries out o, found at "at", for every instance in the
+ * group and moves their pcs on.
+ *
+ ********************************************************************************/
+
+void cpu_multi_instance::exec_group(const group_op &o, uint32_t at)
+{
+    uint32_t next = at + o.size;
+    uint32_t target = at + o.imm;
+    uint32_t imm = o.imm;
+
+    switch (o.id)
+    {
+        case rv32i_isa::id_lui: alu(o, [imm](uint32_t, uint32_t) { return imm; }); break;
+        case rv32i_isa::id_auipc: alu(o, [target](uint32_t, uint32_t) { return target; }); break;
+
+        case rv32i_isa::id_jal:
+            alu(o, [next](uint32_t, uint32_t) { return next; });
+            branch(o, target, target, [](uint32_t, uint32_t) { return true; });
+            return;
+
+        case rv32i_isa::id_jalr:
+        {
+            const uint32_t *a = x[o.rs1].data();
+            for (uint32_t i = 0; i < n; ++i)
+            {
+                if (in_group[i])
+                {
+                    pc[i] = (a[i] + imm) & 0xfffffffe;    // before rd, which may be rs1
+                    if (o.rd)
+                        x[o.rd][i] = next;
+                }
+            }
+            return;
+        }
+
+        case rv32i_isa::id_beq: branch(o, target, next, [](uint32_t a, uint32_t b) { return a == b; }); return;
+        case rv32i_isa::id_bne: branch(o, target, next, [](uint32_t a, uint32_t b) { return a != b; }); return;
+        case rv32i_isa::id_blt: branch(o, target, next, [](uint32_t a, uint32_t b) { return int32_t(a) < int32_t(b); }); return;
+        case rv32i_isa::id_bge: branch(o, target, next, [](uint32_t a, uint32_t b) { return int32_t(a) >= int32_t(b); }); return;
+        case rv32i_isa::id_bltu: branch(o, target, next, [](uint32_t a, uint32_t b) { return a < b; }); return;
+        case rv32i_isa::id_bgeu: branch(o, target, next, [](uint32_t a, uint32_t b) { return a >= b; }); return;
+
+        case rv32i_isa::id_lb: load(o, [](const memory &m, uint32_t a) { return uint32_t(m.get8_sx(a)); }); break;
+        case rv32i_isa::id_lh: load(o, [](const memory &m, uint32_t a) { return uint32_t(m.get16_sx(a)); }); break;
+        case rv32i_isa::id_lw: load(o, [](const memory &m, uint32_t a) { return m.get32(a); }); break;
+        case rv32i_isa::id_lbu: load(o, [](const memory &m, uint32_t a) { return uint32_t(m.get8(a)); }); break;
+        case rv32i_isa::id_lhu: load(o, [](const memory &m, uint32_t a) { return uint32_t(m.get16(a)); }); break;
+
+        case rv32i_isa::id_sb: store(o, [](memory &m, uint32_t a, uint32_t v) { m.set8(a, v); }); break;
+        case rv32i_isa::id_sh: store(o, [](memory &m, uint32_t a, uint32_t v) { m.set16(a, v); }); break;
+        case rv32i_isa::id_sw: store(o, [](memory &m, uint32_t a, uint32_t v) { m.set32(a, v); }); break;
+
+        case rv32i_isa::id_addi: alu(o, [imm](uint32_t a, uint32_t) { return a + imm; }); break;
+        case rv32i_isa::id_slti: alu(o, [imm](uint32_t a, uint32_t) { return uint32_t(int32_t(a) < int32_t(imm)); }); break;
+        case rv32i_isa::id_sltiu: alu(o, [imm](uint32_t a, uint32_t) { return uint32_t(a < imm); }); break;
+        case rv32i_isa::id_xori: alu(o, [imm](uint32_t a, uint32_t) { return a ^ imm; }); break;
+        case rv32i_isa::id_ori: alu(o, [imm](uint32_t a, uint32_t) { return a | imm; }); break;
+        case rv32i_isa::id_andi: alu(o, [imm](uint32_t a, uint32_t) { return a & imm; }); break;
+        case rv32i_isa::id_slli: alu(o, [imm](uint32_t a, uint32_t) { return a << imm; }); break;
+        case rv32i_isa::id_srli: alu(o, [imm](uint32_t a, uint32_t) { return a >> imm; }); break;
+        case rv32i_isa::id_srai: alu(o, [imm](uint32_t a, uint32_t) { return uint32_t(int32_t(a) >> imm); }); break;
+
+        case rv32i_isa::id_add: alu(o, [](uint32_t a, uint32_t b) { return a + b; }); break;
+        case rv32i_isa::id_sub: alu(o, [](uint32_t a, uint32_t b) { return a - b; }); break;
+        case rv32i_isa::id_sll: alu(o, [](uint32_t a, uint32_t b) { return a << (b & 0x1f); }); break;
+        case rv32i_isa::id_slt: alu(o, [](uint32_t a, uint32_t b) { return uint32_t(int32_t(a) < int32_t(b)); }); break;
+        case rv32i_isa::id_sltu: alu(o, [](uint32_t a, uint32_t b) { return uint32_t(a < b); }); break;
+        case rv32i_isa::id_xor: alu(o, [](uint32_t a, uint32_t b) { return a ^ b; }); break;
+        case rv32i_isa::id_srl: alu(o, [](uint32_t a, uint32_t b) { return a >> (b & 0x1f); }); break;
+        case rv32i_isa::id_sra: alu(o, [](uint32_t a, uint32_t b) { return uint32_t(int32_t(a) >> (b & 0x1f)); }); break;
+        case rv32i_isa::id_or: alu(o, [](uint32_t a, uint32_t b) { return a | b; }); break;
+        case rv32i_isa::id_and: alu(o, [](uint32_t a, uint32_t b) { return a & b; }); break;
+
+        case rv32i_isa::id_mul: alu(o, [](uint32_t a, uint32_t b) { return a * b; }); break;
+        case rv32i_isa::id_mulh: alu(o, rv32i_isa::mulh); break;
+        case rv32i_isa::id_mulhsu: alu(o, rv32i_isa::mulhsu); break;
+        case rv32i_isa::id_mulhu: alu(o, rv32i_isa::mulhu); break;
+        case rv32i_isa::id_div: alu(o, rv32i_isa::div); break;
+        case rv32i_isa::id_divu: alu(o, rv32i_isa::divu); break;
+        case rv32i_isa::id_rem: alu(o, rv32i_isa::rem); break;
+        case rv32i_isa::id_remu: alu(o, rv32i_isa::remu); break;
+    }
+
+    for (uint32_t i = 0; i < n; ++i)
+        pc[i] = in_group[i] ? next : pc[i];
+}
+
+/**
+ * step_alone() executes one instruction of instance i on its hart.
+ *
+ ********************************************************************************/
+
+void cpu_multi_instance::step_alone(uint32_t i)
+{
+    cpu_single_hart &c = *inst[i].core;
+    to_core(i);
+    c.step();
+    from_core(i);
+
+    if (c.is_halted())
+        running[i] = 0;
+}
+
+/**
+ * to_core() and from_core() hand instance i's registers, pc and
+ * instruction count between the group's arrays and its hart.
+ *
+ ********************************************************************************/
+
+void cpu_multi_instance::to_core(uint32_t i)
+{
+    cpu_single_hart &c = *inst[i].core;
+    for (uint32_t r = 1; r < 32; ++r)
+        c.set_reg(r, x[r][i]);
+    c.set_pc(pc[i]);
+    c.set_insn_counter(insns[i]);
+}
+
+void cpu_multi_instance::from_core(uint32_t i)
+{
+    const cpu_single_hart &c = *inst[i].core;
+    for (uint32_t r = 1; r < 32; ++r)
+        x[r][i] = c.get_reg(r);
+    pc[i] = c.get_pc();
+    insns[i] = c.get_insn_counter();
+}
@@ -0,0 +1,149 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#ifndef H_MULTI_INSTANCE
+#define H_MULTI_INSTANCE
+
+#include "cpu_single_hart.h"
+#include "memory.h"
+#include <functional>
+#include <memory>
+#include <vector>
+
+/**
+ * cpu_multi_instance runs many copies of one program side by side, each
+ * with its own memory and registers, e.g. to try the program on many
+ * inputs at once.
+ *
+ * The registers are kept as structure-of-arrays: x[r] holds register r
+ * of every instance. Each step takes the running instances at the lowest
+ * pc as a group, decodes the instruction there once and carries it out
+ * for the whole group with one loop over the instances, which the
+ * compiler can turn into SIMD code. Instances that branch differently
+ * leave the group; as the lowest pc always goes first, the ones ahead
+ * wait and the group forms again where the paths meet.
+ *
+ * An instance steps alone on its own hart, its registers handed over and
+ * back, for what the group loop does not carry out (system, CSR and
+ * illegal instructions, misaligned pcs), whenever its code at the pc
+ * differs from the group's, and for loads and stores outside RAM.
+ *
+ ********************************************************************************/
+
+class cpu_multi_instance : public hex
+{
+public:
+    /// Loads the image into an instance's memory and configures its hart.
+    typedef std::function<bool(memory&, cpu_single_hart&, uint32_t instance)> setup_fn;
+
+    cpu_multi_instance(uint32_t count, uint32_t mem_size, bool rvc);
+
+    bool start(const setup_fn &setup);
+    void run(uint64_t exec_limit);
+    void dump() const;
+
+private:
+    struct instance
+    {
+        std::unique_ptr<memory> mem;
+        std::unique_ptr<cpu_single_hart> core;
+    };
+
+    /// An instruction decoded for a group.
+    struct group_op
+    {
+        uint32_t pc = { 0xffffffff };   ///< Odd, so it never matches.
+        uint32_t bits = { 0 };          ///< As in memory: 16 bits if compressed.
+        int32_t imm = { 0 };            ///< Branch and jal: the offset, lui: the value.
+        uint8_t id = { rv32i_isa::id_illegal };
+        uint8_t rd = { 0 };
+        uint8_t rs1 = { 0 };
+        uint8_t rs2 = { 0 };
+        uint8_t size = { 4 };
+        uint8_t len = { 0 };            ///< Bytes it loads or stores.
+        bool grouped = { false };       ///< The group loop carries it out.
+    };
+
+    static constexpr uint32_t op_cache_size = 1024;
+
+    void step(uint32_t at);
+    void step_alone(uint32_t i);
+    const group_op &lookup(uint32_t at, uint32_t first);
+    uint32_t bits_at(uint32_t i, uint32_t at, uint8_t size) const;
+    bool in_ram(uint32_t i, const group_op &o) const;
+    void exec_group(const group_op &o, uint32_t at);
+    void to_core(uint32_t i);
+    void from_core(uint32_t i);
+
+    /// rd = f(rs1, rs2) for the group.
+    template <typename F> void alu(const group_op &o, F f)
+    {
+        if (o.rd == 0)
+            return;
+
+        uint32_t *d = x[o.rd].data();
+        const uint32_t *a = x[o.rs1].data();
+        const uint32_t *b = x[o.rs2].data();
+        const uint8_t *g = in_group.data();
+        for (uint32_t i = 0; i < n; ++i)
+            d[i] = g[i] ? f(a[i], b[i]) : d[i];
+    }
+
+    /// pc = f(rs1, rs2) ? taken : next for the group.
+    template <typename F> void branch(const group_op &o, uint32_t taken, uint32_t next, F f)
+    {
+        const uint32_t *a = x[o.rs1].data();
+        const uint32_t *b = x[o.rs2].data();
+        const uint8_t *g = in_group.data();
+        for (uint32_t i = 0; i < n; ++i)
+            pc[i] = g[i] ? (f(a[i], b[i]) ? taken : next) : pc[i];
+    }
+
+    /// rd = f(its memory, rs1 + imm) for the group.
+    template <typename F> void load(const group_op &o, F f)
+    {
+        const uint32_t *a = x[o.rs1].data();
+        for (uint32_t i = 0; i < n; ++i)
+        {
+            if (in_group[i])
+            {
+                uint32_t v = f(*inst[i].mem, a[i] + o.imm);
+                if (o.rd)
+                    x[o.rd][i] = v;
+            }
+        }
+    }
+
+    /// f(its memory, rs1 + imm, rs2) for the group.
+    template <typename F> void store(const group_op &o, F f)
+    {
+        const uint32_t *a = x[o.rs1].data();
+        const uint32_t *b = x[o.rs2].data();
+        for (uint32_t i = 0; i < n; ++i)
+        {
+            if (in_group[i])
+                f(*inst[i].mem, a[i] + o.imm, b[i]);
+        }
+    }
+
+    uint32_t n;
+    uint32_t mem_size;
+    bool rvc;
+    std::vector<instance> inst;
+
+    std::vector<uint32_t> x[32];        ///< x[r][i] is register r of instance i.
+    std::vector<uint32_t> pc;
+    std::vector<uint64_t> insns;
+    std::vector<uint8_t> running;
+    std::vector<uint8_t> in_group;      ///< In the current step's group.
+
+    std::vector<group_op> ops;          ///< Direct-mapped on the pc.
+    uint64_t group_steps = { 0 };
+    uint64_t group_insns = { 0 };
+};
+
+#endif
@@ -9,7 +9,22 @@
 
 void cpu_single_hart::run(uint64_t exec_limit)
 {
-    uint64_t lmt = 0;
+    const uint64_t lmt = get_insn_counter() + exec_limit;    // a fused tick retires two
+
+    sigjmp_buf faulted;                 // where a guest access outside RAM lands with guard pages
+    memory::fault_scope scope(faulted);
+    if (sigsetjmp(faulted, 0) != 0)
+    {
+        access_fault(memory::get_fault_addr());
+    }
+
+    if (bps && !bps->empty())
+    {
+        run_breakpoints(exec_limit);   // keeps the checks out of the loops below
+        return;
+    }
+
+    set_insn_limit(exec_limit == 0 ? 0 : lmt);
     
     if (exec_limit == 0)
     {
@@ -17,6 +32,8 @@ void cpu_single_hart::run(uint64_t exec_limit)
         {
             tick("");
         }
+
+        flush_output();             // guest output before the summary
         
         if (is_halted() == true)
         {
@@ -29,32 +46,76 @@ void cpu_single_hart::run(uint64_t exec_limit)
         while(!is_halted())
         {          
             tick("");
-
-            lmt++;
             
-            if (lmt == exec_limit-1)
+            if (get_insn_counter() == lmt-1)
             {
                 set_show_registers(false);
             }
 
-            if (lmt == exec_limit)
+            if (get_insn_counter() >= lmt)
             {
                 rv32i_hart::set_halt(true);
-                
-                if (is_halted() == true)
-                {
-                    
-
-                    if (get_halt_reason() != "none")
-                    {
-                        std::cout << "Execution terminated. Reason: " << get_halt_reason() << "\n";
-                    }
-                    std::cout << std::dec << get_insn_counter() << " instructions executed" << std::endl;
-                }
-
                 break;
             }
         }
 
+        flush_output();             // the loop also ends on a halt before the limit
+
+        if (get_halt_reason() != "none")
+        {
+            std::cout << "Execution terminated. Reason: " << get_halt_reason() << "\n";
+        }
+        std::cout << std::dec << get_insn_counter() << " instructions executed" << std::endl;
+    }
+}
+
+/**
+ * run_breakpoints() is run() for when breakpoints are set.
+ *
+ * Before each instruction the pc is tested against the breakpoint bitmap,
+ * and only a marked pc evaluates the breakpoint conditions. The hart halts
+ * without executing the instruction at the breakpoint.
+ *
+ * @param exec_limit Maximum number of instructions to execute, 0 = no limit.
+ *
+ ********************************************************************************/
+
+void cpu_single_hart::run_breakpoints(uint64_t exec_limit)
+{
+    set_fusion(false);              // a fused pair could step over a breakpoint
+    set_fast_forward(false);        // and so could a skipped idle loop
+    set_chaining(false);            // or a chain of uops
+
+    while (!is_halted())
+    {
+        uint32_t pc = get_pc();
+
+        if (bps->is_set(pc) && bps->check(pc, *this, mem))
+        {
+            set_halt(true);
+            set_halt_reason("Breakpoint at " + to_hex0x32(pc));
+            break;
+        }
+
+        if (exec_limit != 0 && get_insn_counter() == exec_limit-1)
+        {
+            set_show_registers(false);
+        }
+
+        tick("");
+
+        if (exec_limit != 0 && get_insn_counter() >= exec_limit)
+        {
+            set_halt(true);
+            break;
+        }
+    }
+
+    flush_output();
+
+    if (get_halt_reason() != "none")
+    {
+        std::cout << "Execution terminated. Reason: " << get_halt_reason() << "\n";
     }
+    std::cout << std::dec << get_insn_counter() << " instructions executed" << std::endl;
 }
\ No newline at end of file
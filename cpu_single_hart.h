@@ -9,12 +9,19 @@
 #define H_SINGLE_HART
 
 #include "rv32i_hart.h"
+#include "breakpoints.h"
 
 class cpu_single_hart : public rv32i_hart
 {
 public:
     cpu_single_hart(memory &mem) : rv32i_hart(mem) {}
     void run(uint64_t exec_limit);
+    void set_breakpoints(const breakpoints *b) { bps = b; }
+
+private:
+    void run_breakpoints(uint64_t exec_limit);
+
+    const breakpoints *bps = { nullptr };
 };
 
 #endif
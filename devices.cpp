@@ -0,0 +1,215 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#include "devices.h"
+#include "rv32i_hart.h"
+#include <poll.h>
+#include <unistd.h>
+
+/**
+ * lane_mask() is the mask for an access of len bytes.
+ *
+ ********************************************************************************/
+
+static uint32_t lane_mask(uint32_t len)
+{
+    return len >= 4 ? 0xffffffff : (1u << (len*8)) - 1;
+}
+
+/**
+ * merge() writes an access of len bytes at byte shift into a register.
+ *
+ ********************************************************************************/
+
+static uint64_t merge(uint64_t reg, uint32_t shift, uint32_t len, uint32_t val)
+{
+    uint64_t m = uint64_t(lane_mask(len)) << shift;
+    return (reg & ~m) | ((uint64_t(val) << shift) & m);
+}
+
+/**
+ * uart::read() reads a register. Only the byte at offset matters; wider
+ * accesses read the same register.
+ *
+ ********************************************************************************/
+
+uint32_t uart::read(uint32_t offset, uint32_t)
+{
+    switch (offset)
+    {
+    case 0:
+        if (lcr & lcr_dlab)
+            return dll;
+        if (rx_ready())
+        {
+            uint8_t c = rx;
+            rx = -1;
+            return c;
+        }
+        return 0;
+
+    case 1: return (lcr & lcr_dlab) ? dlm : ier;
+    case 2: return (fcr & 1) ? 0xc1 : 0x01;     // no interrupt pending
+    case 3: return lcr;
+    case 4: return mcr;
+    case 5: return lsr_thre | lsr_temt | (rx_ready() ? lsr_dr : 0);
+    case 7: return scr;
+    default: return 0;
+    }
+}
+
+void uart::write(uint32_t offset, uint32_t, uint32_t val)
+{
+    uint8_t b = val;
+
+    switch (offset)
+    {
+    case 0:
+        if (lcr & lcr_dlab)
+            dll = b;
+        else
+            std::cout.put(b);
+        break;
+
+    case 1:
+        if (lcr & lcr_dlab)
+            dlm = b;
+        else
+            ier = b;
+        break;
+
+    case 2: fcr = b; break;
+    case 3: lcr = b; break;
+    case 4: mcr = b; break;
+    case 7: scr = b; break;
+    default: break;
+    }
+}
+
+/**
+ * rx_ready() reads ahead one byte from stdin if one is available without
+ * blocking.
+ *
+ ********************************************************************************/
+
+bool uart::rx_ready()
+{
+    if (rx >= 0)
+        return true;
+    if (rx_eof)
+        return false;
+
+    std::cout.flush();          // let prompts out before looking for input
+
+    struct pollfd pfd = { 0, POLLIN, 0 };
+    if (::poll(&pfd, 1, 0) <= 0)
+        return false;
+
+    uint8_t c;
+    if (::read(0, &c, 1) != 1)
+    {
+        rx_eof = true;
+        return false;
+    }
+
+    rx = c;
+    return true;
+}
+
+/**
+ * attach() connects the CLINT to the hart whose instructions it counts
+ * and whose interrupts it raises.
+ *
+ ********************************************************************************/
+
+void clint::attach(rv32i_hart &h)
+{
+    hart = &h;
+    hart->set_clint(this);
+}
+
+/**
+ * get_mtime() is the attached hart's instruction count plus any
+ * adjustment made by writing mtime.
+ *
+ ********************************************************************************/
+
+uint64_t clint::get_mtime() const
+{
+    return (hart ? hart->get_insn_counter() : 0) + mtime_adjust;
+}
+
+uint32_t clint::read(uint32_t offset, uint32_t len)
+{
+    if (offset < msip_offset + 4)
+        return (msip >> (offset - msip_offset)*8) & lane_mask(len);
+    if (offset - mtimecmp_offset < 8)
+        return (mtimecmp >> (offset - mtimecmp_offset)*8) & lane_mask(len);
+    if (offset - mtime_offset < 8)
+        return (get_mtime() >> (offset - mtime_offset)*8) & lane_mask(len);
+    return 0;
+}
+
+void clint::write(uint32_t offset, uint32_t len, uint32_t val)
+{
+    if (offset < msip_offset + 4)
+    {
+        msip = merge(msip, (offset - msip_offset)*8, len, val) & 1;
+    }
+    else if (offset - mtimecmp_offset < 8)
+    {
+        mtimecmp = merge(mtimecmp, (offset - mtimecmp_offset)*8, len, val);
+    }
+    else if (offset - mtime_offset < 8)
+    {
+        uint64_t t = merge(get_mtime(), (offset - mtime_offset)*8, len, val);
+        mtime_adjust = t - (hart ? hart->get_insn_counter() : 0);
+    }
+    else
+    {
+        return;
+    }
+
+    if (hart)
+        hart->clint_changed();
+}
+
+uint32_t test_finisher::read(uint32_t, uint32_t)
+{
+    return 0;
+}
+
+void test_finisher::write(uint32_t offset, uint32_t, uint32_t val)
+{
+    if (offset != 0)
+        return;
+
+    switch (val & 0xffff)
+    {
+    case 0x5555: finish(0, "Test finisher: pass"); break;
+    case 0x3333: finish(val >> 16, "Test finisher: fail(" + std::to_string(val >> 16) + ")"); break;
+    case 0x7777: finish(0, "Test finisher: reset"); break;
+    default: break;
+    }
+}
+
+/**
+ * finish() halts the hart. The store that triggered it completes first.
+ *
+ ********************************************************************************/
+
+void test_finisher::finish(int code, const std::string &reason)
+{
+    finished = true;
+    exit_code = code;
+
+    if (hart)
+    {
+        hart->set_halt(true);
+        hart->set_halt_reason(reason);
+    }
+}
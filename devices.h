@@ -0,0 +1,122 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#ifndef H_DEVICES
+#define H_DEVICES
+
+#include "memory.h"
+#include <string>
+
+class rv32i_hart;
+
+/**
+ * uart is the register interface of a 16550 serial port.
+ *
+ * Transmitted bytes go to std::cout. Received bytes are read from the
+ * host's stdin when it has input ready, so a guest polling the line
+ * status register does not block the simulator.
+ *
+ ********************************************************************************/
+
+class uart : public memory::device
+{
+public:
+    static constexpr uint32_t default_base = 0x10000000;
+    static constexpr uint32_t size = 0x100;
+
+    uint32_t read(uint32_t offset, uint32_t len) override;
+    void write(uint32_t offset, uint32_t len, uint32_t val) override;
+
+private:
+    static constexpr uint8_t lcr_dlab = 0x80;
+    static constexpr uint8_t lsr_dr = 0x01;     ///< Receive data ready.
+    static constexpr uint8_t lsr_thre = 0x20;   ///< Transmit holding register empty.
+    static constexpr uint8_t lsr_temt = 0x40;   ///< Transmitter empty.
+
+    bool rx_ready();
+
+    uint8_t ier = { 0 };
+    uint8_t fcr = { 0 };
+    uint8_t lcr = { 0 };
+    uint8_t mcr = { 0 };
+    uint8_t scr = { 0 };
+    uint8_t dll = { 0 };
+    uint8_t dlm = { 0 };
+
+    int rx = { -1 };            ///< Byte read ahead from stdin, or -1.
+    bool rx_eof = { false };
+};
+
+/**
+ * clint is the core-local interruptor's register block for one hart:
+ * msip, mtimecmp and mtime.
+ *
+ * mtime counts retired instructions of the attached hart. Writing mtime
+ * moves it by an offset rather than changing the instruction counter.
+ * Writes to the registers are passed on to the hart, which schedules
+ * its timer interrupt from them.
+ *
+ ********************************************************************************/
+
+class clint : public memory::device
+{
+public:
+    static constexpr uint32_t default_base = 0x02000000;
+    static constexpr uint32_t size = 0x10000;
+
+    void attach(rv32i_hart &h);
+
+    uint64_t get_mtime() const;
+    uint64_t get_mtimecmp() const { return mtimecmp; }
+    bool get_msip() const { return msip & 1; }
+
+    uint32_t read(uint32_t offset, uint32_t len) override;
+    void write(uint32_t offset, uint32_t len, uint32_t val) override;
+
+private:
+    static constexpr uint32_t msip_offset = 0x0000;
+    static constexpr uint32_t mtimecmp_offset = 0x4000;
+    static constexpr uint32_t mtime_offset = 0xbff8;
+
+    rv32i_hart *hart = { nullptr };
+    uint32_t msip = { 0 };
+    uint64_t mtimecmp = { ~uint64_t(0) };
+    uint64_t mtime_adjust = { 0 };
+};
+
+/**
+ * test_finisher ends the simulation when the guest writes a status word
+ * to it, as the SiFive test device does.
+ *
+ * 0x5555 halts with exit code 0, 0x3333 halts with the exit code in the
+ * upper 16 bits, and 0x7777 (reset) halts with exit code 0. Other values
+ * are ignored.
+ *
+ ********************************************************************************/
+
+class test_finisher : public memory::device
+{
+public:
+    static constexpr uint32_t default_base = 0x00100000;
+    static constexpr uint32_t size = 0x1000;
+
+    void attach(rv32i_hart &h) { hart = &h; }
+    bool has_finished() const { return finished; }
+    int get_exit_code() const { return exit_code; }
+
+    uint32_t read(uint32_t offset, uint32_t len) override;
+    void write(uint32_t offset, uint32_t len, uint32_t val) override;
+
+private:
+    void finish(int code, const std::string &reason);
+
+    rv32i_hart *hart = { nullptr };
+    bool finished = { false };
+    int exit_code = { 0 };
+};
+
+#endif
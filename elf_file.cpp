@@ -0,0 +1,179 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#include "elf_file.h"
+#include <fstream>
+#include <iterator>
+
+/**
+ * is_elf() checks a file for the ELF magic number.
+ *
+ ********************************************************************************/
+
+bool elf_file::is_elf(const std::string &fname)
+{
+    std::ifstream infile(fname, std::ios::in|std::ios::binary);
+    char magic[4];
+
+    return infile.read(magic, 4) && magic[0] == 0x7f && magic[1] == 'E' && magic[2] == 'L' && magic[3] == 'F';
+}
+
+/**
+ * load() reads an ELF executable and copies its segments into memory.
+ *
+ * @param fname The file to load.
+ * @param mem The memory to load it into.
+ *
+ * @return false, after printing why, if the file cannot be read, is not
+ *         a 32-bit little-endian RISC-V executable, or does not fit.
+ *
+ ********************************************************************************/
+
+bool elf_file::load(const std::string &fname, memory &mem)
+{
+    std::ifstream infile(fname, std::ios::in|std::ios::binary);
+
+    if (infile.is_open() == false)
+    {
+        std::cerr << "Can't open file '" << fname << "' for reading.\n";
+        return false;
+    }
+
+    image.assign(std::istreambuf_iterator<char>(infile), std::istreambuf_iterator<char>());
+
+    if (!in_file(0, 0x34) || image[4] != 1 || image[5] != 1 || get16(0x12) != em_riscv)
+    {
+        std::cerr << "'" << fname << "' is not a 32-bit little-endian RISC-V ELF file.\n";
+        return false;
+    }
+
+    entry = get32(0x18);
+
+    if (!load_segments(mem))
+        return false;
+
+    read_symbols();
+    return true;
+}
+
+/**
+ * lookup() finds the address of a symbol.
+ *
+ * @return false if the file has no such symbol.
+ *
+ ********************************************************************************/
+
+bool elf_file::lookup(const std::string &name, uint32_t &addr) const
+{
+    auto it = symbols.find(name);
+    if (it == symbols.end())
+        return false;
+
+    addr = it->second;
+    return true;
+}
+
+uint32_t elf_file::get16(uint32_t off) const
+{
+    return in_file(off, 2) ? image[off] | image[off+1] << 8 : 0;
+}
+
+uint32_t elf_file::get32(uint32_t off) const
+{
+    return in_file(off, 4) ? get16(off) | get16(off+2) << 16 : 0;
+}
+
+bool elf_file::load_segments(memory &mem)
+{
+    uint32_t phoff = get32(0x1c);
+    uint32_t phentsize = get16(0x2a);
+    uint32_t phnum = get16(0x2c);
+
+    for (uint32_t i = 0; i < phnum; ++i)
+    {
+        uint32_t ph = phoff + i * phentsize;
+        if (!in_file(ph, 0x20))
+        {
+            std::cerr << "Truncated ELF program header.\n";
+            return false;
+        }
+        if (get32(ph) != pt_load)
+            continue;
+
+        uint32_t offset = get32(ph + 0x04);
+        uint32_t addr = get32(ph + 0x0c);
+        uint32_t filesz = get32(ph + 0x10);
+        uint32_t memsz = get32(ph + 0x14);
+
+        if (!in_file(offset, filesz) || filesz > memsz
+            || !mem.load_segment(addr, image.data() + offset, filesz, memsz))
+        {
+            std::cerr << "ELF segment at " << to_hex0x32(addr) << " (" << to_hex0x32(memsz)
+                      << " bytes) does not fit in memory.\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * read_symbols() records the defined symbols of every symbol table. A
+ * global symbol replaces a local one of the same name. Functions are
+ * also kept on their own.
+ *
+ ********************************************************************************/
+
+void elf_file::read_symbols()
+{
+    uint32_t shoff = get32(0x20);
+    uint32_t shentsize = get16(0x2e);
+    uint32_t shnum = get16(0x30);
+
+    for (uint32_t i = 0; i < shnum; ++i)
+    {
+        uint32_t sh = shoff + i * shentsize;
+        if (!in_file(sh, 0x28) || get32(sh + 0x04) != sht_symtab)
+            continue;
+
+        uint32_t offset = get32(sh + 0x10);
+        uint32_t size = get32(sh + 0x14);
+        uint32_t strtab = shoff + get32(sh + 0x18) * shentsize;
+        uint32_t entsize = get32(sh + 0x24);
+        if (entsize < 0x10 || !in_file(offset, size) || !in_file(strtab, 0x28))
+            continue;
+
+        uint32_t str_off = get32(strtab + 0x10);
+        uint32_t str_size = get32(strtab + 0x14);
+        if (!in_file(str_off, str_size))
+            continue;
+
+        for (uint32_t s = offset; s + entsize <= offset + size; s += entsize)
+        {
+            uint32_t name = get32(s);
+            uint32_t value = get32(s + 0x04);
+            uint32_t info = image[s + 0x0c];
+            uint32_t shndx = get16(s + 0x0e);
+            uint32_t type = info & 0xf;
+
+            if (shndx == 0 || name == 0 || name >= str_size || type > 2)
+                continue;                   // undefined, unnamed, or not code or data
+
+            std::string n;
+            for (uint32_t c = str_off + name; c < str_off + str_size && image[c]; ++c)
+                n += char(image[c]);
+
+            if ((info >> 4) == 1 || symbols.find(n) == symbols.end())
+            {
+                symbols[n] = value;
+                if (type == 2)
+                    functions[n] = value;
+                else
+                    functions.erase(n);
+            }
+        }
+    }
+}
@@ -0,0 +1,56 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#ifndef H_ELF_FILE
+#define H_ELF_FILE
+
+#include "hex.h"
+#include "memory.h"
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * elf_file loads a 32-bit little-endian RISC-V ELF executable.
+ *
+ * Each PT_LOAD segment is copied to its physical address, with the part
+ * past the file contents zeroed. The entry point and the defined
+ * function and object symbols are kept so that the program can be
+ * started at its entry and guest functions found by name.
+ *
+ ********************************************************************************/
+
+class elf_file : public hex
+{
+public:
+    static bool is_elf(const std::string &fname);
+
+    bool load(const std::string &fname, memory &mem);
+
+    uint32_t get_entry() const { return entry; }
+    bool has_symbols() const { return !symbols.empty(); }
+    bool lookup(const std::string &name, uint32_t &addr) const;
+    const std::map<std::string, uint32_t> &get_functions() const { return functions; }
+
+private:
+    static constexpr uint32_t pt_load = 1;
+    static constexpr uint32_t sht_symtab = 2;
+    static constexpr uint32_t em_riscv = 243;
+
+    uint32_t get16(uint32_t off) const;
+    uint32_t get32(uint32_t off) const;
+    bool in_file(uint32_t off, uint32_t len) const { return uint64_t(off) + len <= image.size(); }
+    bool load_segments(memory &mem);
+    void read_symbols();
+
+    std::vector<uint8_t> image;         ///< The whole file.
+    uint32_t entry = { 0 };
+    std::map<std::string, uint32_t> symbols;
+    std::map<std::string, uint32_t> functions;  ///< The symbols of type STT_FUNC.
+};
+
+#endif
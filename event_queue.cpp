@@ -0,0 +1,77 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#include "event_queue.h"
+
+/**
+ * schedule() makes when the due time of source's event, replacing any
+ * event the source already had pending.
+ *
+ ********************************************************************************/
+
+void event_queue::schedule(uint32_t source, uint64_t when)
+{
+    heap.push({ when, source, ++generation[source] });
+}
+
+/**
+ * cancel() drops source's pending event, if any.
+ *
+ ********************************************************************************/
+
+void event_queue::cancel(uint32_t source)
+{
+    ++generation[source];
+}
+
+void event_queue::clear()
+{
+    heap = decltype(heap)();
+    for (uint32_t &g : generation)
+        ++g;
+}
+
+/**
+ * next_time() is the instruction count the earliest event is due at.
+ *
+ * @return The due time, or never if nothing is pending.
+ *
+ ********************************************************************************/
+
+uint64_t event_queue::next_time()
+{
+    drop_stale();
+    return heap.empty() ? never : heap.top().when;
+}
+
+/**
+ * pop_due() removes the earliest event if it is due.
+ *
+ * @param now The current instruction count.
+ * @param source Set to the source of the event.
+ *
+ * @return false if no event is due at now.
+ *
+ ********************************************************************************/
+
+bool event_queue::pop_due(uint64_t now, uint32_t &source)
+{
+    drop_stale();
+    if (heap.empty() || heap.top().when > now)
+        return false;
+
+    source = heap.top().source;
+    ++generation[source];
+    heap.pop();
+    return true;
+}
+
+void event_queue::drop_stale()
+{
+    while (!heap.empty() && heap.top().generation != generation[heap.top().source])
+        heap.pop();
+}
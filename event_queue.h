@@ -0,0 +1,57 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#ifndef H_EVENT_QUEUE
+#define H_EVENT_QUEUE
+
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <vector>
+
+/**
+ * event_queue keeps future events ordered by the instruction count they
+ * are due at.
+ *
+ * Each event source has at most one pending event; scheduling it again
+ * replaces the earlier one. Replaced and cancelled entries stay in the
+ * heap and are skipped when they reach the top, so schedule() and
+ * cancel() never search the heap.
+ *
+ ********************************************************************************/
+
+class event_queue
+{
+public:
+    static constexpr uint64_t never = ~uint64_t(0);
+
+    event_queue(uint32_t sources) : generation(sources, 0) { }
+
+    void schedule(uint32_t source, uint64_t when);
+    void cancel(uint32_t source);
+    void clear();
+
+    uint64_t next_time();
+    bool pop_due(uint64_t now, uint32_t &source);
+
+private:
+    struct event
+    {
+        uint64_t when;
+        uint32_t source;
+        uint32_t generation;
+
+        bool operator>(const event &e) const { return when > e.when; }
+    };
+
+    void drop_stale();
+
+    std::priority_queue<event, std::vector<event>, std::greater<event>> heap;
+    std::vector<uint32_t> generation;   ///< Current generation of each source.
+};
+
+#endif
@@ -0,0 +1,113 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#include "fuzz_harness.h"
+#include "elf_file.h"
+#include <cstring>
+
+/**
+ * fuzz_harness() makes a memory of mem_size bytes and a hart for it.
+ *
+ ********************************************************************************/
+
+fuzz_harness::fuzz_harness(uint32_t mem_size, bool rvc) : mem(mem_size), core(mem)
+{
+    core.set_rvc(rvc);
+}
+
+/**
+ * start() loads fname, runs it from its entry point up to the snapshot
+ * pc, if one is set, for at most the instruction limit, and takes the
+ * snapshot. Without set_input() the input buffer is the 4 KiB after the
+ * image, or what memory is left.
+ *
+ * @return false, with a message on std::cerr, if the image cannot be
+ *         loaded, the buffer does not fit in memory or the program halts
+ *         or reaches the limit before the snapshot pc.
+ *
+ ********************************************************************************/
+
+bool fuzz_harness::start(const std::string &fname)
+{
+    elf_file elf;
+    if (!(elf_file::is_elf(fname) ? elf.load(fname, mem) : mem.load_file(fname)))
+        return false;
+
+    if (!has_input)
+    {
+        input_addr = (mem.get_image_size() + 15) & 0xfffffff0;
+        input_len = input_addr < mem.get_size() ? mem.get_size() - input_addr : 0;
+        if (input_len > 0x1000)
+            input_len = 0x1000;
+    }
+    if (input_len == 0 || uint64_t(input_addr) + input_len > mem.get_size())
+    {
+        std::cerr << "The input buffer does not fit in memory." << std::endl;
+        return false;
+    }
+
+    core.reset();                       // programs expect a valid sp
+    core.set_pc(elf.get_entry());
+    while (has_snapshot_pc && core.get_pc() != snapshot_pc && !core.is_halted() && core.get_insn_counter() < limit)
+        core.step();
+
+    if (core.is_halted())
+    {
+        std::cerr << "The program halted before " << to_hex0x32(snapshot_pc)
+                  << ". Reason: " << core.get_halt_reason() << std::endl;
+        return false;
+    }
+    if (has_snapshot_pc && core.get_pc() != snapshot_pc)
+    {
+        std::cerr << "The program did not reach " << to_hex0x32(snapshot_pc) << " in "
+                  << std::dec << limit << " instructions." << std::endl;
+        return false;
+    }
+
+    core.snapshot();
+    snapshot_insns = core.get_insn_counter();
+    core.set_coverage(coverage.data());
+    return true;
+}
+
+/**
+ * run() runs the program from the snapshot on one input, of which only
+ * the first get_input_len() bytes are used.
+ *
+ * @return Whether it finished, reached the limit or crashed.
+ *
+ ********************************************************************************/
+
+fuzz_harness::outcome fuzz_harness::run(const uint8_t *data, size_t size)
+{
+    core.reset_to_snapshot();
+
+    uint32_t n = size < input_len ? size : input_len;
+    mem.load_segment(input_addr, data, n, n);
+    core.set_reg(10, input_addr);
+    core.set_reg(11, n);
+    std::memset(coverage.data(), 0, coverage_size);
+
+    sigjmp_buf faulted;                 // where a guest access outside RAM lands with guard pages
+    memory::fault_scope scope(faulted);
+    if (sigsetjmp(faulted, 0) != 0)
+    {
+        core.access_fault(memory::get_fault_addr());
+    }
+
+    while (!core.is_halted())
+    {
+        if (get_insns() >= limit)
+            return timed_out;
+        core.tick();
+    }
+
+    const std::string &reason = core.get_halt_reason();
+    if (reason == "EBREAK instruction" || reason == "ECALL instruction")
+        return finished;
+    return crashed;
+}
@@ -0,0 +1,69 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#ifndef H_FUZZ_HARNESS
+#define H_FUZZ_HARNESS
+
+#include "cpu_single_hart.h"
+#include "memory.h"
+#include <string>
+#include <vector>
+
+/**
+ * fuzz_harness runs one guest program on many inputs in process.
+ *
+ * start() loads the image once, runs it from its entry point up to the
+ * snapshot pc and takes a snapshot of memory, registers, CSRs and pending
+ * events there. Each run() then resets to the snapshot, restoring only the
+ * pages the last run wrote, copies the input into the guest buffer, with its address in
+ * a0 and its length in a1, and interprets the program until it halts or
+ * reaches the instruction limit. The branch and jump handlers count the
+ * edges taken in a coverage map, cleared before each run.
+ *
+ * A run that ends in EBREAK or ECALL, or reaches the limit, is fine; any
+ * other halt (illegal instruction, misaligned pc, access fault in a
+ * guard page build) is a crash.
+ *
+ ********************************************************************************/
+
+class fuzz_harness : public hex
+{
+public:
+    enum outcome { finished, timed_out, crashed };
+
+    static constexpr uint32_t coverage_size = 1 << rv32i_hart::coverage_bits;
+
+    fuzz_harness(uint32_t mem_size, bool rvc);
+
+    void set_snapshot_pc(uint32_t pc) { snapshot_pc = pc; has_snapshot_pc = true; }
+    void set_input(uint32_t addr, uint32_t len) { input_addr = addr; input_len = len; has_input = true; }
+    void set_limit(uint64_t n) { limit = n; }
+
+    bool start(const std::string &fname);
+    outcome run(const uint8_t *data, size_t size);
+
+    uint8_t *get_coverage() { return coverage.data(); }
+    const std::string &get_halt_reason() const { return core.get_halt_reason(); }
+    uint64_t get_insns() const { return core.get_insn_counter() - snapshot_insns; }
+    uint32_t get_input_addr() const { return input_addr; }
+    uint32_t get_input_len() const { return input_len; }
+
+private:
+    memory mem;
+    cpu_single_hart core;
+    std::vector<uint8_t> coverage = std::vector<uint8_t>(coverage_size);
+
+    uint32_t snapshot_pc = { 0 };
+    bool has_snapshot_pc = { false };
+    uint32_t input_addr = { 0 };
+    uint32_t input_len = { 0 };
+    bool has_input = { false };
+    uint64_t limit = { 100000 };
+    uint64_t snapshot_insns = { 0 };    ///< Instructions run up to the snapshot.
+};
+
+#endif
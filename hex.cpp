@@ -106,4 +106,48 @@ std::string hex::to_hex0x12(uint32_t i)
     std::ostringstream ops;
     ops << std::hex << std::setfill('0') << std::setw(3) << i;
     return std::string("0x")+ops.str();  
-}
\ No newline at end of file
+}
+
+/**
+ * append_hex() writes a zero-padded hex value into a character buffer.
+ *
+ * @param p Where to write. There must be room for width+2 characters.
+ * @param val The value.
+ * @param width The number of hex digits.
+ * @param prefix Write "0x" first.
+ *
+ * @return Returns the position after the last character written.
+ *
+ ********************************************************************************/
+
+char *hex::append_hex(char *p, uint32_t val, int width, bool prefix)
+{
+    static const char xdigits[] = "0123456789abcdef";
+
+    if (prefix)
+    {
+        *p++ = '0';
+        *p++ = 'x';
+    }
+
+    for (int i = width-1; i >= 0; --i)
+    {
+        p[i] = xdigits[val & 0xf];
+        val >>= 4;
+    }
+
+    return p + width;
+}
+
+/**
+ * operator<<() streams a hex::digits value, as to_hex32() and friends
+ * would format it, without allocating.
+ *
+ ********************************************************************************/
+
+std::ostream &operator<<(std::ostream &os, const hex::digits &d)
+{
+    char buf[12];
+    char *end = hex::append_hex(buf, d.val, d.width, d.prefix);
+    return os.write(buf, end - buf);
+}
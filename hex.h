@@ -20,6 +20,24 @@ public:
     static std::string to_hex0x32(uint32_t i);
     static std::string to_hex0x20(uint32_t i);
     static std::string to_hex0x12(uint32_t i);
+
+    /// A value to be streamed in hex without building a string.
+    struct digits
+    {
+        uint32_t val;
+        int width;
+        bool prefix;
+    };
+
+    static digits hex8(uint8_t i) { return { i, 2, false }; }
+    static digits hex32(uint32_t i) { return { i, 8, false }; }
+    static digits hex0x32(uint32_t i) { return { i, 8, true }; }
+    static digits hex0x20(uint32_t i) { return { i, 5, true }; }
+    static digits hex0x12(uint32_t i) { return { i, 3, true }; }
+
+    static char *append_hex(char *p, uint32_t val, int width, bool prefix);
 };
 
+std::ostream &operator<<(std::ostream &os, const hex::digits &d);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,227 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#include "hle.h"
+#include <sstream>
+
+/**
+ * add() parses a binding of the form name[=addr][:base[:per_byte]].
+ *
+ * name is memcpy, memset, strlen or memcmp. addr is the hex address of
+ * the guest function; without it the address is looked up by name in
+ * resolve(). base (default 1) and per_byte (default 0) are decimal.
+ *
+ * @return false, with error set, if the spec is malformed.
+ *
+ ********************************************************************************/
+
+bool hle::add(const std::string &spec, std::string &error)
+{
+    size_t colon = spec.find(':');
+    std::string head = spec.substr(0, colon);
+    size_t eq = head.find('=');
+
+    binding b;
+    b.name = head.substr(0, eq);
+    b.has_addr = (eq != std::string::npos);
+    b.addr = 0;
+    b.base = 1;
+    b.per_byte = 0;
+
+    if (b.name == "memcpy") b.fn = fn_memcpy;
+    else if (b.name == "memset") b.fn = fn_memset;
+    else if (b.name == "strlen") b.fn = fn_strlen;
+    else if (b.name == "memcmp") b.fn = fn_memcmp;
+    else
+    {
+        error = "unknown HLE function '" + b.name + "'";
+        return false;
+    }
+
+    if (b.has_addr)
+    {
+        std::istringstream iss(head.substr(eq+1));
+        if (!(iss >> std::hex >> b.addr) || !iss.eof() || (b.addr & 1))
+        {
+            error = "bad HLE address in '" + spec + "'";
+            return false;
+        }
+    }
+
+    if (colon != std::string::npos)
+    {
+        std::istringstream iss(spec.substr(colon+1));
+        char sep;
+        if (!(iss >> b.base) || (!iss.eof() && (!(iss >> sep) || sep != ':' || !(iss >> b.per_byte) || !iss.eof())))
+        {
+            error = "bad HLE instruction count in '" + spec + "'";
+            return false;
+        }
+    }
+
+    bindings.push_back(b);
+    return true;
+}
+
+/**
+ * resolve() looks up the bindings given without an address and marks
+ * all bound addresses.
+ *
+ * @return false, with error set, if a name is not in the symbol table.
+ *
+ ********************************************************************************/
+
+bool hle::resolve(const elf_file &elf, std::string &error)
+{
+    for (binding &b : bindings)
+    {
+        if (!b.has_addr && !elf.lookup(b.name, b.addr))
+        {
+            error = elf.has_symbols() ? "no symbol '" + b.name + "' in the ELF file"
+                                      : "no symbol table to find '" + b.name + "' in; give its address";
+            return false;
+        }
+        b.has_addr = true;
+
+        uint32_t i = (b.addr & ~1u) >> 1;
+        if ((i >> 6) >= bitmap.size())
+            bitmap.resize((i >> 6) + 1, 0);
+        bitmap[i >> 6] |= uint64_t(1) << (i & 63);
+    }
+    return true;
+}
+
+/**
+ * call() runs the function bound at pc.
+ *
+ * @param pc The bound address reached.
+ * @param regs The hart's registers: arguments in, result out in a0.
+ * @param comment Set to the call and its result, for the trace.
+ *
+ * @return The number of instructions to count for the call.
+ *
+ ********************************************************************************/
+
+uint64_t hle::call(uint32_t pc, registerfile &regs, std::string &comment)
+{
+    const binding *b = nullptr;
+    for (const binding &x : bindings)
+    {
+        if ((x.addr & ~1u) == pc)
+        {
+            b = &x;
+            break;
+        }
+    }
+    if (!b)
+        return 0;
+
+    uint32_t a0 = regs.get(10);
+    uint32_t a1 = regs.get(11);
+    uint32_t a2 = regs.get(12);
+    uint32_t result = 0;
+    uint32_t bytes = 0;
+
+    std::ostringstream os;
+    os << b->name << "(" << hex0x32(a0);
+
+    switch (b->fn)
+    {
+        case fn_memcpy:
+            os << ", " << hex0x32(a1) << ", " << hex0x32(a2);
+            result = do_memcpy(a0, a1, a2);
+            bytes = a2;
+            break;
+
+        case fn_memset:
+            os << ", " << hex0x32(a1) << ", " << hex0x32(a2);
+            result = do_memset(a0, a1, a2);
+            bytes = a2;
+            break;
+
+        case fn_strlen:
+            result = do_strlen(a0);
+            bytes = result + 1;
+            break;
+
+        case fn_memcmp:
+            os << ", " << hex0x32(a1) << ", " << hex0x32(a2);
+            result = do_memcmp(a0, a1, a2, bytes);
+            break;
+    }
+
+    os << ") = " << hex0x32(result);
+    comment = os.str();
+
+    regs.set(10, result);
+    return b->base + uint64_t(b->per_byte) * bytes;
+}
+
+/**
+ * do_memcpy() copies n bytes. Overlapping ranges are copied forwards a
+ * byte at a time, as a simple memcpy would.
+ *
+ ********************************************************************************/
+
+uint32_t hle::do_memcpy(uint32_t dst, uint32_t src, uint32_t n)
+{
+    bool overlap = uint64_t(src) + n > dst && uint64_t(dst) + n > src;
+    if (overlap || !mem.copy(dst, src, n))
+    {
+        for (uint32_t i = 0; i < n; ++i)
+            mem.set8(dst + i, mem.get8(src + i));
+    }
+    return dst;
+}
+
+uint32_t hle::do_memset(uint32_t dst, uint32_t c, uint32_t n)
+{
+    if (!mem.fill(dst, n, c, 1))
+    {
+        for (uint32_t i = 0; i < n; ++i)
+            mem.set8(dst + i, c);
+    }
+    return dst;
+}
+
+/**
+ * do_strlen() counts the bytes before the terminating zero. It stops at
+ * the end of memory, where reads give zero.
+ *
+ ********************************************************************************/
+
+uint32_t hle::do_strlen(uint32_t s) const
+{
+    uint32_t n = 0;
+    while (s + n < mem.get_size() && mem.get8(s + n))
+        ++n;
+    return n;
+}
+
+/**
+ * do_memcmp() compares n bytes as unsigned chars.
+ *
+ * @param bytes Set to the number of bytes compared.
+ *
+ * @return The difference of the first differing bytes, or 0.
+ *
+ ********************************************************************************/
+
+int32_t hle::do_memcmp(uint32_t a, uint32_t b, uint32_t n, uint32_t &bytes) const
+{
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        int32_t d = int32_t(mem.get8(a + i)) - int32_t(mem.get8(b + i));
+        if (d != 0)
+        {
+            bytes = i + 1;
+            return d;
+        }
+    }
+    bytes = n;
+    return 0;
+}
@@ -0,0 +1,75 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#ifndef H_HLE
+#define H_HLE
+
+#include "hex.h"
+#include "memory.h"
+#include "registerfile.h"
+#include "elf_file.h"
+#include <string>
+#include <vector>
+
+/**
+ * hle runs bound guest library functions natively on the host.
+ *
+ * A binding ties one of memcpy, memset, strlen or memcmp to the guest
+ * address of its entry point, looked up in the ELF symbol table or given
+ * directly. When the hart reaches a bound address, call() carries out
+ * the function on guest memory with its arguments in a0-a2, puts the
+ * result in a0 and leaves the return address for the hart to jump to.
+ * The call counts as base instructions plus per_byte for each byte the
+ * function copies, sets, measures or compares. No other register is
+ * changed.
+ *
+ * Bound addresses are marked in a bitmap, one bit per halfword, so the
+ * hart needs only one bit test per instruction to find them.
+ *
+ ********************************************************************************/
+
+class hle : public hex
+{
+public:
+    hle(memory &m) : mem(m) { }
+
+    bool add(const std::string &spec, std::string &error);
+    bool resolve(const elf_file &elf, std::string &error);
+    bool empty() const { return bindings.empty(); }
+
+    bool is_bound(uint32_t pc) const
+    {
+        uint32_t i = pc >> 1;
+        return (i >> 6) < bitmap.size() && (bitmap[i >> 6] >> (i & 63)) & 1;
+    }
+
+    uint64_t call(uint32_t pc, registerfile &regs, std::string &comment);
+
+private:
+    enum routine { fn_memcpy, fn_memset, fn_strlen, fn_memcmp };
+
+    struct binding
+    {
+        routine fn;
+        std::string name;
+        bool has_addr;
+        uint32_t addr;
+        uint32_t base;                  ///< Instructions counted per call.
+        uint32_t per_byte;              ///< Instructions counted per byte.
+    };
+
+    uint32_t do_memcpy(uint32_t dst, uint32_t src, uint32_t n);
+    uint32_t do_memset(uint32_t dst, uint32_t c, uint32_t n);
+    uint32_t do_strlen(uint32_t s) const;
+    int32_t do_memcmp(uint32_t a, uint32_t b, uint32_t n, uint32_t &bytes) const;
+
+    memory &mem;
+    std::vector<binding> bindings;
+    std::vector<uint64_t> bitmap;
+};
+
+#endif
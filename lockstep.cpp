@@ -0,0 +1,311 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#include "lockstep.h"
+#include "rv32i_asm.h"
+#include <algorithm>
+
+/**
+ * parse_granularity() converts a -x argument into a granularity.
+ *
+ * @param s One of "insn", "block" or "halt".
+ * @param g Set to the matching granularity.
+ *
+ * @return false if the string is not recognized.
+ *
+ ********************************************************************************/
+
+bool lockstep::parse_granularity(const std::string &s, granularity &g)
+{
+    if (s == "insn")
+        g = every_insn;
+    else if (s == "block")
+        g = every_block;
+    else if (s == "halt")
+        g = at_halt;
+    else
+        return false;
+
+    return true;
+}
+
+/**
+ * run() executes the reference and the candidate side by side and compares
+ * their architectural state.
+ *
+ * The reference is stepped one instruction at a time with step(). After
+ * each reference step the candidate is stepped until it has retired at
+ * least as many instructions. State is compared whenever both have retired
+ * the same number of instructions and the granularity calls for it.
+ * Except at halt granularity the candidate does not chain uops, so that
+ * a step retires one instruction, or a fused pair or skipped idle loop,
+ * rather than running on to the halt.
+ *
+ * A divergence found at block or halt granularity is pinpointed by
+ * replaying both engines from scratch at instruction granularity up to
+ * the point where it was seen.
+ *
+ * @param exec_limit Maximum number of instructions to execute, 0 = no limit.
+ * @param g How often to compare state.
+ *
+ * @return true if no divergence was found.
+ *
+ ********************************************************************************/
+
+bool lockstep::run(uint64_t exec_limit, granularity g)
+{
+    if (run_once(exec_limit, g))
+    {
+        std::cout << "Lockstep: no divergence in " << std::dec << ref.core->get_insn_counter()
+                  << " instructions. Reason: " << ref.core->get_halt_reason() << std::endl;
+        return true;
+    }
+
+    if (g != every_insn)
+    {
+        std::string coarse = report.str();
+
+        if (!run_once(diverged_at, every_insn))
+        {
+            std::cout << report.str();
+            return false;
+        }
+
+        std::cout << coarse;            // replay did not reproduce it
+        return false;
+    }
+
+    std::cout << report.str();
+    return false;
+}
+
+/**
+ * start() builds a fresh memory and hart for both engines.
+ *
+ * @return false if either setup function fails.
+ *
+ ********************************************************************************/
+
+bool lockstep::start()
+{
+    ref.core.reset();                   // a hart must go before its memory
+    ref.mem.reset(new memory(mem_size));
+    ref.core.reset(new cpu_single_hart(*ref.mem));
+    ref.writes.clear();
+
+    cand.core.reset();
+    cand.mem.reset(new memory(mem_size));
+    cand.core.reset(new cpu_single_hart(*cand.mem));
+    cand.writes.clear();
+
+    window.clear();
+    report.str("");
+
+    return reference_setup(*ref.mem, *ref.core) && candidate_setup(*cand.mem, *cand.core);
+}
+
+/**
+ * run_once() is one lockstep pass from a fresh start.
+ *
+ * @param exec_limit Maximum number of instructions to execute, 0 = no limit.
+ * @param g How often to compare state.
+ *
+ * @return true if no divergence was found. Otherwise "report" holds the
+ *         details and "diverged_at" the reference instruction count.
+ *
+ ********************************************************************************/
+
+bool lockstep::run_once(uint64_t exec_limit, granularity g)
+{
+    if (!start())
+    {
+        report << "Lockstep: setup failed\n";
+        return false;
+    }
+
+    if (g != at_halt)
+    {
+        ref.mem->set_write_log(&ref.writes);
+        cand.mem->set_write_log(&cand.writes);
+    }
+
+    cpu_single_hart &r = *ref.core;
+    cpu_single_hart &c = *cand.core;
+    c.set_insn_limit(exec_limit);       // groups and skips stop at the limit
+    c.set_chaining(g == at_halt);       // a chain would run on past the divergence
+
+    while (true)
+    {
+        uint32_t pc = r.get_pc();
+        uint32_t insn = ref.mem->peek32(pc);
+        r.step();
+
+        if (g != at_halt)
+        {
+            window.push_back(std::make_pair(pc, insn));
+        }
+
+        while (!c.is_halted() && c.get_insn_counter() < r.get_insn_counter())
+        {
+            c.step();
+        }
+
+        bool done = r.is_halted() || (exec_limit != 0 && r.get_insn_counter() >= exec_limit);
+
+        if (!done && c.get_insn_counter() > r.get_insn_counter())
+        {
+            continue;                   // the candidate retired a group at once, maybe halting
+        }
+
+        bool sync = done || c.is_halted() || g == every_insn
+                 || (g == every_block && is_control_transfer(insn));
+
+        if (sync)
+        {
+            if (!compare(done && g == at_halt))
+            {
+                diverged_at = r.get_insn_counter();
+                return false;
+            }
+
+            if (done || c.is_halted())
+            {
+                return true;
+            }
+
+            window.clear();
+        }
+    }
+}
+
+/**
+ * compare() checks the reference against the candidate.
+ *
+ * Compares the instruction counts, halt state, pc and all registers, and
+ * every memory byte written by either engine since the last compare. At
+ * halt granularity, when no write logs are kept, the full memories are
+ * compared instead.
+ *
+ * @param full_memory Compare every byte of memory.
+ *
+ * @return true if the states match. Otherwise the differences and the
+ *         instructions retired since the last compare are added to "report".
+ *
+ ********************************************************************************/
+
+bool lockstep::compare(bool full_memory)
+{
+    const cpu_single_hart &r = *ref.core;
+    const cpu_single_hart &c = *cand.core;
+    std::ostringstream diffs;
+
+    if (r.get_insn_counter() != c.get_insn_counter())
+    {
+        diffs << "  instructions: reference " << std::dec << r.get_insn_counter()
+              << ", candidate " << c.get_insn_counter() << "\n";
+    }
+
+    if (r.is_halted() != c.is_halted() || r.get_halt_reason() != c.get_halt_reason())
+    {
+        diffs << "  halt: reference " << (r.is_halted() ? r.get_halt_reason() : "running")
+              << ", candidate " << (c.is_halted() ? c.get_halt_reason() : "running") << "\n";
+    }
+
+    if (r.get_pc() != c.get_pc())
+    {
+        diffs << "  pc: reference " << hex0x32(r.get_pc())
+              << ", candidate " << hex0x32(c.get_pc()) << "\n";
+    }
+
+    for (uint32_t i = 1; i < 32; ++i)
+    {
+        if (r.get_reg(i) != c.get_reg(i))
+        {
+            diffs << "  " << reg(i) << ": reference " << hex0x32(r.get_reg(i))
+                  << ", candidate " << hex0x32(c.get_reg(i)) << "\n";
+        }
+    }
+
+    std::vector<uint32_t> addrs;
+    if (full_memory)
+    {
+        for (uint32_t i = 0; i < ref.mem->get_size(); ++i)
+            addrs.push_back(i);
+    }
+    else
+    {
+        addrs = ref.writes;
+        addrs.insert(addrs.end(), cand.writes.begin(), cand.writes.end());
+        std::sort(addrs.begin(), addrs.end());
+        addrs.erase(std::unique(addrs.begin(), addrs.end()), addrs.end());
+    }
+    ref.writes.clear();
+    cand.writes.clear();
+
+    for (uint32_t addr : addrs)
+    {
+        uint8_t rv = ref.mem->peek8(addr);
+        uint8_t cv = cand.mem->peek8(addr);
+
+        if (rv != cv)
+        {
+            diffs << "  m8(" << hex0x32(addr) << "): reference " << hex0x32(rv)
+                  << ", candidate " << hex0x32(cv) << "\n";
+        }
+    }
+
+    if (diffs.str().empty())
+    {
+        return true;
+    }
+
+    report << "Lockstep divergence after " << std::dec << r.get_insn_counter() << " instructions\n";
+    report << "Reference instructions since the last matching state:\n";
+    for (const auto &w : window)
+    {
+        if ((w.second & 0x3) != 0x3)
+        {
+            uint16_t parcel = w.second & 0xffff;
+            report << "  " << hex32(w.first) << ":     " << digits{ parcel, 4, false }
+                   << "  " << decode(w.first, rv32i_asm::expand_compressed(parcel)) << "\n";
+            continue;
+        }
+        report << "  " << hex32(w.first) << ": " << hex32(w.second) << "  "
+               << decode(w.first, w.second) << "\n";
+    }
+    report << "Differences:\n" << diffs.str();
+
+    return false;
+}
+
+/**
+ * is_control_transfer() is true for instructions that end a basic block.
+ * Compressed instructions are classified by their expanded form.
+ *
+ ********************************************************************************/
+
+bool lockstep::is_control_transfer(uint32_t insn)
+{
+    if ((insn & 0x3) != 0x3)
+        insn = rv32i_asm::expand_compressed(insn & 0xffff);
+
+    const rv32i_isa::insn_info &i = rv32i_isa::lookup(insn);
+
+    switch (i.fmt)
+    {
+        case rv32i_isa::fmt_j:
+        case rv32i_isa::fmt_jalr:
+        case rv32i_isa::fmt_b:
+        case rv32i_isa::fmt_csr:
+        case rv32i_isa::fmt_csri:
+            return true;
+        case rv32i_isa::fmt_none:
+            return i.id != rv32i_isa::id_illegal;
+        default:
+            return false;
+    }
+}
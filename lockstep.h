@@ -0,0 +1,61 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#ifndef H_LOCKSTEP
+#define H_LOCKSTEP
+
+#include "cpu_single_hart.h"
+#include "memory.h"
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+class lockstep : public rv32i_decode
+{
+public:
+    enum granularity { every_insn, every_block, at_halt };
+
+    /// Loads the image into a fresh memory and configures a fresh hart.
+    typedef std::function<bool(memory&, cpu_single_hart&)> setup_fn;
+
+    lockstep(uint32_t mem_size, const setup_fn &reference_setup, const setup_fn &candidate_setup)
+        : mem_size(mem_size), reference_setup(reference_setup), candidate_setup(candidate_setup) { }
+
+    bool run(uint64_t exec_limit, granularity g);
+
+    static bool parse_granularity(const std::string &s, granularity &g);
+
+private:
+    struct engine
+    {
+        std::unique_ptr<memory> mem;
+        std::unique_ptr<cpu_single_hart> core;
+        std::vector<uint32_t> writes;
+    };
+
+    bool start();
+    bool run_once(uint64_t exec_limit, granularity g);
+    bool compare(bool full_memory);
+    static bool is_control_transfer(uint32_t insn);
+
+    uint32_t mem_size;
+    setup_fn reference_setup;
+    setup_fn candidate_setup;
+
+    engine ref;
+    engine cand;
+
+    /// The (pc, insn) pairs the reference retired since the last compare.
+    std::vector<std::pair<uint32_t, uint32_t>> window;
+
+    std::ostringstream report;
+    uint64_t diverged_at = { 0 };
+};
+
+#endif
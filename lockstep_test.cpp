@@ -0,0 +1,173 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#include "lockstep.h"
+#include "rv32i_asm.h"
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * lockstep_test.cpp checks that lockstep pinpoints a divergence.
+ *
+ * The candidate runs the same program as the reference except for one
+ * instruction, an xor patched into an or, standing in for a fast path
+ * bug. The divergence comes after a loop the candidate could otherwise
+ * chain through, and at every granularity the report must show the
+ * patched instruction as the only one since the last matching state.
+ *
+ * A second program checks that pairs with rd x0, which must not be
+ * fused, run the same on the fast path as on the interpreter.
+ *
+ * Built and run by make test; the exit status is 1 if a check fails.
+ *
+ ********************************************************************************/
+
+static const uint32_t mem_size = 0x1000;
+
+/**
+ * program() sums 1..100 in a loop, then combines the results with an xor
+ * at diverging_pc.
+ *
+ ********************************************************************************/
+
+static const uint32_t diverging_pc = 0x1c;
+
+static std::vector<uint32_t> program()
+{
+    return {
+        rv32i_asm::encode_addi(5, 0, 100),      // 00: t0 = 100
+        rv32i_asm::encode_addi(6, 0, 0),        // 04: t1 = 0
+        rv32i_asm::encode_addi(7, 0, 0),        // 08: t2 = 0
+        rv32i_asm::encode_add(6, 6, 5),         // 0c: loop: t1 += t0
+        rv32i_asm::encode_addi(7, 7, 3),        // 10: t2 += 3
+        rv32i_asm::encode_addi(5, 5, -1),       // 14: t0 -= 1
+        rv32i_asm::encode_bne(5, 0, -12),       // 18: bne t0, zero, loop
+        rv32i_asm::encode_xor(8, 6, 7),         // 1c: s0 = t1 ^ t2
+        rv32i_asm::encode_addi(9, 8, 1),        // 20: s1 = s0 + 1
+        rv32i_asm::encode_ebreak(),             // 24
+    };
+}
+
+static bool load(memory &m, cpu_single_hart &c, bool patched)
+{
+    std::vector<uint32_t> words = program();
+    if (patched)
+        words[diverging_pc / 4] = rv32i_asm::encode_or(8, 6, 7);
+
+    c.reset();
+    for (uint32_t i = 0; i < words.size(); ++i)
+        m.set32(i * 4, words[i]);
+    c.set_pc(0);
+    return true;
+}
+
+/**
+ * check() runs lockstep at granularity g and checks its report.
+ *
+ * @return true if lockstep diverged at diverging_pc.
+ *
+ ********************************************************************************/
+
+static bool check(const std::string &name, lockstep::granularity g)
+{
+    lockstep::setup_fn reference = [](memory &m, cpu_single_hart &c) { return load(m, c, false); };
+    lockstep::setup_fn candidate = [](memory &m, cpu_single_hart &c)
+    {
+        c.set_fast_path(true);
+        return load(m, c, true);
+    };
+
+    std::ostringstream out;
+    std::streambuf *saved = std::cout.rdbuf(out.rdbuf());
+    bool same = lockstep(mem_size, reference, candidate).run(0, g);
+    std::cout.rdbuf(saved);
+
+    std::string report = out.str();
+    std::string header = "Reference instructions since the last matching state:\n";
+    std::string expected = header + "  " + hex::to_hex32(diverging_pc) + ": "
+                         + hex::to_hex32(program()[diverging_pc / 4]) + "  xor ";
+
+    size_t at = report.find(header);
+    bool ok = !same && at != std::string::npos
+           && report.compare(at, expected.size(), expected) == 0
+           && report.find("\nDifferences:\n", at) == report.find('\n', at + header.size());
+
+    std::cout << "lockstep -x " << name << ": " << (ok ? "ok" : "FAILED") << std::endl;
+    if (!ok)
+        std::cout << report;
+    return ok;
+}
+
+/**
+ * x0_pairs() loads and jumps through x0 right after an auipc x0, which
+ * only a fused pair would treat as a pc relative base.
+ *
+ ********************************************************************************/
+
+static std::vector<uint32_t> x0_pairs()
+{
+    return {
+        rv32i_asm::encode_addi(5, 0, 64),       // 00: t0 = 64
+        rv32i_asm::encode_auipc(0, 1),          // 04: auipc zero, 1
+        rv32i_asm::encode_lw(10, 0, 0x20),      // 08: a0 = [0x20]
+        rv32i_asm::encode_auipc(0, 0),          // 0c: auipc zero, 0
+        rv32i_asm::encode_jalr(1, 0, 0x1c),     // 10: jalr ra, 0x1c(zero)
+        rv32i_asm::encode_addi(11, 0, 1),       // 14: a1 = 1, skipped
+        rv32i_asm::encode_ebreak(),             // 18
+        rv32i_asm::encode_ebreak(),             // 1c
+        0x11111111,                             // 20: data
+    };
+}
+
+static bool load_x0_pairs(memory &m, cpu_single_hart &c)
+{
+    std::vector<uint32_t> words = x0_pairs();
+
+    c.reset();
+    for (uint32_t i = 0; i < words.size(); ++i)
+        m.set32(i * 4, words[i]);
+    c.set_pc(0);
+    return true;
+}
+
+/**
+ * check_x0_pairs() runs x0_pairs() in lockstep against the fast path.
+ *
+ * @return true if no divergence was found.
+ *
+ ********************************************************************************/
+
+static bool check_x0_pairs()
+{
+    lockstep::setup_fn reference = load_x0_pairs;
+    lockstep::setup_fn candidate = [](memory &m, cpu_single_hart &c)
+    {
+        c.set_fast_path(true);
+        return load_x0_pairs(m, c);
+    };
+
+    std::ostringstream out;
+    std::streambuf *saved = std::cout.rdbuf(out.rdbuf());
+    bool same = lockstep(mem_size, reference, candidate).run(0, lockstep::every_insn);
+    std::cout.rdbuf(saved);
+
+    std::cout << "lockstep rd x0 pairs: " << (same ? "ok" : "FAILED") << std::endl;
+    if (!same)
+        std::cout << out.str();
+    return same;
+}
+
+int main()
+{
+    bool ok = check("insn", lockstep::every_insn);
+    ok = check("block", lockstep::every_block) && ok;
+    ok = check("halt", lockstep::at_halt) && ok;
+    ok = check_x0_pairs() && ok;
+    return ok ? 0 : 1;
+}
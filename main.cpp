@@ -8,9 +8,20 @@
 #include "hex.h"
 #include "memory.h"
 #include "rv32i_decode.h"
+#include "rv32i_asm.h"
 #include "rv32i_hart.h"
 #include "cpu_single_hart.h"
+#include "cpu_multi_instance.h"
+#include "memory_diff.h"
 #include "registerfile.h"
+#include "lockstep.h"
+#include "breakpoints.h"
+#include "watchpoints.h"
+#include "syscall_proxy.h"
+#include "devices.h"
+#include "elf_file.h"
+#include "hle.h"
+#include "rv32i_cfg.h"
 #include <iostream>
 #include <unistd.h>
 #include <vector>
@@ -22,19 +33,52 @@
  * This function formats the output and calls the decode() function to decode
  * the rv32i instructions (stored in mem) into their most basic representative state. 
  *
+ * When rvc is set, 16-bit instructions are shown as their 4-digit parcel
+ * followed by the base instruction they expand to, and the address advances
+ * by the length of each instruction.
+ *
  ********************************************************************************/
 
-static void disassemble(const memory &mem)
+static void disassemble(const memory &mem, bool rvc)
 {
 	uint32_t vectorSize = mem.get_size();
+	char text[rv32i_decode::render_size];
 
-    for (uint32_t i = 0; i < vectorSize; i += 4)  // Iterate through memory
+    for (uint32_t i = 0; i < vectorSize; )  // Iterate through memory
     {
-		std::cout << hex::to_hex32(i) << ": " << std::setw(8) << std::setfill('0') << std::hex 
-				  << mem.get32(i) << "  " << rv32i_decode::decode(i, mem.get32(i)) << std::endl;
+		uint32_t insn = mem.peek32(i);
+
+		if (rvc && (insn & 0x3) != 0x3)
+		{
+			uint16_t parcel = insn & 0xffff;
+			rv32i_decode::render(rv32i_decode::decode_insn(i, rv32i_asm::expand_compressed(parcel)), text, sizeof(text));
+			std::cout << hex::hex32(i) << ": " << "    " << hex::digits{ parcel, 4, false } << "  " << text << '\n';
+			i += 2;
+			continue;
+		}
+
+		rv32i_decode::render(rv32i_decode::decode_insn(i, insn), text, sizeof(text));
+		std::cout << hex::hex32(i) << ": " << hex::hex32(insn) << "  " << text << '\n';
+		i += 4;
 	}
 }
 
+/**
+ * load_program() loads infile: the segments of an ELF executable, or
+ * else the raw contents of the file from address 0.
+ *
+ * @param elf Holds the ELF file's entry point and symbols afterwards.
+ *
+ ********************************************************************************/
+
+static bool load_program(const std::string &fname, memory &mem, elf_file &elf)
+{
+	if (elf_file::is_elf(fname))
+		return elf.load(fname, mem);
+
+	return mem.load_file(fname);
+}
+
 /**
  * usage() is a validity check.
  *
@@ -46,12 +90,31 @@ static void disassemble(const memory &mem)
 
 static void usage()
 {
-	std::cerr << "Usage: rv32i [-d] [-i] [-r] [-z] [-l exec-limit] [-m hex-mem-size] infile" << std::endl;
+	std::cerr << "Usage: rv32i [-c] [-d] [-i] [-r] [-z] [-b pc[:cond]] [-w r|w|c:addr[:len]] [-C checkpoint] [-D checkpoint] [-G cfg-file] [-H fn[=addr][:base[:per-byte]]] [-l exec-limit] [-m hex-mem-size] [-N count] [-O] [-p] [-s sandbox-dir] [-x insn|block|halt] infile" << std::endl;
+	std::cerr << "    -b stop before executing the instruction at pc (hex), optionally" << std::endl;
+	std::cerr << "       only when cond holds, e.g. -b 1a4:a0==3&&m32(sp+8)!=0" << std::endl;
+	std::cerr << "    -c enable the RV32C compressed instruction extension" << std::endl;
+	std::cerr << "    -C save the memory after simulation to checkpoint" << std::endl;
 	std::cerr << "    -d show disassembly before program execution" << std::endl;
+	std::cerr << "    -D show where the memory after simulation differs from checkpoint" << std::endl;
 	std::cerr << "    -i show instruction printing during execution" << std::endl;
+	std::cerr << "    -G write the control-flow graph found from the entry point and ELF" << std::endl;
+	std::cerr << "       functions to cfg-file, as JSON if it ends in .json, else as DOT" << std::endl;
+	std::cerr << "    -H run the guest's memcpy, memset, strlen or memcmp natively, found" << std::endl;
+	std::cerr << "       by ELF symbol or at addr (hex), counting base + per-byte insns" << std::endl;
 	std::cerr << "    -l maximum number of instructions to exec" << std::endl;
 	std::cerr << "    -m specify memory size (default = 0x100)" << std::endl;
+	std::cerr << "    -N run count instances of the program side by side, each with its" << std::endl;
+	std::cerr << "       instance number in a0 and mhartid (uses only -c, -l, -m and -z)" << std::endl;
+	std::cerr << "    -O run predecoded instructions, fusing common pairs, when not tracing" << std::endl;
+	std::cerr << "    -p map a UART at 0x10000000, a CLINT at 0x02000000 and a test" << std::endl;
+	std::cerr << "       finisher at 0x00100000" << std::endl;
 	std::cerr << "    -r show register printing during execution" << std::endl;
+	std::cerr << "    -s carry out ECALLs as host system calls, opening files in sandbox-dir" << std::endl;
+	std::cerr << "    -w stop after an instruction that reads (r), writes (w) or changes (c)" << std::endl;
+	std::cerr << "       len (hex, default 4) bytes at addr (hex), e.g. -w c:400:10" << std::endl;
+	std::cerr << "    -x run the reference and candidate engines in lockstep, comparing" << std::endl;
+	std::cerr << "       state after every instruction, every block or only at halt" << std::endl;
 	std::cerr << "    -z show a dump of the regs & memory after simulation" << std::endl;
 	exit(1);
 }
@@ -69,6 +132,7 @@ int main(int argc, char **argv)
 	uint32_t memory_limit = 0x100; // default memory size = 256 bytes
 	int opt;
 
+	bool cFlag = false;
 	bool dFlag = false;
 	bool zFlag = false;
 	bool iFlag = false;
@@ -76,7 +140,27 @@ int main(int argc, char **argv)
 
 	uint64_t limiter = 0;
 
-	while ((opt = getopt(argc, argv, "dirzm:l:")) != -1)
+	breakpoints bps;
+	watchpoints wps;
+
+	bool OFlag = false;
+	bool pFlag = false;
+
+	bool sFlag = false;
+	std::string sandbox;
+
+	bool xFlag = false;
+	lockstep::granularity granularity = lockstep::every_insn;
+
+	std::vector<std::string> hle_specs;
+
+	std::string cfg_file;
+	std::string save_checkpoint;
+	std::string diff_checkpoint;
+
+	uint32_t instances = 0;
+
+	while ((opt = getopt(argc, argv, "b:cC:dD:iG:H:N:Oprzm:l:s:w:x:")) != -1)
 	{
 		switch (opt)
 		{
@@ -86,6 +170,21 @@ int main(int argc, char **argv)
 			iss >> std::hex >> memory_limit;
 		}
 			break;
+		case 'b':
+		{
+			std::string error;
+			if (!bps.add(optarg, error))
+			{
+				std::cerr << error << std::endl;
+				usage();
+			}
+		}
+			break;
+		case 'c':
+		{
+			cFlag = true;
+		}
+			break;
 		case 'd':
 		{
 			dFlag = true;
@@ -96,11 +195,48 @@ int main(int argc, char **argv)
 			iFlag = true;
 		}
 			break;
+		case 'C':
+		{
+			save_checkpoint = optarg;
+		}
+			break;
+		case 'D':
+		{
+			diff_checkpoint = optarg;
+		}
+			break;
+		case 'G':
+		{
+			cfg_file = optarg;
+		}
+			break;
+		case 'H':
+		{
+			hle_specs.push_back(optarg);
+		}
+			break;
 		case 'l':
 		{
 			limiter = atoi(optarg);
 		}
 			break;
+		case 'N':
+		{
+			instances = atoi(optarg);
+			if (instances == 0)
+				usage();
+		}
+			break;
+		case 'O':
+		{
+			OFlag = true;
+		}
+			break;
+		case 'p':
+		{
+			pFlag = true;
+		}
+			break;
 		case 'r':
 		{
 			rFlag = true;
@@ -111,6 +247,29 @@ int main(int argc, char **argv)
 			zFlag = true;
 		}
 			break;
+		case 's':
+		{
+			sFlag = true;
+			sandbox = optarg;
+		}
+			break;
+		case 'w':
+		{
+			std::string error;
+			if (!wps.add(optarg, error))
+			{
+				std::cerr << error << std::endl;
+				usage();
+			}
+		}
+			break;
+		case 'x':
+		{
+			xFlag = true;
+			if (!lockstep::parse_granularity(optarg, granularity))
+				usage();
+		}
+			break;
 		default: /* '?' */
 			usage();
 		}
@@ -119,16 +278,118 @@ int main(int argc, char **argv)
 	if (optind >= argc)
 		usage(); // missing filename
 
+	if (xFlag == true)
+	{
+		std::string fname = argv[optind];
+		lockstep::setup_fn setup = [fname, cFlag](memory &m, cpu_single_hart &c)
+		{
+			c.reset();
+			c.set_rvc(cFlag);
+
+			elf_file elf;
+			if (!load_program(fname, m, elf))
+				return false;
+			c.set_pc(elf.get_entry());
+			return true;
+		};
+
+		lockstep::setup_fn fast_setup = [setup](memory &m, cpu_single_hart &c)
+		{
+			c.set_fast_path(true);
+			return setup(m, c);
+		};
+
+		lockstep ls(memory_limit, setup, fast_setup);
+		return ls.run(limiter, granularity) ? 0 : 1;
+	}
+
+	if (instances != 0)
+	{
+		std::string fname = argv[optind];
+		cpu_multi_instance::setup_fn setup = [fname, cFlag](memory &m, cpu_single_hart &c, uint32_t i)
+		{
+			c.reset();
+			c.set_rvc(cFlag);
+
+			elf_file elf;
+			if (!load_program(fname, m, elf))
+				return false;
+			c.set_pc(elf.get_entry());
+			c.set_reg(10, i);       // a0: which instance this is
+			return true;
+		};
+
+		cpu_multi_instance multi(instances, memory_limit, cFlag);
+		if (!multi.start(setup))
+			usage();
+		multi.run(limiter);
+
+		if (zFlag == true)
+			multi.dump();
+		return 0;
+	}
+
 	memory mem(memory_limit);
+	elf_file elf;
 
-	if (!mem.load_file(argv[optind]))
+	if (!load_program(argv[optind], mem, elf))
 		usage();
 
 	cpu_single_hart core(mem);
+	core.set_rvc(cFlag);
+	core.set_fast_path(OFlag);
+	core.set_breakpoints(&bps);
+	if (!wps.empty())
+		wps.attach(mem, core);
+
+	uart serial;
+	clint timer;
+	test_finisher finisher;
+	if (pFlag == true)
+	{
+		if (!mem.map_device(uart::default_base, uart::size, &serial)
+			|| !mem.map_device(clint::default_base, clint::size, &timer)
+			|| !mem.map_device(test_finisher::default_base, test_finisher::size, &finisher))
+		{
+			std::cerr << "Memory size overlaps the device regions, or guard pages are in use." << std::endl;
+			usage();
+		}
+		timer.attach(core);
+		finisher.attach(core);
+	}
+
+	hle calls(mem);
+	for (const std::string &spec : hle_specs)
+	{
+		std::string error;
+		if (!calls.add(spec, error))
+		{
+			std::cerr << error << std::endl;
+			usage();
+		}
+	}
+	if (!calls.empty())
+	{
+		std::string error;
+		if (!calls.resolve(elf, error))
+		{
+			std::cerr << error << std::endl;
+			usage();
+		}
+		core.set_hle(&calls);
+	}
+
+	syscall_proxy syscalls(mem, sandbox);
+	if (sFlag == true)
+	{
+		core.reset();   // programs using syscalls expect a valid sp
+		syscalls.set_brk((mem.get_image_size()+15)&0xfffffff0);
+		core.set_syscall_proxy(&syscalls);
+	}
 
 	if (dFlag == true) 
 	{
-		disassemble(mem);
+		disassemble(mem, cFlag);
 		core.reset();
 	}
 
@@ -144,6 +405,27 @@ int main(int argc, char **argv)
 		core.set_show_instructions(true);
 	}
 
+	if (OFlag == true || !cfg_file.empty())
+	{
+		rv32i_cfg cfg;
+		std::string entry_name;
+		for (const auto &f : elf.get_functions())
+		{
+			if (f.second == elf.get_entry())
+				entry_name = f.first;
+		}
+		cfg.add_root(elf.get_entry(), entry_name);
+		for (const auto &f : elf.get_functions())
+			cfg.add_root(f.second, f.first);
+		cfg.build(mem, cFlag);
+
+		if (!cfg_file.empty() && !cfg.save(cfg_file))
+			return 1;
+		if (OFlag == true)
+			core.pretranslate(cfg);
+	}
+
+	core.set_pc(elf.get_entry());
 	core.run(limiter);
 
 	if (zFlag == true) 
@@ -152,5 +434,21 @@ int main(int argc, char **argv)
 		mem.dump();
 	}
 
+	if (!diff_checkpoint.empty())
+	{
+		std::vector<uint8_t> image;
+		if (!memory_diff::load_checkpoint(diff_checkpoint, image))
+			return 1;
+		memory_diff(image.data(), image.size(), mem.get_data(), mem.get_size()).print(std::cout);
+	}
+
+	if (!save_checkpoint.empty() && !mem.save_file(save_checkpoint))
+		return 1;
+
+	if (syscalls.has_exited())
+		return syscalls.get_exit_code();
+	if (finisher.has_finished())
+		return finisher.get_exit_code();
+
 	return 0;
 }
@@ -6,11 +6,18 @@
 //******************************************************************
 
 #include "memory.h"
+#include "soft_tlb.h"
+#include <cstring>
+#include <sys/mman.h>
+
+std::vector<const memory*> memory::guarded;
+sigjmp_buf *memory::fault_jump = nullptr;
+uint32_t memory::fault_addr = 0;
 
 /**
- * memory() initializes every byte to 0xa5 in the "mem" vector.
+ * memory() initializes every byte of RAM to 0xa5.
  *
- * "siz" amount of bytes are allocated to the "mem" vector and
+ * "siz" amount of bytes are allocated for RAM and
  * "siz" is rounded up using the 'and' operator with bit manipulation.
  *
  * @param siz The amount of bytes representing memory size.
@@ -21,7 +28,41 @@ memory::memory(uint32_t siz)
 {
     siz = (siz+15)&0xfffffff0;
     
-    mem.resize(siz, 0xa5);
+#ifdef RV32I_GUARD_PAGES
+    // RAM ends on a host page boundary, so the first byte past it faults.
+    // Every address from there to 4 GiB and one word more stays reserved.
+    size_t host_page = sysconf(_SC_PAGESIZE);
+    size_t used = (size_t(siz) + host_page - 1) / host_page * host_page;
+    window_size = used + 0x100000000ull + host_page;
+    void *p = mmap(nullptr, window_size, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED || (used && mprotect(p, used, PROT_READ|PROT_WRITE) != 0))
+    {
+        std::cerr << "Can't reserve the guest address space.\n";
+        exit(1);
+    }
+    window = static_cast<uint8_t*>(p);
+    ram = window + used - siz;
+    std::memset(ram, 0xa5, siz);
+
+    if (guarded.empty())
+    {
+        struct sigaction sa = { };
+        sa.sa_sigaction = on_fault;
+        sa.sa_flags = SA_SIGINFO | SA_NODEFER;  // left by siglongjmp, so don't stay blocked
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGSEGV, &sa, nullptr);
+        sigaction(SIGBUS, &sa, nullptr);
+    }
+    guarded.push_back(this);
+#else
+    storage.resize(siz, 0xa5);
+    ram = storage.data();
+#endif
+    ram_size = siz;
+
+    page_flags.resize((siz + page_size - 1) >> page_shift, 0);
+    code_map.resize(page_flags.size(), 0);
+    code_gen.resize(page_flags.size(), 0);
 }
 
 /**
@@ -31,7 +72,38 @@ memory::memory(uint32_t siz)
 
 memory::~memory()
 {
+    if (window)
+    {
+        munmap(window, window_size);
+        for (size_t i = 0; i < guarded.size(); ++i)
+        {
+            if (guarded[i] == this)
+                guarded.erase(guarded.begin() + i);
+        }
+    }
+}
+
+/**
+ * on_fault() is the SIGSEGV and SIGBUS handler of guard page builds. A
+ * fault inside a memory's window while a fault_scope exists jumps to it,
+ * with the guest address kept for get_fault_addr(). For any other fault
+ * the default action is restored, so the access faults again and the
+ * simulator stops as it would have without the handler.
+ *
+ ********************************************************************************/
 
+void memory::on_fault(int sig, siginfo_t *info, void *)
+{
+    uint8_t *at = static_cast<uint8_t*>(info->si_addr);
+    for (const memory *m : guarded)
+    {
+        if (fault_jump && at >= m->window && at < m->window + m->window_size)
+        {
+            fault_addr = uint32_t(at - m->ram);
+            siglongjmp(*fault_jump, 1);
+        }
+    }
+    signal(sig, SIG_DFL);
 }
 
 /**
@@ -49,7 +121,7 @@ memory::~memory()
 
 bool memory::check_illegal(uint32_t i) const
 {
-    if (i > mem.size())
+    if (i >= ram_size)
     {
         std::cout << "WARNING: Address out of range: " << to_hex0x32(i) << std::endl;
 
@@ -69,14 +141,16 @@ bool memory::check_illegal(uint32_t i) const
 
 uint32_t memory::get_size() const
 {
-    return mem.size();
+    return ram_size;
 }
 
 /**
- * get8(uint32_t addr)
+ * peek8(uint32_t addr)
  *
  * This function returns the value of the byte at the "addr" address. 
- * Checks for invalid address as a safety check.
+ * Checks for invalid address as a safety check. The peek functions do not
+ * trigger watchpoints; they are used for instruction fetch and by tools
+ * that inspect memory.
  *
  * @param addr Unsigned 32 bit integer representing an address value.
  *
@@ -84,7 +158,7 @@ uint32_t memory::get_size() const
  *
  ********************************************************************************/
 
-uint8_t memory::get8(uint32_t addr) const
+uint8_t memory::peek8(uint32_t addr) const
 {
     if (check_illegal(addr))  // If address is illegal,
     {
@@ -92,16 +166,17 @@ uint8_t memory::get8(uint32_t addr) const
     }
     else                      // If it is legal,
     {
-        return mem[addr];     // Return the value of the byte at this address.
+        return ram[addr];     // Return the value of the byte at this address.
     }
 }
 
 /**
- * get16(uint32_t addr)
+ * peek16(uint32_t addr)
  *
  * This function returns the value of the 2 bytes at the "addr" address. 
- * This function calls get8() twice and combines them in little-endian
- * order to create a 16 bit return value.
+ * An access inside RAM is read directly; otherwise this function calls
+ * peek8() twice and combines them in little-endian order to create a
+ * 16 bit return value.
  *
  * @param addr Unsigned 32 bit integer representing an address value.
  *
@@ -109,13 +184,16 @@ uint8_t memory::get8(uint32_t addr) const
  *
  ********************************************************************************/
 
-uint16_t memory::get16(uint32_t addr) const
+uint16_t memory::peek16(uint32_t addr) const
 {
-    uint8_t first = get8(addr);          // Get first byte
+    if (in_ram(addr, 2))
+        return load16(addr);
+
+    uint8_t first = peek8(addr);         // Get first byte
 
     addr += 1;                           // Increment addr to get next value
 
-    uint8_t second = get8(addr);         // Get second byte that's next to the first
+    uint8_t second = peek8(addr);        // Get second byte that's next to the first
 
     uint16_t combined = (second << 8) | first;      // Shift 8 bits and 'combine'
 
@@ -123,11 +201,12 @@ uint16_t memory::get16(uint32_t addr) const
 }
 
 /**
- * get32(uint32_t addr)
+ * peek32(uint32_t addr)
  *
  * This function returns the value of the 4 bytes at the "addr" address. 
- * This function calls get16() twice and combines them in little-endian
- * order to create a 32 bit return value.
+ * An access inside RAM is read directly; otherwise this function calls
+ * peek16() twice and combines them in little-endian order to create a
+ * 32 bit return value.
  *
  * @param addr Unsigned 32 bit integer representing an address value.
  *
@@ -135,19 +214,73 @@ uint16_t memory::get16(uint32_t addr) const
  *
  ********************************************************************************/
 
-uint32_t memory::get32(uint32_t addr) const
+uint32_t memory::peek32(uint32_t addr) const
 {
-    uint16_t first = get16(addr);   // Get first value at "addr"
+    if (in_ram(addr, 4))
+        return load32(addr);
+
+    uint16_t first = peek16(addr);  // Get first value at "addr"
 
     addr += 2;                      // Move over two bytes since 16 bits are being combined
 
-    uint16_t second = get16(addr);  // Get second value at "addr"
+    uint16_t second = peek16(addr);  // Get second value at "addr"
 
     uint32_t combined = (second << 16) | first;  // Shift 16 bits and 'combine' the two bit values
 
     return combined;
 }
 
+/**
+ * get8(), get16() and get32() are the guest data reads.
+ *
+ * An access inside RAM returns the same value as the peek functions.
+ * If it touches a page marked for read watching it is also reported to
+ * the watcher, which decides whether it hits a watched range. Anything
+ * outside RAM is passed to read_io(), or faults with guard pages.
+ *
+ * @param addr Unsigned 32 bit integer representing an address value.
+ *
+ ********************************************************************************/
+
+uint8_t memory::get8(uint32_t addr) const
+{
+    if (!ram_access(addr, 1))
+        return read_io(addr, 1);
+
+    uint8_t val = ram[addr];
+
+    if (watching && page_flagged(addr, 1, page_watch_read))
+        watch->on_read(addr, 1, val);
+
+    return val;
+}
+
+uint16_t memory::get16(uint32_t addr) const
+{
+    if (!ram_access(addr, 2))
+        return read_io(addr, 2);
+
+    uint16_t val = load16(addr);
+
+    if (watching && page_flagged(addr, 2, page_watch_read))
+        watch->on_read(addr, 2, val);
+
+    return val;
+}
+
+uint32_t memory::get32(uint32_t addr) const
+{
+    if (!ram_access(addr, 4))
+        return read_io(addr, 4);
+
+    uint32_t val = load32(addr);
+
+    if (watching && page_flagged(addr, 4, page_watch_read))
+        watch->on_read(addr, 4, val);
+
+    return val;
+}
+
 /**
  * get8_sx(uint32_t addr)
  *
@@ -209,72 +342,539 @@ int32_t memory::get32_sx(uint32_t addr) const
 }
 
 /**
- * set8(uint32_t addr, uint8_t val) sets values in the "mem" vector.
+ * set8(), set16() and set32() are the guest data writes.
+ *
+ * A write outside RAM is passed to write_io(), or faults with guard
+ * pages. A write that touches a page marked for write watching or
+ * holding cached code goes through flagged_write() with the old and new
+ * values. Other writes go straight to the store functions.
+ *
+ * @param addr Unsigned 32 bit integer representing an address value.
+ * @param val The value to store.
+ *
+ ********************************************************************************/
+
+void memory::set8(uint32_t addr, uint8_t val)
+{
+    if (!ram_access(addr, 1))
+    {
+        write_io(addr, 1, val);
+        return;
+    }
+
+    if (write_flags && page_flagged(addr, 1, write_flags))
+    {
+        uint8_t old_val = ram[addr];
+        store8(addr, val);
+        flagged_write(addr, 1, old_val, val);
+        return;
+    }
+
+    store8(addr, val);
+}
+
+void memory::set16(uint32_t addr, uint16_t val)
+{
+    if (!ram_access(addr, 2))
+    {
+        write_io(addr, 2, val);
+        return;
+    }
+
+    if (write_flags && page_flagged(addr, 2, write_flags))
+    {
+        uint16_t old_val = load16(addr);
+        store16(addr, val);
+        flagged_write(addr, 2, old_val, val);
+        return;
+    }
+
+    store16(addr, val);
+}
+
+void memory::set32(uint32_t addr, uint32_t val)
+{
+    if (!ram_access(addr, 4))
+    {
+        write_io(addr, 4, val);
+        return;
+    }
+
+    if (write_flags && page_flagged(addr, 4, write_flags))
+    {
+        uint32_t old_val = load32(addr);
+        store32(addr, val);
+        flagged_write(addr, 4, old_val, val);
+        return;
+    }
+
+    store32(addr, val);
+}
+
+/**
+ * flagged_write() is called after a guest write to a flagged page. Code
+ * it overwrote is invalidated, a clean page is recorded as dirty, and the
+ * write is reported to the watcher if the page is watched.
+ *
+ ********************************************************************************/
+
+void memory::flagged_write(uint32_t addr, uint32_t len, uint32_t old_val, uint32_t new_val)
+{
+    code_written(addr, len);
+    dirtied(addr, len);
+
+    if (watching && page_flagged(addr, len, page_watch_write))
+        watch->on_write(addr, len, old_val, new_val);
+}
+
+/**
+ * copy() and fill() carry out many stores at once for the fast path.
+ *
+ * copy() moves len bytes from src to dst; the ranges must not overlap.
+ * fill() stores the low width bytes of val over and over from dst on.
+ * Addresses written are added to the write log as single stores would,
+ * and code they overwrite is invalidated.
+ *
+ * @return false, having done nothing, if a range is not entirely in RAM
+ *         or any page is watched. The caller then runs the stores one at
+ *         a time.
+ *
+ ********************************************************************************/
+
+bool memory::copy(uint32_t dst, uint32_t src, uint32_t len)
+{
+    if (watching || !in_ram(dst, len) || !in_ram(src, len))
+        return false;
+
+    std::memcpy(ram + dst, ram + src, len);
+    log_range(dst, len);
+    code_written(dst, len);
+    dirtied(dst, len);
+    return true;
+}
+
+bool memory::fill(uint32_t dst, uint32_t len, uint32_t val, uint32_t width)
+{
+    if (watching || !in_ram(dst, len))
+        return false;
+
+    if (width == 1)
+    {
+        std::memset(ram + dst, uint8_t(val), len);
+    }
+    else
+    {
+        for (uint32_t i = 0; i < len; ++i)
+            ram[dst + i] = val >> (i % width) * 8;
+    }
+    log_range(dst, len);
+    code_written(dst, len);
+    dirtied(dst, len);
+    return true;
+}
+
+void memory::log_range(uint32_t addr, uint32_t len)
+{
+    if (write_log)
+    {
+        for (uint32_t i = 0; i < len; ++i)
+            write_log->push_back(addr + i);
+    }
+}
+
+/**
+ * watch_pages() marks the pages covering [addr, addr+len) so that reads
+ * and/or writes to them are passed to the watcher.
+ *
+ * @param flags page_watch_read and/or page_watch_write.
+ *
+ ********************************************************************************/
+
+void memory::watch_pages(uint32_t addr, uint32_t len, uint8_t flags)
+{
+    if (len == 0)
+        return;
+
+    uint32_t last = (addr + len - 1) >> page_shift;
+    for (uint32_t p = addr >> page_shift; p <= last && p < page_flags.size(); ++p)
+    {
+        page_flags[p] |= flags;
+        watching = true;
+    }
+    write_flags |= flags & page_watch_write;
+    flush_tlbs();
+}
+
+/**
+ * mark_code() records that [addr, addr+len) holds code that has been
+ * predecoded or otherwise cached. A later write to it changes
+ * get_code_gen() for its page, so the cached form can be dropped.
+ *
+ * Code is tracked in granules of 1 << code_shift bytes. A write to a page
+ * that holds code but misses its granules costs only the flag check, and
+ * a write to a page without code costs nothing more than before.
+ *
+ ********************************************************************************/
+
+void memory::mark_code(uint32_t addr, uint32_t len)
+{
+    if (len == 0)
+        return;
+
+    uint32_t last = (addr + len - 1) >> code_shift;
+    for (uint32_t g = addr >> code_shift; g <= last; ++g)
+    {
+        uint32_t p = g >> (page_shift - code_shift);
+        if (p >= page_flags.size())
+            break;
+        code_map[p] |= uint64_t(1) << (g & 63);
+        if (!(page_flags[p] & page_code))
+        {
+            page_flags[p] |= page_code;
+            for (soft_tlb *t : tlbs)
+                t->flush_page(p);       // its stores must now see the flag
+        }
+    }
+    write_flags |= page_code;
+}
+
+/**
+ * code_written() bumps the generation of every page whose marked code
+ * overlaps [addr, addr+len). Everything cached from such a page is then
+ * stale, so its marks are cleared until the code is cached again.
+ *
+ ********************************************************************************/
+
+void memory::code_written(uint32_t addr, uint32_t len)
+{
+    if (!(write_flags & page_code) || len == 0)
+        return;
+
+    uint32_t last = (addr + len - 1) >> code_shift;
+    for (uint32_t g = addr >> code_shift; g <= last; ++g)
+    {
+        uint32_t p = g >> (page_shift - code_shift);
+        if (p >= page_flags.size())
+            break;
+        if (code_map[p] & (uint64_t(1) << (g & 63)))
+        {
+            ++code_gen[p];
+            code_map[p] = 0;
+            page_flags[p] &= ~page_code;
+        }
+    }
+}
+
+/**
+ * dirtied() records the clean pages [addr, addr+len) touches as dirty, so
+ * that restore() copies them back.
+ *
+ ********************************************************************************/
+
+void memory::dirtied(uint32_t addr, uint32_t len)
+{
+    if (!(write_flags & page_clean) || len == 0)
+        return;
+
+    uint32_t last = (addr + len - 1) >> page_shift;
+    for (uint32_t p = addr >> page_shift; p <= last && p < page_flags.size(); ++p)
+    {
+        if (page_flags[p] & page_clean)
+        {
+            page_flags[p] &= ~page_clean;
+            dirty.push_back(p);
+        }
+    }
+}
+
+/**
+ * snapshot() saves RAM as it is now and marks every page clean. From then
+ * on the first write to a page sends it through flagged_write(), which
+ * records it as dirty, and soft TLBs do not map clean pages for writes.
+ * Device state is not part of the snapshot.
+ *
+ ********************************************************************************/
+
+void memory::snapshot()
+{
+    baseline.assign(ram, ram + ram_size);
+    for (uint8_t &f : page_flags)
+        f |= page_clean;
+    dirty.clear();
+    write_flags |= page_clean;
+    flush_tlbs();
+}
+
+/**
+ * restore() puts RAM back as it was at snapshot(), copying only the pages
+ * written since, so it costs time in proportion to what the guest
+ * touched rather than to the memory size. Code cached from a restored
+ * page is invalidated.
+ *
+ * @return false if there is no snapshot.
+ *
+ ********************************************************************************/
+
+bool memory::restore()
+{
+    if (baseline.empty())
+        return false;
+
+    for (uint32_t p : dirty)
+    {
+        uint32_t base = p << page_shift;
+        uint32_t len = ram_size - base < page_size ? ram_size - base : page_size;
+        std::memcpy(ram + base, baseline.data() + base, len);
+        page_flags[p] |= page_clean;
+
+        if (code_map[p])
+        {
+            ++code_gen[p];
+            code_map[p] = 0;
+            page_flags[p] &= ~page_code;
+        }
+        for (soft_tlb *t : tlbs)
+            t->flush_page(p);           // its stores must be seen again
+    }
+    dirty.clear();
+    return true;
+}
+
+/**
+ * set_write_log() attaches a log that every guest write appends its
+ * addresses to, or detaches it if log is nullptr.
+ *
+ ********************************************************************************/
+
+void memory::set_write_log(std::vector<uint32_t> *log)
+{
+    write_log = log;
+    flush_tlbs();
+}
+
+/**
+ * host_page() tells a soft_tlb whether accesses of kind a to a guest page
+ * may go straight to host memory: the page must lie wholly in RAM, reads
+ * must not be watched, and writes must not be watched, logged or hit
+ * cached code.
+ *
+ * @return The host address of the page, or nullptr.
+ *
+ ********************************************************************************/
+
+uint8_t *memory::host_page(uint32_t page, access a) const
+{
+    if (page >= (ram_size >> page_shift))
+        return nullptr;
+
+    if (a == access_read && (page_flags[page] & page_watch_read))
+        return nullptr;
+    if (a == access_write && (write_log || (page_flags[page] & write_flags)))
+        return nullptr;
+
+    return ram + (page << page_shift);
+}
+
+/**
+ * detach_tlb() forgets a soft_tlb that is going away.
+ *
+ ********************************************************************************/
+
+void memory::detach_tlb(soft_tlb *t)
+{
+    for (size_t i = 0; i < tlbs.size(); ++i)
+    {
+        if (tlbs[i] == t)
+            tlbs.erase(tlbs.begin() + i);
+    }
+}
+
+void memory::flush_tlbs()
+{
+    for (soft_tlb *t : tlbs)
+        t->flush();
+}
+
+/**
+ * map_device() maps a device into the address space.
+ *
+ * Device regions must lie above RAM and must not overlap each other, so
+ * that an access inside RAM never has to look at the region table.
+ *
+ * @param base First address of the region.
+ * @param size Size of the region in bytes.
+ * @param dev The device. It must outlive the memory.
+ *
+ * @return false if the region is empty, wraps, or overlaps RAM or
+ *         another region, and always with guard pages.
+ *
+ ********************************************************************************/
+
+bool memory::map_device(uint32_t base, uint32_t size, device *dev)
+{
+    if (size == 0 || uint64_t(base) + size > 0x100000000ull || base < ram_size || window)
+        return false;
+
+    for (const region &r : regions)
+    {
+        if (base < r.base + r.size && r.base < base + size)
+            return false;
+    }
+
+    regions.push_back({ base, size, dev });
+    return true;
+}
+
+/**
+ * find_region() looks up the device region holding [addr, addr+len).
+ *
+ * @return The region, or nullptr if there is none.
+ *
+ ********************************************************************************/
+
+const memory::region *memory::find_region(uint32_t addr, uint32_t len) const
+{
+    for (const region &r : regions)
+    {
+        if (addr - r.base < r.size && len <= r.size - (addr - r.base))
+            return &r;
+    }
+    return nullptr;
+}
+
+/**
+ * read_io() and write_io() handle guest accesses outside RAM.
+ *
+ * An access inside a device region is passed to its device. Anything else
+ * is out of range and is handled byte by byte as before, printing a
+ * warning for each byte outside memory.
+ *
+ ********************************************************************************/
+
+uint32_t memory::read_io(uint32_t addr, uint32_t len) const
+{
+    ++io_reads;
+
+    const region *r = find_region(addr, len);
+    if (r)
+        return r->dev->read(addr - r->base, len);
+
+    switch (len)
+    {
+    case 1: return peek8(addr);
+    case 2: return peek16(addr);
+    default: return peek32(addr);
+    }
+}
+
+void memory::write_io(uint32_t addr, uint32_t len, uint32_t val)
+{
+    const region *r = find_region(addr, len);
+    if (r)
+    {
+        r->dev->write(addr - r->base, len, val);
+        return;
+    }
+
+    switch (len)
+    {
+    case 1: store8(addr, val); break;
+    case 2: store16(addr, val); break;
+    default: store32(addr, val); break;
+    }
+}
+
+/**
+ * store8(uint32_t addr, uint8_t val) sets values in the "mem" vector.
  *
  * This function checks if the address is valid, and then sets the value
  * at the specified address "addr" to whatever value "val" is specified as.
+ * If a write log is attached, the address is appended to it.
  *
  * @param addr Unsigned 32 bit integer representing an address value.
  * @param val Unsigned 8 bit integer representing a value to put into the memory.
  *
  ********************************************************************************/
 
-void memory::set8(uint32_t addr, uint8_t val)
+void memory::store8(uint32_t addr, uint8_t val)
 {
-    if (check_illegal(addr))  // If address is illegal,
+    if (!ram_access(addr, 1) && check_illegal(addr))  // If address is illegal,
     {
         return;               // Exit.
     }
     else                      // If it is legal,
     {
-        mem.at(addr) = val;   // Set the value at this addr to val.
+        ram[addr] = val;      // Set the value at this addr to val.
+
+        if (write_log)
+        {
+            write_log->push_back(addr);
+        }
     }
 }
 
 /**
- * set16(uint32_t addr, uint16_t val) sets values in the "mem" vector.
+ * store16(uint32_t addr, uint16_t val) sets values in the "mem" vector.
  *
- * This function uses bit manipulation to prepare the bit values 
- * and calls set8() twice to set the values in the memory in the proper order.
+ * An access inside RAM with no write log attached is stored directly.
+ * Otherwise this function uses bit manipulation to prepare the bit values 
+ * and calls store8() twice to set the values in the memory in the proper order.
  *
  * @param addr Unsigned 32 bit integer representing an address value.
  * @param val Unsigned 16 bit integer representing a value to put into the memory.
  *
  ********************************************************************************/
 
-void memory::set16(uint32_t addr, uint16_t val)
+void memory::store16(uint32_t addr, uint16_t val)
 {
+    if (ram_access(addr, 2) && !write_log)
+    {
+        ram[addr] = val;
+        ram[addr+1] = val >> 8;
+        return;
+    }
+
     uint8_t first = val; 
 
-    set8(addr, first);              // Place the 8 bits in the next address value, 
+    store8(addr, first);              // Place the 8 bits in the next address value, 
                                     // since it is little-endian order.
 
     uint8_t second = (val >> 8);    // Shave off the right-most 8 bits
  
-    set8(addr+1, second);             // Place the other 8 bits in the current address value.
+    store8(addr+1, second);             // Place the other 8 bits in the current address value.
 }
 
 /**
- * set32(uint32_t addr, uint32_t val) sets values in the "mem" vector.
+ * store32(uint32_t addr, uint32_t val) sets values in the "mem" vector.
  *
- * This function uses bit manipulation to prepare the bit values 
- * and calls set16() twice to set the values in the memory in the proper order.
+ * An access inside RAM with no write log attached is stored directly.
+ * Otherwise this function uses bit manipulation to prepare the bit values 
+ * and calls store16() twice to set the values in the memory in the proper order.
  *
  * @param addr Unsigned 32 bit integer representing an address value.
  * @param val Unsigned 32 bit integer representing a value to put into the memory.
  *
  ********************************************************************************/
 
-void memory::set32(uint32_t addr, uint32_t val)
+void memory::store32(uint32_t addr, uint32_t val)
 {
+    if (ram_access(addr, 4) && !write_log)
+    {
+        ram[addr] = val;
+        ram[addr+1] = val >> 8;
+        ram[addr+2] = val >> 16;
+        ram[addr+3] = val >> 24;
+        return;
+    }
+
     uint16_t first = val; 
 
-    set16(addr, first);             // Place the 16 bits in the next address value, 
+    store16(addr, first);             // Place the 16 bits in the next address value, 
                                       // since it is little-endian order.
 
     uint16_t second = (val >> 16);    // Shave off the right-most 16 bits
 
-    set16(addr+2, second);              // Place the other 16 bits in the current address value.
+    store16(addr+2, second);              // Place the other 16 bits in the current address value.
 }
 
 /**
@@ -286,7 +886,7 @@ void memory::set32(uint32_t addr, uint32_t val)
 
 void memory::dump() const
 {
-    int vectorSize = mem.size();
+    int vectorSize = ram_size;
     std::stringstream strstr;
 
     for (int i = 0; i < vectorSize; i++)    // Iterate through the entire "mem" vector
@@ -299,12 +899,12 @@ void memory::dump() const
 
         if (i % 16 == 0)
         {
-            std::cout << to_hex32(i) << ": ";   // Print out hex value of address every new line
+            std::cout << hex32(i) << ": ";     // Print out hex value of address every new line
         }
 
-        std::cout << to_hex8(mem[i]) << ' ';    // Print out each byte in the memory
+        std::cout << hex8(ram[i]) << ' ';      // Print out each byte in the memory
 
-        uint8_t ch = get8(i);
+        uint8_t ch = peek8(i);
         ch = isprint(ch) ? ch : '.';            // ASCII character, or a dot? 
         strstr << ch;
 
@@ -321,7 +921,7 @@ void memory::dump() const
  * load_file(const std::string & fname) opens the file.
  *
  * This function attempts to open the file in binary mode and read its contents
- * into the "mem" vector. It catches an out_of_range exception if the program is too big.
+ * into RAM. It fails if the program is too big.
  *
  * @param fname The file to be opened. 
  *
@@ -345,21 +945,68 @@ bool memory::load_file(const std::string & fname)
     infile >> std::noskipws;
     for (uint32_t addr = 0; infile >> i; ++addr)
     {
-        try
+        if (addr < ram_size)
         {
-            mem.at(addr) = i;  // This throws an exception when out of range
+            ram[addr] = i;
+            image_size = addr + 1;
         }
-        catch (const std::out_of_range& oor)
+        else
         {
             std::cout << "WARNING: Address out of range: " << to_hex0x32(i) << std::endl;
             std::cerr << "Program too big.\n";
+            dirtied(0, image_size);
             infile.close();
             infile.clear();
             return false;
         } 
     }
+    dirtied(0, image_size);
 
     infile.close();
     infile.clear();
     return true;
 }
+
+/**
+ * save_file() writes RAM to fname as a checkpoint, which load_file() can
+ * load again and memory_diff can compare.
+ *
+ * @return false if the file cannot be written.
+ *
+ ********************************************************************************/
+
+bool memory::save_file(const std::string &fname) const
+{
+    std::ofstream outfile(fname, std::ios::out|std::ios::binary);
+    if (!outfile.is_open())
+    {
+        std::cerr << "Can't open file '" << fname << "' for writing.\n";
+        return false;
+    }
+
+    outfile.write(reinterpret_cast<const char*>(ram), ram_size);
+    return outfile.good();
+}
+
+/**
+ * load_segment() copies a program segment to addr and zeroes the rest
+ * of its memsz bytes.
+ *
+ * @return false if [addr, addr+memsz) is not entirely in RAM.
+ *
+ ********************************************************************************/
+
+bool memory::load_segment(uint32_t addr, const uint8_t *data, uint32_t filesz, uint32_t memsz)
+{
+    if (!in_ram(addr, memsz))
+        return false;
+
+    std::memcpy(ram + addr, data, filesz);
+    std::memset(ram + addr + filesz, 0, memsz - filesz);
+    code_written(addr, memsz);
+    dirtied(addr, memsz);
+
+    if (addr + memsz > image_size)
+        image_size = addr + memsz;
+    return true;
+}
@@ -14,20 +14,92 @@
 #include <cctype>
 #include <fstream>
 #include <sstream>
+#include <setjmp.h>
+#include <signal.h>
 #include "hex.h"
 
+class soft_tlb;
+
+/**
+ * memory is the guest RAM, with device regions mapped above it.
+ *
+ * Built with RV32I_GUARD_PAGES (make GUARD_PAGES=1), each memory reserves
+ * the whole 4 GiB guest address space plus a page as host address space
+ * and makes only RAM accessible. Guest loads and stores then index RAM
+ * without comparing the address with its size: one outside RAM faults on
+ * the host, and the fault is turned back into a jump to the run loop's
+ * fault_scope, which treats it as a guest access fault. Device regions
+ * cannot be mapped in such a build. The peek functions, used by tools,
+ * still check the address.
+ *
+ ********************************************************************************/
+
 class memory : public hex
 {
 public:
+    /// Is told about accesses to pages marked with watch_pages().
+    class watcher
+    {
+    public:
+        virtual ~watcher() { }
+        virtual void on_read(uint32_t addr, uint32_t len, uint32_t val) = 0;
+        virtual void on_write(uint32_t addr, uint32_t len, uint32_t old_val, uint32_t new_val) = 0;
+    };
+
+    /// A memory-mapped device. Offsets are relative to the mapped base.
+    class device
+    {
+    public:
+        virtual ~device() { }
+        virtual uint32_t read(uint32_t offset, uint32_t len) = 0;
+        virtual void write(uint32_t offset, uint32_t len, uint32_t val) = 0;
+    };
+
+    static constexpr uint32_t page_shift = 12;
+    static constexpr uint32_t page_size = 1 << page_shift;
+
+    static constexpr uint8_t page_watch_read = 0x01;
+    static constexpr uint8_t page_watch_write = 0x02;
+    static constexpr uint8_t page_code = 0x04;          ///< Holds code someone has cached.
+    static constexpr uint8_t page_clean = 0x08;         ///< Not written since snapshot().
+
+    static constexpr uint32_t code_shift = page_shift - 6;  ///< 64 code granules per page.
+
+    /// The kinds of guest access a soft_tlb keeps apart.
+    enum access { access_read, access_write, access_fetch, access_count };
+
+    /// While one exists, a guest access outside RAM jumps to its sigjmp_buf
+    /// (guard page builds only; otherwise it never happens).
+    class fault_scope
+    {
+    public:
+        fault_scope(sigjmp_buf &jb) : prev(fault_jump) { fault_jump = &jb; }
+        ~fault_scope() { fault_jump = prev; }
+
+    private:
+        sigjmp_buf *prev;
+    };
+
+    /// The guest address of the last access that jumped to a fault_scope.
+    static uint32_t get_fault_addr() { return fault_addr; }
+
     memory(uint32_t s);
+    memory(const memory&) = delete;
+    memory &operator=(const memory&) = delete;
     ~memory();
 
     bool check_illegal(uint32_t addr) const;
     uint32_t get_size() const;
+    uint32_t get_image_size() const { return image_size; }
+    const uint8_t *get_data() const { return ram; }
     uint8_t get8(uint32_t addr) const;
     uint16_t get16(uint32_t addr) const;
     uint32_t get32(uint32_t addr) const;
 
+    uint8_t peek8(uint32_t addr) const;
+    uint16_t peek16(uint32_t addr) const;
+    uint32_t peek32(uint32_t addr) const;
+
     int32_t get8_sx(uint32_t addr) const;
     int32_t get16_sx(uint32_t addr) const;
     int32_t get32_sx(uint32_t addr) const;
@@ -36,12 +108,120 @@ public:
     void set16(uint32_t addr, uint16_t val);
     void set32(uint32_t addr, uint32_t val);
 
+    bool copy(uint32_t dst, uint32_t src, uint32_t len);
+    bool fill(uint32_t dst, uint32_t len, uint32_t val, uint32_t width);
+
     void dump() const;
 
+    void set_write_log(std::vector<uint32_t> *log);
+
+    void set_watcher(watcher *w) { watch = w; }
+    void watch_pages(uint32_t addr, uint32_t len, uint8_t flags);
+
+    void mark_code(uint32_t addr, uint32_t len);
+
+    /// Changes whenever code in [addr, addr+len), at most a page long, may have been written.
+    uint32_t get_code_gen(uint32_t addr, uint32_t len) const
+    {
+        uint32_t first = addr >> page_shift;
+        uint32_t last = (addr + len - 1) >> page_shift;
+        return code_gen[first] + (last != first ? code_gen[last] : 0);
+    }
+
+    uint8_t *host_page(uint32_t page, access a) const;
+    void attach_tlb(soft_tlb *t) { tlbs.push_back(t); }
+    void detach_tlb(soft_tlb *t);
+
+    void snapshot();
+    bool restore();
+    bool has_snapshot() const { return !baseline.empty(); }
+    uint32_t get_dirty_pages() const { return dirty.size(); }
+
+    bool map_device(uint32_t base, uint32_t size, device *dev);
+    uint32_t get_io_reads() const { return io_reads; }
+
     bool load_file (const std::string &fname);
+    bool save_file(const std::string &fname) const;
+    bool load_segment(uint32_t addr, const uint8_t *data, uint32_t filesz, uint32_t memsz);
 
 private:
-    std::vector<uint8_t> mem;
+    struct region
+    {
+        uint32_t base;
+        uint32_t size;
+        device *dev;
+    };
+
+    /// True if [addr, addr+len) lies entirely in RAM.
+    bool in_ram(uint32_t addr, uint32_t len) const
+    {
+        return uint64_t(addr) + len <= ram_size;
+    }
+
+    /// True if a guest access to [addr, addr+len) can go straight to RAM. With
+    /// guard pages nothing is compared: an access outside RAM faults instead.
+#ifdef RV32I_GUARD_PAGES
+    bool ram_access(uint32_t, uint32_t) const { return true; }
+#else
+    bool ram_access(uint32_t addr, uint32_t len) const { return in_ram(addr, len); }
+#endif
+
+    uint16_t load16(uint32_t addr) const { return ram[addr] | (ram[addr+1] << 8); }
+    uint32_t load32(uint32_t addr) const
+    {
+        return ram[addr] | (ram[addr+1] << 8) | (ram[addr+2] << 16) | (uint32_t(ram[addr+3]) << 24);
+    }
+
+    const region *find_region(uint32_t addr, uint32_t len) const;
+    uint32_t read_io(uint32_t addr, uint32_t len) const;
+    void write_io(uint32_t addr, uint32_t len, uint32_t val);
+
+    void store8(uint32_t addr, uint8_t val);
+    void store16(uint32_t addr, uint16_t val);
+    void store32(uint32_t addr, uint32_t val);
+    void log_range(uint32_t addr, uint32_t len);
+    void flagged_write(uint32_t addr, uint32_t len, uint32_t old_val, uint32_t new_val);
+    void code_written(uint32_t addr, uint32_t len);
+    void dirtied(uint32_t addr, uint32_t len);
+    void flush_tlbs();
+
+    /// True if [addr, addr+len) touches a page with any of the flags set.
+    bool page_flagged(uint32_t addr, uint32_t len, uint8_t flags) const
+    {
+        uint32_t first = addr >> page_shift;
+        uint32_t last = (addr + len - 1) >> page_shift;
+        return (first < page_flags.size() && (page_flags[first] & flags))
+            || (last < page_flags.size() && (page_flags[last] & flags));
+    }
+
+    uint8_t *ram = { nullptr };         ///< In storage, or in window with guard pages.
+    uint32_t ram_size = { 0 };
+    std::vector<uint8_t> storage;
+    uint8_t *window = { nullptr };      ///< The reserved guest address space, with guard pages.
+    size_t window_size = { 0 };
+    uint32_t image_size = { 0 };        ///< Bytes loaded by load_file().
+    std::vector<uint32_t> *write_log = { nullptr };
+
+    watcher *watch = { nullptr };
+    bool watching = { false };          ///< Any page has a watch flag.
+    std::vector<uint8_t> page_flags;    ///< One entry per page_size bytes.
+    uint8_t write_flags = { 0 };        ///< Page flags that send a write through flagged_write().
+
+    std::vector<uint64_t> code_map;     ///< Per page, the code_shift granules marked as code.
+    std::vector<uint32_t> code_gen;     ///< Per page, bumped when marked code is written.
+
+    std::vector<uint8_t> baseline;      ///< RAM as of snapshot().
+    std::vector<uint32_t> dirty;        ///< Pages written since snapshot(), each once.
+
+    std::vector<region> regions;        ///< Device regions, all outside RAM.
+    std::vector<soft_tlb*> tlbs;        ///< Flushed when host_page() may answer differently.
+    mutable uint32_t io_reads = { 0 };  ///< Loads that missed RAM, which may not repeat.
+
+    static void on_fault(int sig, siginfo_t *info, void *context);
+
+    static std::vector<const memory*> guarded;  ///< Every memory with a window.
+    static sigjmp_buf *fault_jump;
+    static uint32_t fault_addr;
 };
 
 #endif
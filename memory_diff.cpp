@@ -0,0 +1,175 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#include "memory_diff.h"
+#include <cctype>
+#include <cstring>
+#include <fstream>
+
+/**
+ * memory_diff() compares image a of a_size bytes with image b of b_size
+ * bytes. Only the bytes both have are compared; print() reports a
+ * difference in size.
+ *
+ ********************************************************************************/
+
+memory_diff::memory_diff(const uint8_t *a_data, uint32_t a_size, const uint8_t *b_data, uint32_t b_size)
+    : a(a_data), b(b_data), size_a(a_size), size_b(b_size), size(a_size < b_size ? a_size : b_size)
+{
+    find();
+}
+
+memory_diff::memory_diff(const memory &a, const memory &b)
+    : memory_diff(a.get_data(), a.get_size(), b.get_data(), b.get_size())
+{
+}
+
+/**
+ * block_equal() compares one block of each image. The loop has no early
+ * exit, so it vectorizes.
+ *
+ ********************************************************************************/
+
+static bool block_equal(const uint8_t *a, const uint8_t *b)
+{
+    uint64_t acc = 0;
+    for (uint32_t i = 0; i < memory_diff::block; i += sizeof(uint64_t))
+    {
+        uint64_t x, y;
+        std::memcpy(&x, a + i, sizeof(x));
+        std::memcpy(&y, b + i, sizeof(y));
+        acc |= x ^ y;
+    }
+    return acc == 0;
+}
+
+/**
+ * next_diff() finds the first differing byte at or after from.
+ *
+ * @return Its address, or size if there is none.
+ *
+ ********************************************************************************/
+
+uint32_t memory_diff::next_diff(uint32_t from) const
+{
+    uint32_t i = from;
+    for (; i < size && i % block != 0; ++i)
+    {
+        if (a[i] != b[i])
+            return i;
+    }
+
+    while (size - i >= block && block_equal(a + i, b + i))
+        i += block;
+
+    for (; i < size; ++i)               // the block that differs, or the tail
+    {
+        if (a[i] != b[i])
+            return i;
+    }
+    return size;
+}
+
+/**
+ * find() collects the ranges of differences.
+ *
+ ********************************************************************************/
+
+void memory_diff::find()
+{
+    uint32_t i = next_diff(0);
+    while (i < size)
+    {
+        range r = { i, 0 };
+        uint32_t last;
+        do
+        {
+            ++bytes;
+            last = i;
+            i = next_diff(i + 1);
+        } while (i < size && i - last <= merge_gap);
+
+        r.len = last - r.addr + 1;
+        ranges.push_back(r);
+    }
+}
+
+/**
+ * print() shows each range as the rows of both images that cover it, in
+ * the format of memory::dump(), a's rows tagged '-' and b's '+'.
+ *
+ ********************************************************************************/
+
+void memory_diff::print(std::ostream &os) const
+{
+    if (size_a != size_b)
+    {
+        os << "Sizes differ: " << to_hex0x32(size_a) << " and " << to_hex0x32(size_b)
+           << ", comparing the first " << to_hex0x32(size) << " bytes" << std::endl;
+    }
+
+    for (const range &r : ranges)
+    {
+        uint32_t end = r.addr + r.len;
+        os << hex32(r.addr) << '-' << hex32(end - 1) << ": " << std::dec << r.len << (r.len == 1 ? " byte" : " bytes") << std::endl;
+
+        for (uint32_t row = r.addr & ~uint32_t(15); row < end; row += 16)
+        {
+            print_row(os, '-', a, row, size);
+            print_row(os, '+', b, row, size);
+        }
+    }
+
+    if (ranges.empty())
+        os << "No differences" << std::endl;
+    else
+        os << std::dec << bytes << (bytes == 1 ? " byte differs in " : " bytes differ in ")
+           << ranges.size() << (ranges.size() == 1 ? " range" : " ranges") << std::endl;
+}
+
+void memory_diff::print_row(std::ostream &os, char tag, const uint8_t *p, uint32_t row, uint32_t end) const
+{
+    std::string ascii;
+
+    os << tag << ' ' << hex32(row) << ": ";
+    for (uint32_t i = row; i < row + 16; ++i)
+    {
+        if (i % 16 == 8)
+            os << ' ';
+
+        if (i < end)
+        {
+            os << hex8(p[i]) << ' ';
+            ascii += isprint(p[i]) ? char(p[i]) : '.';
+        }
+        else
+        {
+            os << "   ";
+        }
+    }
+    os << '*' << ascii << "*\n";
+}
+
+/**
+ * load_checkpoint() reads a memory image saved by memory::save_file().
+ *
+ * @return false if the file cannot be read.
+ *
+ ********************************************************************************/
+
+bool memory_diff::load_checkpoint(const std::string &fname, std::vector<uint8_t> &image)
+{
+    std::ifstream infile(fname, std::ios::in|std::ios::binary);
+    if (!infile.is_open())
+    {
+        std::cerr << "Can't open file '" << fname << "' for reading.\n";
+        return false;
+    }
+
+    image.assign(std::istreambuf_iterator<char>(infile), std::istreambuf_iterator<char>());
+    return true;
+}
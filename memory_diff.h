@@ -0,0 +1,65 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#ifndef H_MEMORY_DIFF
+#define H_MEMORY_DIFF
+
+#include "memory.h"
+#include <iostream>
+#include <string>
+#include <vector>
+
+/**
+ * memory_diff finds where two guest memory images differ, e.g. a memory
+ * after a run and a checkpoint saved by another build or configuration.
+ *
+ * Equal stretches are skipped a block at a time, the words of a block
+ * XORed and ORed together in a loop the compiler turns into SIMD code;
+ * only blocks that differ are looked at byte by byte. Differences less
+ * than merge_gap bytes apart are reported as one range.
+ *
+ ********************************************************************************/
+
+class memory_diff : public hex
+{
+public:
+    static constexpr uint32_t block = 64;       ///< Bytes compared at once.
+    static constexpr uint32_t merge_gap = 16;   ///< Equal bytes that still join two ranges.
+
+    /// [addr, addr+len) holds differences, first and last byte included.
+    struct range
+    {
+        uint32_t addr;
+        uint32_t len;
+    };
+
+    memory_diff(const uint8_t *a, uint32_t a_size, const uint8_t *b, uint32_t b_size);
+    memory_diff(const memory &a, const memory &b);
+
+    bool empty() const { return ranges.empty() && size_a == size_b; }
+    const std::vector<range> &get_ranges() const { return ranges; }
+    uint32_t get_bytes() const { return bytes; }
+
+    void print(std::ostream &os) const;
+
+    static bool load_checkpoint(const std::string &fname, std::vector<uint8_t> &image);
+
+private:
+    void find();
+    uint32_t next_diff(uint32_t from) const;
+    void print_row(std::ostream &os, char tag, const uint8_t *p, uint32_t row, uint32_t end) const;
+
+    const uint8_t *a;
+    const uint8_t *b;
+    uint32_t size_a;
+    uint32_t size_b;
+    uint32_t size;                      ///< Bytes compared: the smaller size.
+    uint32_t bytes = { 0 };             ///< Bytes that differ.
+    std::vector<range> ranges;
+};
+
+#endif
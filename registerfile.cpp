@@ -21,7 +21,8 @@ registerfile::~registerfile()
 
 void registerfile::reset()
 {
-    registerfile();
+    regVec.assign(32, 0xf0f0f0f0);
+    regVec.at(0)=0x00000000;
 }
 
 void registerfile::set(uint32_t r, int32_t val)
@@ -67,7 +68,7 @@ void registerfile::dump(const std::string &hdr) const
             std::cout << hdr << std::setw(3) << std::setfill(' ') << std::right << str;
         }
 
-        std::cout << ' ' << to_hex32(regVec[i]);    // Print out each register value
+        std::cout << ' ' << hex32(regVec[i]);      // Print out each register value
     }
 
     std::cout << std::endl;
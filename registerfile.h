@@ -26,6 +26,8 @@ public:
     int32_t get(uint32_t r) const;
     void dump(const std::string &hdr) const;
 
+    bool operator==(const registerfile &r) const { return regVec == r.regVec; }
+
 private:
     std::vector<int32_t> regVec;
 };
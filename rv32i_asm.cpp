@@ -0,0 +1,338 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#include "rv32i_asm.h"
+
+/**
+ * encode_rtype() assembles an R-Type instruction (opcode_rtype).
+ *
+ * @param funct7 The 7 funct7 bits.
+ * @param funct3 The 3 funct3 bits.
+ * @param rd Destination register.
+ * @param rs1 First source register.
+ * @param rs2 Second source register.
+ *
+ * @return Returns the 32-bit encoded instruction.
+ *
+ ********************************************************************************/
+
+uint32_t rv32i_asm::encode_rtype(uint32_t funct7, uint32_t funct3, uint32_t rd, uint32_t rs1, uint32_t rs2)
+{
+    return ((funct7 & 0x7f) << 25) | ((rs2 & 0x1f) << 20) | ((rs1 & 0x1f) << 15)
+         | ((funct3 & 0x7) << 12) | ((rd & 0x1f) << 7) | opcode_rtype;
+}
+
+/**
+ * encode_itype() assembles an I-Type instruction.
+ *
+ * @param opcode The 7 opcode bits (alu_imm, load_imm, jalr or system).
+ * @param funct3 The 3 funct3 bits.
+ * @param rd Destination register.
+ * @param rs1 Source register.
+ * @param imm Signed 12-bit immediate. Upper bits are discarded.
+ *
+ * @return Returns the 32-bit encoded instruction.
+ *
+ ********************************************************************************/
+
+uint32_t rv32i_asm::encode_itype(uint32_t opcode, uint32_t funct3, uint32_t rd, uint32_t rs1, int32_t imm)
+{
+    return ((imm & 0xfff) << 20) | ((rs1 & 0x1f) << 15) | ((funct3 & 0x7) << 12)
+         | ((rd & 0x1f) << 7) | (opcode & 0x7f);
+}
+
+/**
+ * encode_stype() assembles an S-Type instruction.
+ *
+ * @param funct3 The 3 funct3 bits.
+ * @param rs1 Base register.
+ * @param rs2 Register holding the value to store.
+ * @param imm Signed 12-bit displacement.
+ *
+ * @return Returns the 32-bit encoded instruction.
+ *
+ ********************************************************************************/
+
+uint32_t rv32i_asm::encode_stype(uint32_t funct3, uint32_t rs1, uint32_t rs2, int32_t imm)
+{
+    return ((imm & 0xfe0) << (25-5)) | ((rs2 & 0x1f) << 20) | ((rs1 & 0x1f) << 15)
+         | ((funct3 & 0x7) << 12) | ((imm & 0x01f) << 7) | opcode_stype;
+}
+
+/**
+ * encode_btype() assembles a B-Type instruction.
+ *
+ * This is the inverse of get_imm_b(): the 13-bit pc-relative offset
+ * is scattered back into the a, bcdefg, uvwx and y fields.
+ *
+ * @param funct3 The 3 funct3 bits.
+ * @param rs1 First register to compare.
+ * @param rs2 Second register to compare.
+ * @param pcrel_13 Signed, even, pc-relative branch offset.
+ *
+ * @return Returns the 32-bit encoded instruction.
+ *
+ ********************************************************************************/
+
+uint32_t rv32i_asm::encode_btype(uint32_t funct3, uint32_t rs1, uint32_t rs2, int32_t pcrel_13)
+{
+    uint32_t imm = pcrel_13;
+
+    return ((imm & 0x1000) << (31-12)) | ((imm & 0x07e0) << (25-5))
+         | ((rs2 & 0x1f) << 20) | ((rs1 & 0x1f) << 15) | ((funct3 & 0x7) << 12)
+         | ((imm & 0x001e) << (8-1)) | ((imm & 0x0800) >> (11-7)) | opcode_btype;
+}
+
+/**
+ * encode_utype() assembles a U-Type instruction.
+ *
+ * @param opcode The 7 opcode bits (lui or auipc).
+ * @param rd Destination register.
+ * @param imm The 20-bit upper immediate, not yet shifted into place.
+ *
+ * @return Returns the 32-bit encoded instruction.
+ *
+ ********************************************************************************/
+
+uint32_t rv32i_asm::encode_utype(uint32_t opcode, uint32_t rd, int32_t imm)
+{
+    return ((imm & 0xfffff) << 12) | ((rd & 0x1f) << 7) | (opcode & 0x7f);
+}
+
+/**
+ * encode_jtype() assembles the jal instruction.
+ *
+ * This is the inverse of get_imm_j().
+ *
+ * @param rd Link register.
+ * @param pcrel_21 Signed, even, pc-relative jump offset.
+ *
+ * @return Returns the 32-bit encoded instruction.
+ *
+ ********************************************************************************/
+
+uint32_t rv32i_asm::encode_jtype(uint32_t rd, int32_t pcrel_21)
+{
+    uint32_t imm = pcrel_21;
+
+    return ((imm & 0x100000) << (31-20)) | ((imm & 0x0007fe) << (21-1))
+         | ((imm & 0x000800) << (20-11)) | (imm & 0x0ff000)
+         | ((rd & 0x1f) << 7) | opcode_jal;
+}
+
+uint32_t rv32i_asm::encode_lui(uint32_t rd, int32_t imm20) { return encode_utype(opcode_lui, rd, imm20); }
+uint32_t rv32i_asm::encode_auipc(uint32_t rd, int32_t imm20) { return encode_utype(opcode_auipc, rd, imm20); }
+uint32_t rv32i_asm::encode_jal(uint32_t rd, int32_t pcrel_21) { return encode_jtype(rd, pcrel_21); }
+uint32_t rv32i_asm::encode_jalr(uint32_t rd, uint32_t rs1, int32_t imm) { return encode_itype(opcode_jalr, 0, rd, rs1, imm); }
+
+uint32_t rv32i_asm::encode_beq(uint32_t rs1, uint32_t rs2, int32_t pcrel_13) { return encode_btype(funct3_beq, rs1, rs2, pcrel_13); }
+uint32_t rv32i_asm::encode_bne(uint32_t rs1, uint32_t rs2, int32_t pcrel_13) { return encode_btype(funct3_bne, rs1, rs2, pcrel_13); }
+uint32_t rv32i_asm::encode_blt(uint32_t rs1, uint32_t rs2, int32_t pcrel_13) { return encode_btype(funct3_blt, rs1, rs2, pcrel_13); }
+uint32_t rv32i_asm::encode_bge(uint32_t rs1, uint32_t rs2, int32_t pcrel_13) { return encode_btype(funct3_bge, rs1, rs2, pcrel_13); }
+uint32_t rv32i_asm::encode_bltu(uint32_t rs1, uint32_t rs2, int32_t pcrel_13) { return encode_btype(funct3_bltu, rs1, rs2, pcrel_13); }
+uint32_t rv32i_asm::encode_bgeu(uint32_t rs1, uint32_t rs2, int32_t pcrel_13) { return encode_btype(funct3_bgeu, rs1, rs2, pcrel_13); }
+
+uint32_t rv32i_asm::encode_lb(uint32_t rd, uint32_t rs1, int32_t imm) { return encode_itype(opcode_load_imm, funct3_lb, rd, rs1, imm); }
+uint32_t rv32i_asm::encode_lh(uint32_t rd, uint32_t rs1, int32_t imm) { return encode_itype(opcode_load_imm, funct3_lh, rd, rs1, imm); }
+uint32_t rv32i_asm::encode_lw(uint32_t rd, uint32_t rs1, int32_t imm) { return encode_itype(opcode_load_imm, funct3_lw, rd, rs1, imm); }
+uint32_t rv32i_asm::encode_lbu(uint32_t rd, uint32_t rs1, int32_t imm) { return encode_itype(opcode_load_imm, funct3_lbu, rd, rs1, imm); }
+uint32_t rv32i_asm::encode_lhu(uint32_t rd, uint32_t rs1, int32_t imm) { return encode_itype(opcode_load_imm, funct3_lhu, rd, rs1, imm); }
+
+uint32_t rv32i_asm::encode_sb(uint32_t rs2, uint32_t rs1, int32_t imm) { return encode_stype(funct3_sb, rs1, rs2, imm); }
+uint32_t rv32i_asm::encode_sh(uint32_t rs2, uint32_t rs1, int32_t imm) { return encode_stype(funct3_sh, rs1, rs2, imm); }
+uint32_t rv32i_asm::encode_sw(uint32_t rs2, uint32_t rs1, int32_t imm) { return encode_stype(funct3_sw, rs1, rs2, imm); }
+
+uint32_t rv32i_asm::encode_addi(uint32_t rd, uint32_t rs1, int32_t imm) { return encode_itype(opcode_alu_imm, funct3_add, rd, rs1, imm); }
+uint32_t rv32i_asm::encode_slti(uint32_t rd, uint32_t rs1, int32_t imm) { return encode_itype(opcode_alu_imm, funct3_slt, rd, rs1, imm); }
+uint32_t rv32i_asm::encode_sltiu(uint32_t rd, uint32_t rs1, int32_t imm) { return encode_itype(opcode_alu_imm, funct3_sltu, rd, rs1, imm); }
+uint32_t rv32i_asm::encode_xori(uint32_t rd, uint32_t rs1, int32_t imm) { return encode_itype(opcode_alu_imm, funct3_xor, rd, rs1, imm); }
+uint32_t rv32i_asm::encode_ori(uint32_t rd, uint32_t rs1, int32_t imm) { return encode_itype(opcode_alu_imm, funct3_or, rd, rs1, imm); }
+uint32_t rv32i_asm::encode_andi(uint32_t rd, uint32_t rs1, int32_t imm) { return encode_itype(opcode_alu_imm, funct3_and, rd, rs1, imm); }
+uint32_t rv32i_asm::encode_slli(uint32_t rd, uint32_t rs1, uint32_t shamt) { return encode_itype(opcode_alu_imm, funct3_sll, rd, rs1, shamt%XLEN); }
+uint32_t rv32i_asm::encode_srli(uint32_t rd, uint32_t rs1, uint32_t shamt) { return encode_itype(opcode_alu_imm, funct3_srx, rd, rs1, shamt%XLEN); }
+uint32_t rv32i_asm::encode_srai(uint32_t rd, uint32_t rs1, uint32_t shamt) { return encode_itype(opcode_alu_imm, funct3_srx, rd, rs1, (funct7_sra << 5) | shamt%XLEN); }
+
+uint32_t rv32i_asm::encode_add(uint32_t rd, uint32_t rs1, uint32_t rs2) { return encode_rtype(funct7_add, funct3_add, rd, rs1, rs2); }
+uint32_t rv32i_asm::encode_sub(uint32_t rd, uint32_t rs1, uint32_t rs2) { return encode_rtype(funct7_sub, funct3_add, rd, rs1, rs2); }
+uint32_t rv32i_asm::encode_sll(uint32_t rd, uint32_t rs1, uint32_t rs2) { return encode_rtype(0, funct3_sll, rd, rs1, rs2); }
+uint32_t rv32i_asm::encode_slt(uint32_t rd, uint32_t rs1, uint32_t rs2) { return encode_rtype(0, funct3_slt, rd, rs1, rs2); }
+uint32_t rv32i_asm::encode_sltu(uint32_t rd, uint32_t rs1, uint32_t rs2) { return encode_rtype(0, funct3_sltu, rd, rs1, rs2); }
+uint32_t rv32i_asm::encode_xor(uint32_t rd, uint32_t rs1, uint32_t rs2) { return encode_rtype(0, funct3_xor, rd, rs1, rs2); }
+uint32_t rv32i_asm::encode_srl(uint32_t rd, uint32_t rs1, uint32_t rs2) { return encode_rtype(funct7_srl, funct3_srx, rd, rs1, rs2); }
+uint32_t rv32i_asm::encode_sra(uint32_t rd, uint32_t rs1, uint32_t rs2) { return encode_rtype(funct7_sra, funct3_srx, rd, rs1, rs2); }
+uint32_t rv32i_asm::encode_or(uint32_t rd, uint32_t rs1, uint32_t rs2) { return encode_rtype(0, funct3_or, rd, rs1, rs2); }
+uint32_t rv32i_asm::encode_and(uint32_t rd, uint32_t rs1, uint32_t rs2) { return encode_rtype(0, funct3_and, rd, rs1, rs2); }
+
+uint32_t rv32i_asm::encode_mul(uint32_t rd, uint32_t rs1, uint32_t rs2) { return encode_rtype(funct7_muldiv, funct3_mul, rd, rs1, rs2); }
+uint32_t rv32i_asm::encode_mulh(uint32_t rd, uint32_t rs1, uint32_t rs2) { return encode_rtype(funct7_muldiv, funct3_mulh, rd, rs1, rs2); }
+uint32_t rv32i_asm::encode_mulhsu(uint32_t rd, uint32_t rs1, uint32_t rs2) { return encode_rtype(funct7_muldiv, funct3_mulhsu, rd, rs1, rs2); }
+uint32_t rv32i_asm::encode_mulhu(uint32_t rd, uint32_t rs1, uint32_t rs2) { return encode_rtype(funct7_muldiv, funct3_mulhu, rd, rs1, rs2); }
+uint32_t rv32i_asm::encode_div(uint32_t rd, uint32_t rs1, uint32_t rs2) { return encode_rtype(funct7_muldiv, funct3_div, rd, rs1, rs2); }
+uint32_t rv32i_asm::encode_divu(uint32_t rd, uint32_t rs1, uint32_t rs2) { return encode_rtype(funct7_muldiv, funct3_divu, rd, rs1, rs2); }
+uint32_t rv32i_asm::encode_rem(uint32_t rd, uint32_t rs1, uint32_t rs2) { return encode_rtype(funct7_muldiv, funct3_rem, rd, rs1, rs2); }
+uint32_t rv32i_asm::encode_remu(uint32_t rd, uint32_t rs1, uint32_t rs2) { return encode_rtype(funct7_muldiv, funct3_remu, rd, rs1, rs2); }
+
+uint32_t rv32i_asm::encode_ecall() { return insn_ecall; }
+uint32_t rv32i_asm::encode_ebreak() { return insn_ebreak; }
+
+/**
+ * expand_compressed() converts an RV32C instruction into the 32-bit
+ * RV32I instruction it is defined to be equivalent to.
+ *
+ * The compressed formats keep three-bit register numbers (x8-x15) and
+ * scrambled immediates; each case below unpacks those and re-assembles
+ * the base instruction with the encode_* functions. Floating-point
+ * loads and stores, the RV64/RV128-only encodings and the reserved
+ * encodings are not supported.
+ *
+ * @param insn The 16-bit instruction parcel. Its two low bits must not be 0b11.
+ *
+ * @return Returns the expanded instruction, or 0 (an illegal instruction)
+ *         if the parcel is not a supported RV32C instruction.
+ *
+ ********************************************************************************/
+
+uint32_t rv32i_asm::expand_compressed(uint16_t insn)
+{
+    uint32_t op = insn & 0x3;
+    uint32_t funct3 = (insn >> 13) & 0x7;
+    uint32_t rd = (insn >> 7) & 0x1f;           // also rs1 in the CR/CI formats
+    uint32_t rs2 = (insn >> 2) & 0x1f;
+    uint32_t rdp = 8 + ((insn >> 2) & 0x7);     // rd' / rs2'
+    uint32_t rs1p = 8 + ((insn >> 7) & 0x7);    // rs1' / rd'
+
+    // 6-bit sign-extended immediate of the CI format: imm[5] = bit 12, imm[4:0] = bits 6:2
+    int32_t imm_ci = ((insn >> 2) & 0x1f) | ((insn & 0x1000) ? 0xffffffe0 : 0);
+
+    // 12-bit jump offset of the CJ format
+    int32_t imm_cj = ((insn >> 1) & 0x800) | ((insn >> 7) & 0x010) | ((insn >> 1) & 0x300)
+                   | ((insn << 2) & 0x400) | ((insn >> 1) & 0x040) | ((insn << 1) & 0x080)
+                   | ((insn >> 2) & 0x00e) | ((insn << 3) & 0x020);
+    if (imm_cj & 0x800)
+        imm_cj |= 0xfffff000;
+
+    // 9-bit branch offset of the CB format
+    int32_t imm_cb = ((insn >> 4) & 0x100) | ((insn >> 7) & 0x018) | ((insn << 1) & 0x0c0)
+                   | ((insn >> 2) & 0x006) | ((insn << 3) & 0x020);
+    if (imm_cb & 0x100)
+        imm_cb |= 0xfffffe00;
+
+    // word offset of c.lw / c.sw: uimm[5:3] = bits 12:10, uimm[2] = bit 6, uimm[6] = bit 5
+    int32_t uimm_w = ((insn >> 7) & 0x38) | ((insn >> 4) & 0x04) | ((insn << 1) & 0x40);
+
+    switch (op)
+    {
+        case 0b00:
+            switch (funct3)
+            {
+                case 0b000:                                     // c.addi4spn
+                {
+                    int32_t nzuimm = ((insn >> 7) & 0x030) | ((insn >> 1) & 0x3c0)
+                                   | ((insn >> 4) & 0x004) | ((insn >> 2) & 0x008);
+                    if (nzuimm == 0)
+                        return 0;
+                    return encode_addi(rdp, reg_sp, nzuimm);
+                }
+                case 0b010: return encode_lw(rdp, rs1p, uimm_w);    // c.lw
+                case 0b110: return encode_sw(rdp, rs1p, uimm_w);    // c.sw
+                default: return 0;
+            }
+
+        case 0b01:
+            switch (funct3)
+            {
+                case 0b000: return encode_addi(rd, rd, imm_ci);         // c.addi, c.nop
+                case 0b001: return encode_jal(reg_ra, imm_cj);          // c.jal
+                case 0b010: return encode_addi(rd, reg_zero, imm_ci);   // c.li
+                case 0b011:
+                    if (rd == reg_sp)                                   // c.addi16sp
+                    {
+                        int32_t nzimm = ((insn >> 3) & 0x200) | ((insn >> 2) & 0x010)
+                                      | ((insn << 1) & 0x040) | ((insn << 4) & 0x180)
+                                      | ((insn << 3) & 0x020);
+                        if (nzimm & 0x200)
+                            nzimm |= 0xfffffc00;
+                        if (nzimm == 0)
+                            return 0;
+                        return encode_addi(reg_sp, reg_sp, nzimm);
+                    }
+                    if (imm_ci == 0)
+                        return 0;
+                    return encode_lui(rd, imm_ci);                      // c.lui
+
+                case 0b100:
+                    switch ((insn >> 10) & 0x3)
+                    {
+                        case 0b00:                                      // c.srli
+                            if (insn & 0x1000)
+                                return 0;
+                            return encode_srli(rs1p, rs1p, rs2);
+                        case 0b01:                                      // c.srai
+                            if (insn & 0x1000)
+                                return 0;
+                            return encode_srai(rs1p, rs1p, rs2);
+                        case 0b10: return encode_andi(rs1p, rs1p, imm_ci);  // c.andi
+                        case 0b11:
+                            if (insn & 0x1000)
+                                return 0;
+                            switch ((insn >> 5) & 0x3)
+                            {
+                                case 0b00: return encode_sub(rs1p, rs1p, rdp);  // c.sub
+                                case 0b01: return encode_xor(rs1p, rs1p, rdp);  // c.xor
+                                case 0b10: return encode_or(rs1p, rs1p, rdp);   // c.or
+                                case 0b11: return encode_and(rs1p, rs1p, rdp);  // c.and
+                            }
+                    }
+                    return 0;
+
+                case 0b101: return encode_jal(reg_zero, imm_cj);               // c.j
+                case 0b110: return encode_beq(rs1p, reg_zero, imm_cb);         // c.beqz
+                case 0b111: return encode_bne(rs1p, reg_zero, imm_cb);         // c.bnez
+            }
+            return 0;
+
+        case 0b10:
+            switch (funct3)
+            {
+                case 0b000:                                             // c.slli
+                    if (insn & 0x1000)
+                        return 0;
+                    return encode_slli(rd, rd, rs2);
+
+                case 0b010:                                             // c.lwsp
+                {
+                    int32_t uimm = ((insn >> 7) & 0x20) | ((insn >> 2) & 0x1c) | ((insn << 4) & 0xc0);
+                    if (rd == 0)
+                        return 0;
+                    return encode_lw(rd, reg_sp, uimm);
+                }
+
+                case 0b100:
+                    if ((insn & 0x1000) == 0)
+                    {
+                        if (rs2 == 0)                                   // c.jr
+                            return rd == 0 ? 0 : encode_jalr(reg_zero, rd, 0);
+                        return encode_add(rd, reg_zero, rs2);           // c.mv
+                    }
+                    if (rd == 0 && rs2 == 0)
+                        return encode_ebreak();                         // c.ebreak
+                    if (rs2 == 0)
+                        return encode_jalr(reg_ra, rd, 0);              // c.jalr
+                    return encode_add(rd, rd, rs2);                     // c.add
+
+                case 0b110:                                             // c.swsp
+                {
+                    int32_t uimm = ((insn >> 7) & 0x3c) | ((insn >> 1) & 0xc0);
+                    return encode_sw(rs2, reg_sp, uimm);
+                }
+
+                default: return 0;
+            }
+    }
+
+    return 0;
+}
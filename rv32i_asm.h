@@ -0,0 +1,101 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#ifndef H_RV32I_ASM
+#define H_RV32I_ASM
+
+#include "rv32i_decode.h"
+
+class rv32i_asm : public rv32i_decode
+{
+public:
+    static uint32_t encode_rtype(uint32_t funct7, uint32_t funct3, uint32_t rd, uint32_t rs1, uint32_t rs2);
+    static uint32_t encode_itype(uint32_t opcode, uint32_t funct3, uint32_t rd, uint32_t rs1, int32_t imm);
+    static uint32_t encode_stype(uint32_t funct3, uint32_t rs1, uint32_t rs2, int32_t imm);
+    static uint32_t encode_btype(uint32_t funct3, uint32_t rs1, uint32_t rs2, int32_t pcrel_13);
+    static uint32_t encode_utype(uint32_t opcode, uint32_t rd, int32_t imm);
+    static uint32_t encode_jtype(uint32_t rd, int32_t pcrel_21);
+
+    static uint32_t encode_lui(uint32_t rd, int32_t imm20);
+    static uint32_t encode_auipc(uint32_t rd, int32_t imm20);
+    static uint32_t encode_jal(uint32_t rd, int32_t pcrel_21);
+    static uint32_t encode_jalr(uint32_t rd, uint32_t rs1, int32_t imm);
+
+    static uint32_t encode_beq(uint32_t rs1, uint32_t rs2, int32_t pcrel_13);
+    static uint32_t encode_bne(uint32_t rs1, uint32_t rs2, int32_t pcrel_13);
+    static uint32_t encode_blt(uint32_t rs1, uint32_t rs2, int32_t pcrel_13);
+    static uint32_t encode_bge(uint32_t rs1, uint32_t rs2, int32_t pcrel_13);
+    static uint32_t encode_bltu(uint32_t rs1, uint32_t rs2, int32_t pcrel_13);
+    static uint32_t encode_bgeu(uint32_t rs1, uint32_t rs2, int32_t pcrel_13);
+
+    static uint32_t encode_lb(uint32_t rd, uint32_t rs1, int32_t imm);
+    static uint32_t encode_lh(uint32_t rd, uint32_t rs1, int32_t imm);
+    static uint32_t encode_lw(uint32_t rd, uint32_t rs1, int32_t imm);
+    static uint32_t encode_lbu(uint32_t rd, uint32_t rs1, int32_t imm);
+    static uint32_t encode_lhu(uint32_t rd, uint32_t rs1, int32_t imm);
+
+    static uint32_t encode_sb(uint32_t rs2, uint32_t rs1, int32_t imm);
+    static uint32_t encode_sh(uint32_t rs2, uint32_t rs1, int32_t imm);
+    static uint32_t encode_sw(uint32_t rs2, uint32_t rs1, int32_t imm);
+
+    static uint32_t encode_addi(uint32_t rd, uint32_t rs1, int32_t imm);
+    static uint32_t encode_slti(uint32_t rd, uint32_t rs1, int32_t imm);
+    static uint32_t encode_sltiu(uint32_t rd, uint32_t rs1, int32_t imm);
+    static uint32_t encode_xori(uint32_t rd, uint32_t rs1, int32_t imm);
+    static uint32_t encode_ori(uint32_t rd, uint32_t rs1, int32_t imm);
+    static uint32_t encode_andi(uint32_t rd, uint32_t rs1, int32_t imm);
+    static uint32_t encode_slli(uint32_t rd, uint32_t rs1, uint32_t shamt);
+    static uint32_t encode_srli(uint32_t rd, uint32_t rs1, uint32_t shamt);
+    static uint32_t encode_srai(uint32_t rd, uint32_t rs1, uint32_t shamt);
+
+    static uint32_t encode_add(uint32_t rd, uint32_t rs1, uint32_t rs2);
+    static uint32_t encode_sub(uint32_t rd, uint32_t rs1, uint32_t rs2);
+    static uint32_t encode_sll(uint32_t rd, uint32_t rs1, uint32_t rs2);
+    static uint32_t encode_slt(uint32_t rd, uint32_t rs1, uint32_t rs2);
+    static uint32_t encode_sltu(uint32_t rd, uint32_t rs1, uint32_t rs2);
+    static uint32_t encode_xor(uint32_t rd, uint32_t rs1, uint32_t rs2);
+    static uint32_t encode_srl(uint32_t rd, uint32_t rs1, uint32_t rs2);
+    static uint32_t encode_sra(uint32_t rd, uint32_t rs1, uint32_t rs2);
+    static uint32_t encode_or(uint32_t rd, uint32_t rs1, uint32_t rs2);
+    static uint32_t encode_and(uint32_t rd, uint32_t rs1, uint32_t rs2);
+
+    static uint32_t encode_mul(uint32_t rd, uint32_t rs1, uint32_t rs2);
+    static uint32_t encode_mulh(uint32_t rd, uint32_t rs1, uint32_t rs2);
+    static uint32_t encode_mulhsu(uint32_t rd, uint32_t rs1, uint32_t rs2);
+    static uint32_t encode_mulhu(uint32_t rd, uint32_t rs1, uint32_t rs2);
+    static uint32_t encode_div(uint32_t rd, uint32_t rs1, uint32_t rs2);
+    static uint32_t encode_divu(uint32_t rd, uint32_t rs1, uint32_t rs2);
+    static uint32_t encode_rem(uint32_t rd, uint32_t rs1, uint32_t rs2);
+    static uint32_t encode_remu(uint32_t rd, uint32_t rs1, uint32_t rs2);
+
+    static uint32_t encode_ecall();
+    static uint32_t encode_ebreak();
+
+    static uint32_t expand_compressed(uint16_t insn);
+
+    static constexpr uint32_t reg_zero  = 0;
+    static constexpr uint32_t reg_ra    = 1;
+    static constexpr uint32_t reg_sp    = 2;
+    static constexpr uint32_t reg_t0    = 5;
+    static constexpr uint32_t reg_t1    = 6;
+    static constexpr uint32_t reg_t2    = 7;
+    static constexpr uint32_t reg_s0    = 8;
+    static constexpr uint32_t reg_s1    = 9;
+    static constexpr uint32_t reg_a0    = 10;
+    static constexpr uint32_t reg_a1    = 11;
+    static constexpr uint32_t reg_a2    = 12;
+    static constexpr uint32_t reg_a3    = 13;
+    static constexpr uint32_t reg_a4    = 14;
+    static constexpr uint32_t reg_a5    = 15;
+    static constexpr uint32_t reg_a7    = 17;
+    static constexpr uint32_t reg_t3    = 28;
+    static constexpr uint32_t reg_t4    = 29;
+    static constexpr uint32_t reg_t5    = 30;
+    static constexpr uint32_t reg_t6    = 31;
+};
+
+#endif
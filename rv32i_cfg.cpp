@@ -0,0 +1,313 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#include "rv32i_cfg.h"
+#include "rv32i_predecode.h"
+#include <fstream>
+#include <set>
+
+/**
+ * add_root() adds a place where code is known to start.
+ *
+ * @param name Shown on its block in the output; may be empty.
+ *
+ ********************************************************************************/
+
+void rv32i_cfg::add_root(uint32_t pc, const std::string &name)
+{
+    roots.push_back(pc);
+    if (!name.empty() && names.find(pc) == names.end())
+        names[pc] = name;
+}
+
+/**
+ * build() discovers the code reachable from the roots and splits it into
+ * basic blocks.
+ *
+ * Each path is followed from a root or a target until an instruction that
+ * ends it. Every target and every return site starts a block. A block
+ * then runs from its start to the first instruction that ends a path or
+ * the instruction before the next block, whichever comes first.
+ *
+ * @param mem The memory holding the program.
+ * @param rvc True if compressed instructions are enabled.
+ *
+ ********************************************************************************/
+
+void rv32i_cfg::build(const memory &mem, bool rvc)
+{
+    uint32_t align = rvc ? 1 : 3;
+    std::map<uint32_t, step> seen;
+    std::set<uint32_t> leaders;
+    std::vector<uint32_t> work;
+
+    auto reach = [&](uint32_t pc)
+    {
+        if ((pc & align) == 0 && leaders.insert(pc).second)
+            work.push_back(pc);
+    };
+
+    for (uint32_t r : roots)
+        reach(r);
+
+    while (!work.empty())
+    {
+        uint32_t pc = work.back();
+        work.pop_back();
+
+        uint32_t prev_pc = 0;
+        uint32_t prev = 0;              // the instruction before pc on this path, or 0
+        step s;
+
+        while (seen.find(pc) == seen.end() && rv32i_predecode::fetch(mem, pc, rvc, s.bits, s.size))
+        {
+            rv32i_decode::decoded_insn d = rv32i_decode::decode_insn(pc, s.bits);
+            s.ends = true;
+            s.falls = false;
+            s.kind = edge_next;
+            s.indirect = false;
+            s.has_target = false;
+
+            switch (d.id)
+            {
+                case rv32i_isa::id_beq:
+                case rv32i_isa::id_bne:
+                case rv32i_isa::id_blt:
+                case rv32i_isa::id_bge:
+                case rv32i_isa::id_bltu:
+                case rv32i_isa::id_bgeu:
+                    s.has_target = true;
+                    s.kind = edge_taken;
+                    s.target = d.target;
+                    s.falls = true;
+                    break;
+
+                case rv32i_isa::id_jal:
+                    s.has_target = true;
+                    s.kind = d.rd ? edge_call : edge_jump;
+                    s.target = d.target;
+                    s.falls = d.rd != 0;
+                    break;
+
+                case rv32i_isa::id_jalr:
+                    if (prev && rv32i_isa::get_rd(prev) == d.rs1 && d.rs1 != 0)
+                    {
+                        rv32i_isa::insn_id p = rv32i_isa::lookup(prev).id;
+                        if (p == rv32i_isa::id_auipc || p == rv32i_isa::id_lui)
+                        {
+                            s.has_target = true;
+                            s.target = ((p == rv32i_isa::id_auipc ? prev_pc : 0) + rv32i_isa::get_imm_u(prev) + d.imm) & ~1u;
+                        }
+                    }
+                    s.indirect = !s.has_target;
+                    s.kind = d.rd ? edge_call : edge_jump;
+                    s.falls = d.rd != 0;
+                    break;
+
+                case rv32i_isa::id_ebreak:
+                case rv32i_isa::id_mret:
+                case rv32i_isa::id_illegal:
+                    break;
+
+                default:
+                    s.ends = false;
+                    s.falls = true;
+                    break;
+            }
+
+            seen[pc] = s;
+            if (s.has_target)
+                reach(s.target);
+            if (s.ends)
+            {
+                if (s.falls)
+                    reach(pc + s.size);
+                break;
+            }
+
+            prev_pc = pc;
+            prev = s.bits;
+            pc += s.size;
+        }
+    }
+
+    blocks.clear();
+    for (uint32_t start : leaders)
+    {
+        auto it = seen.find(start);
+        if (it == seen.end())
+            continue;
+
+        block &b = blocks[start];
+        b.start = start;
+
+        uint32_t pc = start;
+        while (true)
+        {
+            const step &s = it->second;
+            b.code.push_back({ pc, s.bits });
+            uint32_t next = pc + s.size;
+
+            if (s.ends)
+            {
+                if (s.has_target)
+                    b.succ.push_back({ s.target, s.kind });
+                if (s.falls)
+                    b.succ.push_back({ next, edge_next });
+                b.indirect = s.indirect;
+                b.end = next;
+                break;
+            }
+
+            it = seen.find(next);
+            if (it == seen.end() || leaders.count(next))
+            {
+                if (it != seen.end())
+                    b.succ.push_back({ next, edge_next });
+                b.end = next;
+                break;
+            }
+            pc = next;
+        }
+    }
+}
+
+/**
+ * get_insn_count() is the number of instructions in all blocks.
+ *
+ ********************************************************************************/
+
+uint32_t rv32i_cfg::get_insn_count() const
+{
+    uint32_t n = 0;
+    for (const auto &b : blocks)
+        n += b.second.code.size();
+    return n;
+}
+
+const char *rv32i_cfg::kind_name(edge_kind k)
+{
+    switch (k)
+    {
+        case edge_taken: return "taken";
+        case edge_jump: return "jump";
+        case edge_call: return "call";
+        default: return "next";
+    }
+}
+
+/**
+ * save() writes the graph to fname: as JSON if the name ends in ".json",
+ * otherwise as DOT.
+ *
+ * @return false if the file cannot be opened.
+ *
+ ********************************************************************************/
+
+bool rv32i_cfg::save(const std::string &fname) const
+{
+    std::ofstream out(fname);
+    if (!out.is_open())
+    {
+        std::cerr << "Can't open file '" << fname << "' for writing.\n";
+        return false;
+    }
+
+    std::string ext = ".json";
+    if (fname.size() >= ext.size() && fname.compare(fname.size() - ext.size(), ext.size(), ext) == 0)
+        write_json(out);
+    else
+        write_dot(out);
+    return true;
+}
+
+/**
+ * write_dot() writes one box per block, listing its disassembly, with
+ * edges labelled by kind. Unknown jalr targets lead to a "?" node.
+ *
+ ********************************************************************************/
+
+void rv32i_cfg::write_dot(std::ostream &os) const
+{
+    char text[rv32i_decode::render_size];
+    bool any_indirect = false;
+
+    os << "digraph cfg {\n";
+    os << "    node [shape=box, fontname=\"monospace\"];\n";
+
+    for (const auto &e : blocks)
+    {
+        const block &b = e.second;
+        os << "    b" << hex32(b.start) << " [label=\"";
+
+        auto n = names.find(b.start);
+        if (n != names.end())
+            os << n->second << ":\\l";
+
+        for (const insn &i : b.code)
+        {
+            rv32i_decode::render(rv32i_decode::decode_insn(i.pc, i.bits), text, sizeof(text));
+            os << hex32(i.pc) << ": " << text << "\\l";
+        }
+        os << "\"];\n";
+
+        for (const edge &s : b.succ)
+        {
+            if (blocks.find(s.to) != blocks.end())
+                os << "    b" << hex32(b.start) << " -> b" << hex32(s.to) << " [label=\"" << kind_name(s.kind) << "\"];\n";
+        }
+        if (b.indirect)
+        {
+            os << "    b" << hex32(b.start) << " -> unknown [style=dashed];\n";
+            any_indirect = true;
+        }
+    }
+
+    if (any_indirect)
+        os << "    unknown [shape=plaintext, label=\"?\"];\n";
+    os << "}\n";
+}
+
+/**
+ * write_json() writes the blocks as an array of objects with numeric
+ * addresses:
+ *
+ *     { "blocks": [ { "start": 0, "end": 16, "insns": 4, "name": "_start",
+ *                     "indirect": false,
+ *                     "succ": [ { "to": 16, "kind": "next" } ] } ] }
+ *
+ * "name" is only present for roots that have one.
+ *
+ ********************************************************************************/
+
+void rv32i_cfg::write_json(std::ostream &os) const
+{
+    os << "{\n  \"blocks\": [";
+
+    const char *sep = "\n";
+    for (const auto &e : blocks)
+    {
+        const block &b = e.second;
+        os << sep << "    { \"start\": " << b.start << ", \"end\": " << b.end
+           << ", \"insns\": " << b.code.size();
+
+        auto n = names.find(b.start);
+        if (n != names.end())
+            os << ", \"name\": \"" << n->second << "\"";
+
+        os << ", \"indirect\": " << (b.indirect ? "true" : "false") << ", \"succ\": [";
+        const char *s_sep = "";
+        for (const edge &s : b.succ)
+        {
+            os << s_sep << "{ \"to\": " << s.to << ", \"kind\": \"" << kind_name(s.kind) << "\" }";
+            s_sep = ", ";
+        }
+        os << "] }";
+        sep = ",\n";
+    }
+    os << "\n  ]\n}\n";
+}
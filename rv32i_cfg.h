@@ -0,0 +1,87 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#ifndef H_RV32I_CFG
+#define H_RV32I_CFG
+
+#include "rv32i_decode.h"
+#include "memory.h"
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * rv32i_cfg recovers the control-flow graph of a program before it runs.
+ *
+ * Code is discovered from the roots (the entry point and any ELF
+ * functions) by following branch and jal targets, the targets of
+ * auipc/jalr and lui/jalr pairs, and the return sites of calls. Other
+ * jalr targets are not known; blocks ending in one are marked indirect.
+ * ebreak, mret and illegal instructions end a path.
+ *
+ * The graph can be written out as Graphviz DOT or as JSON.
+ *
+ ********************************************************************************/
+
+class rv32i_cfg : public hex
+{
+public:
+    enum edge_kind : uint8_t { edge_next, edge_taken, edge_jump, edge_call };
+
+    struct edge
+    {
+        uint32_t to;
+        edge_kind kind;
+    };
+
+    struct insn
+    {
+        uint32_t pc;
+        uint32_t bits;                  ///< Expanded, if compressed.
+    };
+
+    struct block
+    {
+        uint32_t start = { 0 };
+        uint32_t end = { 0 };           ///< Address after the last instruction.
+        bool indirect = { false };      ///< Ends in a jalr whose target is not known.
+        std::vector<insn> code;
+        std::vector<edge> succ;
+    };
+
+    void add_root(uint32_t pc, const std::string &name = "");
+    void build(const memory &mem, bool rvc);
+
+    const std::map<uint32_t, block> &get_blocks() const { return blocks; }
+    uint32_t get_insn_count() const;
+
+    bool save(const std::string &fname) const;
+    void write_dot(std::ostream &os) const;
+    void write_json(std::ostream &os) const;
+
+private:
+    /// What discovery found at one pc.
+    struct step
+    {
+        uint32_t bits = { 0 };
+        uint8_t size = { 4 };
+        bool ends = { false };          ///< Ends its block.
+        bool falls = { true };          ///< pc+size can run next.
+        bool indirect = { false };
+        bool has_target = { false };
+        edge_kind kind = { edge_next };
+        uint32_t target = { 0 };
+    };
+
+    static const char *kind_name(edge_kind k);
+
+    std::vector<uint32_t> roots;
+    std::map<uint32_t, std::string> names;
+    std::map<uint32_t, block> blocks;
+};
+
+#endif
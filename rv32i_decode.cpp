@@ -8,353 +8,296 @@
 #include "rv32i_decode.h"
 
 /**
- * Decodes / displays the hexadecimal instructions. 
+ * Decodes / displays the hexadecimal instructions.
  *
- * By running through each case using switch statements, the opcode
- * is further split into sub-types and then further divided by the 
- * values of the funct3 and funct7 bits. These determine what
- * instruction is being decoded from the mem (memory) vector. 
+ * Equivalent to decode_insn() followed by render(), returned as a string.
+ * Code that disassembles many instructions should call those two with
+ * its own buffer instead.
  *
  * @param addr Address of the instruction. 32 bits long.
- * @param insn Instruction to be decoded. 
+ * @param insn Instruction to be decoded.
  *
  * @return Returns a render() of the instruction: The appropriate
  *         mnemonic and any relevant values such as register values,
- *         imm_x's, and/or base displacement / address values. 
- *
- * @note Includes defaults and asserts so the function doesn't fall through.
+ *         imm_x's, and/or base displacement / address values.
  *
- * @warning Will read any insn, even if it is invalid. 
+ * @warning Will read any insn, even if it is invalid.
             Will return render_illegal_insn() in such case.
  *
  ********************************************************************************/
 
-std::string rv32i_decode::decode(uint32_t addr, uint32_t insn) 
-{
-switch(get_opcode(insn))
+std::string rv32i_decode::decode(uint32_t addr, uint32_t insn)
 {
-    default: return render_illegal_insn();
-    case opcode_lui: return render_lui(insn);
-    case opcode_auipc: return render_auipc(insn);
-    case opcode_jal: return render_jal(addr, insn);
-    case opcode_jalr: return render_jalr(insn);
-
-    case opcode_rtype:
-        switch(get_funct3(insn))
-        {
-            default: return render_illegal_insn();
-            
-            case funct3_add:
-                switch(get_funct7(insn))
-                {
-                    default: return render_illegal_insn();
-                    case funct7_add: return render_rtype(insn, "add");
-                    case funct7_sub: return render_rtype(insn, "sub");
-                }
-                assert(0 && "unrecognized funct3");
-  
-            case funct3_sll: return render_rtype(insn, "sll");
-            case funct3_slt: return render_rtype(insn, "slt");
-            case funct3_sltu: return render_rtype(insn, "sltu");
-            case funct3_xor: return render_rtype(insn, "xor");
-
-            case funct3_srx:
-                switch(get_funct7(insn))
-                {
-                    default: return render_illegal_insn();
-                    case funct7_srl: return render_rtype(insn, "srl");
-                    case funct7_sra: return render_rtype(insn, "sra");
-                }
-                assert(0 && "unrecognized funct7");  
-
-            case funct3_or: return render_rtype(insn, "or");
-            case funct3_and: return render_rtype(insn, "and");
-        }
-        assert(0 && "unrecognized funct3");
-
-    case opcode_btype:
-        switch (get_funct3(insn))
-        {
-            default: return render_illegal_insn();
-            case funct3_beq: return render_btype(addr, insn, "beq");
-            case funct3_bne: return render_btype(addr, insn, "bne");
-            case funct3_blt: return render_btype(addr, insn, "blt");
-            case funct3_bge: return render_btype(addr, insn, "bge");
-            case funct3_bltu: return render_btype(addr, insn, "bltu");
-            case funct3_bgeu: return render_btype(addr, insn, "bgeu");
-        }
-        assert(0 && "unrecognized funct3"); // impossible
-
-    case opcode_system:
-        switch(get_funct3(insn))
-        {
-            default: return render_illegal_insn();
-            case funct3_csrrw: return render_csrrx(insn, "csrrw");
-            case funct3_csrrs: return render_csrrx(insn, "csrrs");
-            case funct3_csrrc: return render_csrrx(insn, "csrrc");
-
-            case funct3_csrrwi: return render_csrrxi(insn, "csrrwi");
-            case funct3_csrrsi: return render_csrrxi(insn, "csrrsi");
-            case funct3_csrrci: return render_csrrxi(insn, "csrrci");
-
-            case funct3_e:
-                switch(get_imm_i(insn))
-                {
-                    default: return render_illegal_insn();
-                    case 0: return render_ecall();
-                    case 1: return render_ebreak();
-                }
-                assert(0 && "unrecognized imm_i");
-        }
-        assert(0 && "unrecognized funct3");
-
-    case opcode_stype:
-        switch(get_funct3(insn))
-        {
-            default: return render_illegal_insn();
-            case funct3_sb: return render_stype(insn, "sb");
-            case funct3_sh: return render_stype(insn, "sh");
-            case funct3_sw: return render_stype(insn, "sw");
-        }
-        assert(0 && "unrecognized funct3");
-
-    case opcode_load_imm:
-        switch(get_funct3(insn))
-        {
-            default: return render_illegal_insn();
-            case funct3_lb: return render_itype_load(insn, "lb");
-            case funct3_lh: return render_itype_load(insn, "lh");
-            case funct3_lw: return render_itype_load(insn, "lw");
-            case funct3_lbu: return render_itype_load(insn, "lbu");
-            case funct3_lhu: return render_itype_load(insn, "lhu");
-        }
-        assert(0 && "unrecognized funct3");
-
-    case opcode_alu_imm:
-        switch (get_funct3(insn))
-        {
-            default: return render_illegal_insn();
-            case funct3_add: return render_itype_alu(insn, "addi", get_imm_i(insn));
-            case funct3_sll: return render_itype_alu(insn, "slli", get_imm_i(insn)%XLEN);
-            case funct3_slt: return render_itype_alu(insn, "slti", get_imm_i(insn));
-            case funct3_sltu: return render_itype_alu(insn, "sltiu", get_imm_i(insn));
-            case funct3_xor: return render_itype_alu(insn, "xori", get_imm_i(insn));
-            case funct3_or: return render_itype_alu(insn, "ori", get_imm_i(insn));
-            case funct3_and: return render_itype_alu(insn, "andi", get_imm_i(insn));
-
-            case funct3_srx:
-                switch(get_funct7(insn))
-                {
-                    default: return render_illegal_insn();
-                    case funct7_sra: return render_itype_alu(insn, "srai", get_imm_i(insn)%XLEN);
-                    case funct7_srl: return render_itype_alu(insn, "srli", get_imm_i(insn)%XLEN);
-                }
-        assert(0 && "unrecognized funct7"); // impossible
-        }
-    assert(0 && "unrecognized funct3"); // impossible
-
-}
-assert(0 && "unrecognized opcode"); // It should be impossible to ever get here!
-}
-
-/**
- * get_opcode() gets the opcode from the insn passed. 
- *
- * @param insn Instruction to be decoded. 
- *
- * @return Returns the first (least significant) 7 bits of the insn.
- *
- ********************************************************************************/
-
-uint32_t rv32i_decode::get_opcode(uint32_t insn)
-{
-    return (insn & 0x0000007f);
+    char buf[render_size];
+    render(decode_insn(addr, insn), buf, sizeof(buf));
+    return buf;
 }
 
 /**
- * get_rd() gets the rd value from the insn passed. 
+ * decode_insn() splits an instruction into its fields.
  *
- * @param insn Instruction to be decoded. 
+ * The instruction is classified with rv32i_isa::lookup() and the fields
+ * its operand format uses are extracted. Branch and jal targets are
+ * resolved against addr.
  *
- * @return Returns the 5 bits of the insn to the left of the opcode.
- *
- ********************************************************************************/
-
-uint32_t rv32i_decode::get_rd(uint32_t insn)
-{
-    int32_t rd = (insn & 0x00000f80) >> 7;  // Shift right 7 to get proper value
-    return rd;
-}
-
-/**
- * get_funct3() gets the rd value from the insn passed. 
- *
- * @param insn Instruction to be decoded. 
- *
- * @return Returns the 3 bits of the insn to the left of the rd bits.
- *
- ********************************************************************************/
-
-uint32_t rv32i_decode::get_funct3(uint32_t insn)
-{
-    int32_t funct3 = (insn & 0x00007000) >> 12;  // Shift right 12 to get proper value
-    return funct3;
-}
-
-/**
- * get_rs1() gets the rs1 value from the insn passed. 
- *
- * @param insn Instruction to be decoded. 
- *
- * @return Returns the 5 bits of the insn to the left of the funct3 bits.
- *
- ********************************************************************************/
-
-uint32_t rv32i_decode::get_rs1(uint32_t insn)
-{
-    int32_t rs1 = (insn & 0x000f8000) >> 15;  // Shift right 15 to get proper value
-    return rs1;
-}
-
-/**
- * get_rs2() gets the rs2 value from the insn passed. 
- *
- * @param insn Instruction to be decoded. 
+ * @param addr Address of the instruction.
+ * @param insn Instruction to be decoded.
  *
- * @return Returns the 5 bits of the insn to the left of the rs1 bits.
+ * @return Returns the decoded fields. id is id_illegal if insn is not
+ *         a supported instruction.
  *
  ********************************************************************************/
 
-uint32_t rv32i_decode::get_rs2(uint32_t insn)
+rv32i_decode::decoded_insn rv32i_decode::decode_insn(uint32_t addr, uint32_t insn)
 {
-    int32_t rs2 = (insn & 0x01f00000) >> 20;  // Shift right 20 to get proper value
-    return rs2;
-}
+    const rv32i_isa::insn_info &i = rv32i_isa::lookup(insn);
+    decoded_insn d = { i.id, i.fmt, i.mnemonic, 0, 0, 0, 0, 0, 0 };
 
-/**
- * get_funct7() gets the funct7 value from the insn passed. 
- *
- * @param insn Instruction to be decoded. 
- *
- * @return Returns the 7 bits of the insn to the left of the rs2 or shamt bits.
- *
- ********************************************************************************/
+    switch (i.fmt)
+    {
+        case rv32i_isa::fmt_none:
+            break;
+
+        case rv32i_isa::fmt_u:
+            d.rd = get_rd(insn);
+            d.imm = (get_imm_u(insn) >> 12) & 0x0fffff;
+            break;
+
+        case rv32i_isa::fmt_j:
+            d.rd = get_rd(insn);
+            d.imm = get_imm_j(insn);
+            d.target = addr + d.imm;
+            break;
+
+        case rv32i_isa::fmt_b:
+            d.rs1 = get_rs1(insn);
+            d.rs2 = get_rs2(insn);
+            d.imm = get_imm_b(insn);
+            d.target = addr + d.imm;
+            break;
+
+        case rv32i_isa::fmt_jalr:
+        case rv32i_isa::fmt_load:
+        case rv32i_isa::fmt_i:
+            d.rd = get_rd(insn);
+            d.rs1 = get_rs1(insn);
+            d.imm = get_imm_i(insn);
+            break;
+
+        case rv32i_isa::fmt_shift:
+            d.rd = get_rd(insn);
+            d.rs1 = get_rs1(insn);
+            d.imm = get_imm_i(insn)%XLEN;
+            break;
+
+        case rv32i_isa::fmt_s:
+            d.rs1 = get_rs1(insn);
+            d.rs2 = get_rs2(insn);
+            d.imm = get_imm_s(insn);
+            break;
+
+        case rv32i_isa::fmt_r:
+            d.rd = get_rd(insn);
+            d.rs1 = get_rs1(insn);
+            d.rs2 = get_rs2(insn);
+            break;
+
+        case rv32i_isa::fmt_csr:
+            d.rd = get_rd(insn);
+            d.rs1 = get_rs1(insn);
+            d.csr = get_imm_i(insn) & 0xfff;
+            break;
+
+        case rv32i_isa::fmt_csri:
+            d.rd = get_rd(insn);
+            d.imm = get_rs1(insn);
+            d.csr = get_imm_i(insn) & 0xfff;
+            break;
+    }
 
-uint32_t rv32i_decode::get_funct7(uint32_t insn)
-{
-    int32_t funct7 = (insn & 0xfe000000) >> 25;  // Shift right 25 to get proper value
-    return funct7;
+    return d;
 }
 
 /**
- * get_imm_i() gets the imm_i value from the insn passed. 
- *
- * @param insn Instruction to be decoded. 
- *
- * @return Returns the 12 bits of the insn to the left of the rs1 bits.
+ * text_out writes into a fixed buffer, dropping what does not fit.
  *
  ********************************************************************************/
 
-int32_t rv32i_decode::get_imm_i(uint32_t insn)
+namespace
 {
-    int32_t imm_i = (insn & 0xfff00000) >> 20;  // Shift right 20 to get proper value
-    
-    if (insn & 0x80000000)
+    struct text_out
     {
-        imm_i |= 0xfffff000;    // sign-extend the left
-    }
-
-    return imm_i;
-}
+        char *p;
+        char *end;      // last usable position, kept for the NUL
 
-/**
- * get_imm_u() gets the imm_u value from the insn passed. 
- *
- * @param insn Instruction to be decoded. 
- *
- * @return Returns the 20 bits of the insn to the left of the rd bits.
- *         Zeroes out the least significant 12 bits at the beginning.
- *
- ********************************************************************************/
+        void put(char c)
+        {
+            if (p < end)
+                *p++ = c;
+        }
 
-int32_t rv32i_decode::get_imm_u(uint32_t insn)
-{
-    int32_t imm_u = (insn & 0xfffff000);
+        void put(const char *s)
+        {
+            while (*s)
+                put(*s++);
+        }
 
-    return imm_u;
-}
+        void put_dec(int32_t v)
+        {
+            char tmp[12];
+            int n = 0;
+            uint32_t u = v < 0 ? 0u - uint32_t(v) : uint32_t(v);
+
+            do
+            {
+                tmp[n++] = '0' + u % 10;
+                u /= 10;
+            } while (u);
+
+            if (v < 0)
+                put('-');
+            while (n)
+                put(tmp[--n]);
+        }
 
-/**
- * get_imm_b() gets the imm_b value from the insn passed. 
- *
- * @param insn Instruction to be decoded. 
- *
- * @return Returns the 13 bits of the insn that are all over the place.
- *         Sign extension.
- *
- ********************************************************************************/
+        void put_hex(uint32_t v, int width)
+        {
+            char tmp[12];
+            char *e = hex::append_hex(tmp, v, width, true);
+            for (char *q = tmp; q < e; ++q)
+                put(*q);
+        }
 
-int32_t rv32i_decode::get_imm_b(uint32_t insn)
-{
-    int32_t imm_b = (insn & 0x7e000000) >> (25-5);  // b, c, d, e, f, g
-    imm_b |= (insn & 0x00000f00) >> (8-1);    // u, v, w, x
-    imm_b |= (insn & 0x80000000) >> (31-12);  // Most Significant Bit 'a'
-    imm_b |= (insn & 0x00000080) << (11-7);   // Move 'y' to the left 4 positions
+        void put_reg(uint32_t r)
+        {
+            put('x');
+            put_dec(r);
+        }
 
-    if (insn & 0x80000000)
-    {
-        imm_b |= 0xffffe000; // sign-extend the left 19 bits
-    }
+        void put_mnemonic(const char *m, int width)
+        {
+            const char *start = p;
+            put(m);
+            while (p - start < width)
+                put(' ');
+        }
 
-    return imm_b;
+        void put_base_disp(int32_t disp, uint32_t base)
+        {
+            put_dec(disp);
+            put('(');
+            put_reg(base);
+            put(')');
+        }
+    };
 }
 
 /**
- * get_imm_s() gets the imm_s value from the insn passed. 
+ * render() formats a decoded instruction as assembly text.
+ *
+ * The mnemonic is left-aligned in mnemonic_width columns and followed by
+ * the operands, e.g. "addi    x2,x2,-32" or "beq     x9,x0,0x00000050".
+ * Nothing is allocated; the text is written into the caller's buffer.
  *
- * @param insn Instruction to be decoded. 
+ * @param d The decoded instruction.
+ * @param buf Where to write the text. It is always NUL-terminated.
+ * @param size The size of buf. render_size is always enough.
  *
- * @return Returns the 12 bits of the insn that represent imm_s.
- *         Sign extension.
+ * @return Returns the length of the text.
  *
  ********************************************************************************/
 
-int32_t rv32i_decode::get_imm_s(uint32_t insn)
+size_t rv32i_decode::render(const decoded_insn &d, char *buf, size_t size)
 {
-    int32_t imm_s = (insn & 0xfe000000) >> (25-5);  // abcdefg
-    imm_s |= (insn & 0x00000f80) >> (7-0);          // uvwxy
+    if (size == 0)
+        return 0;
 
-    if (insn & 0x80000000)
-    {
-        imm_s |= 0xfffff000; // sign-extend the left
-    }
+    text_out out = { buf, buf + size - 1 };
 
-    return imm_s;
-}
-
-/**
- * get_imm_j() gets the imm_j value from the insn passed. 
- *
- * @param insn Instruction to be decoded. 
- *
- * @return Returns the 20 bits of the insn that represent imm_j.
- *         Sign extension for 11 bits.
- *
- ********************************************************************************/
-
-int32_t rv32i_decode::get_imm_j(uint32_t insn)
-{
-    int32_t imm_j = (insn & 0x000ff000);       // mnopqrst
-    imm_j |= (insn & 0x7fe00000) >> (21-1);    // bcdefghijk
-    imm_j |= (insn & 0x80000000) >> (31-20);   // a
-    imm_j |= (insn & 0x00100000) >> (20-11);   // l
-    
-    if (insn & 0x80000000)
+    switch (d.fmt)
     {
-        imm_j |= 0xffe00000;  // sign-extend the left
+        case rv32i_isa::fmt_none:
+            out.put(d.id == rv32i_isa::id_illegal ? "ERROR: UNIMPLEMENTED INSTRUCTION" : d.mnemonic);
+            break;
+
+        case rv32i_isa::fmt_u:
+            out.put_mnemonic(d.mnemonic, mnemonic_width);
+            out.put_reg(d.rd);
+            out.put(',');
+            out.put_hex(d.imm, 5);
+            break;
+
+        case rv32i_isa::fmt_j:
+            out.put_mnemonic(d.mnemonic, mnemonic_width);
+            out.put_reg(d.rd);
+            out.put(',');
+            out.put_hex(d.target, 8);
+            break;
+
+        case rv32i_isa::fmt_b:
+            out.put_mnemonic(d.mnemonic, mnemonic_width);
+            out.put_reg(d.rs1);
+            out.put(',');
+            out.put_reg(d.rs2);
+            out.put(',');
+            out.put_hex(d.target, 8);
+            break;
+
+        case rv32i_isa::fmt_jalr:
+        case rv32i_isa::fmt_load:
+            out.put_mnemonic(d.mnemonic, mnemonic_width);
+            out.put_reg(d.rd);
+            out.put(',');
+            out.put_base_disp(d.imm, d.rs1);
+            break;
+
+        case rv32i_isa::fmt_s:
+            out.put_mnemonic(d.mnemonic, mnemonic_width);
+            out.put_reg(d.rs2);
+            out.put(',');
+            out.put_base_disp(d.imm, d.rs1);
+            break;
+
+        case rv32i_isa::fmt_i:
+        case rv32i_isa::fmt_shift:
+            out.put_mnemonic(d.mnemonic, mnemonic_width);
+            out.put_reg(d.rd);
+            out.put(',');
+            out.put_reg(d.rs1);
+            out.put(',');
+            out.put_dec(d.imm);
+            break;
+
+        case rv32i_isa::fmt_r:
+            out.put_mnemonic(d.mnemonic, mnemonic_width);
+            out.put_reg(d.rd);
+            out.put(',');
+            out.put_reg(d.rs1);
+            out.put(',');
+            out.put_reg(d.rs2);
+            break;
+
+        case rv32i_isa::fmt_csr:
+            out.put_mnemonic(d.mnemonic, mnemonic_width);
+            out.put_reg(d.rd);
+            out.put(',');
+            out.put_hex(d.csr, 3);
+            out.put(',');
+            out.put_reg(d.rs1);
+            break;
+
+        case rv32i_isa::fmt_csri:
+            out.put_mnemonic(d.mnemonic, mnemonic_width);
+            out.put_reg(d.rd);
+            out.put(',');
+            out.put_hex(d.csr, 3);
+            out.put(',');
+            out.put_dec(d.imm);
+            break;
     }
 
-    return imm_j;
+    *out.p = '\0';
+    return out.p - buf;
 }
 
 /**
@@ -370,370 +313,30 @@ std::string rv32i_decode::render_illegal_insn()
 }
 
 /**
- * render_lui() renders info about the lui instruction.
- *
- * Uses get() functions to grab the necessary values to be 
- * able to print out the information, like the register and imm_u value.
- *
- * @param insn Instruction to be decoded. 
- *
- * @return Returns a string displaying the lui instruction information.
- *
- ********************************************************************************/
-
-std::string rv32i_decode::render_lui(uint32_t insn)
-{
-    uint32_t rd = get_rd(insn);
-    int32_t imm_u = get_imm_u(insn);
-
-    std::ostringstream os;
-    os << render_mnemonic("lui") << render_reg(rd) << ","
-       << to_hex0x20((imm_u >> 12)&0x0fffff);
-
-    return os.str();
-}
-
-/**
- * render_auipc() renders info about the auipc instruction.
- *
- * Uses get() functions to grab the necessary values to be 
- * able to print out the information, like the register and imm_u value.
- *
- * @param insn Instruction to be decoded. 
- *
- * @return Returns a string displaying the auipc instruction information.
- *
- ********************************************************************************/
-
-std::string rv32i_decode::render_auipc(uint32_t insn)
-{
-    uint32_t rd = get_rd(insn);
-    int32_t imm_u = get_imm_u(insn);
-
-    std::ostringstream os;
-    os << render_mnemonic("auipc") << render_reg(rd) << ","
-       << to_hex0x20((imm_u >> 12)&0x0fffff);
-
-    return os.str();
-}
-
-/**
- * render_jal() renders info about the jal instruction.
- *
- * Uses get() functions to grab the necessary values to be 
- * able to print out the information, like the register and imm_j value.
- *
- * @param addr Address of where the instruction is in the mem vector.
- * @param insn Instruction to be decoded. 
- *
- * @return Returns a string displaying the jal instruction information.
- *
- ********************************************************************************/
-
-std::string rv32i_decode::render_jal(uint32_t addr, uint32_t insn)
-{
-    uint32_t rd = get_rd(insn);
-    int32_t imm_j = get_imm_j(insn);
-    imm_j += addr;
-
-    std::ostringstream os;
-    os << render_mnemonic("jal") << render_reg(rd) << ","
-       << to_hex0x32(imm_j);
-
-    return os.str();
-}
-
-/**
- * render_jalr() renders info about the jalr instruction.
- *
- * Uses get() functions to grab the necessary values to be 
- * able to print out the information, like the register and
- * the base-displacement formatted value.
- *
- * @param insn Instruction to be decoded. 
- *
- * @return Returns a string displaying the jalr instruction information.
- *
- ********************************************************************************/
-
-std::string rv32i_decode::render_jalr(uint32_t insn)
-{
-    uint32_t rd = get_rd(insn);
-    uint32_t imm_i = get_imm_i(insn);
-    uint32_t rs1 = get_rs1(insn);
-
-    std::ostringstream os;
-    os << render_mnemonic("jalr") << render_reg(rd) << "," 
-       << render_base_disp(imm_i, rs1);
-
-    return os.str();
-}
-
-/**
- * render_itype_alu() renders info about the I-Type / alu instructions.
- *
- * Uses get() functions to grab the necessary values to be 
- * able to print out the information, like the registers and imm_i value.
- * Renders the mnemonic passed, due to the encompassing nature of this function.
- *
- * @param *mnemonic Char[] value of the instruction.
- * @param insn Instruction to be decoded. 
- * @param imm_i The value of the imm_i bits of the I-Type instruction. 
- *
- * @return Returns a string displaying the I_Type / alu instruction information.
- *
- ********************************************************************************/
-
-std::string rv32i_decode::render_itype_alu(uint32_t insn, const char *mnemonic, int32_t imm_i)
-{
-    uint32_t rd = get_rd(insn);
-    uint32_t rs1 = get_rs1(insn);
-
-    std::ostringstream os;
-    os << render_mnemonic(mnemonic) << render_reg(rd) << ","
-       << render_reg(rs1) << "," << imm_i;
-
-    return os.str();
-}
-
-/**
- * render_itype_load() renders info about the I-Type / load instructions.
- *
- * Uses get() functions to grab the necessary values to be 
- * able to print out the information, like the registers and imm_i value
- * to render the base-displacement format.
- *
- * @param *mnemonic Char[] value of the instruction.
- * @param insn Instruction to be decoded. 
- *
- * @return Returns a string displaying the I-Type / load instruction information.
- *
- ********************************************************************************/
-
-std::string rv32i_decode::render_itype_load(uint32_t insn, const char *mnemonic)
-{
-    uint32_t rd = get_rd(insn);
-    uint32_t imm_i = get_imm_i(insn);
-    uint32_t rs1 = get_rs1(insn);
-
-    std::ostringstream os;
-    os << render_mnemonic(mnemonic) << render_reg(rd) << ","
-       << render_base_disp(imm_i, rs1);
-
-    return os.str();
-}
-
-/**
- * render_stype() renders info about the S-Type instructions.
- *
- * Uses get() functions to grab the necessary values to be 
- * able to print out the information, like the register value
- * of rs2, and rs1 and imm_s value to render the base-displacement format.
- *
- * @param *mnemonic Char[] value of the instruction.
- * @param insn Instruction to be decoded. 
- *
- * @return Returns a string displaying the S-Type instruction information.
- *
- ********************************************************************************/
-
-std::string rv32i_decode::render_stype(uint32_t insn, const char *mnemonic)
-{
-    uint32_t imm_s = get_imm_s(insn);
-    uint32_t rs1 = get_rs1(insn);
-    uint32_t rs2 = get_rs2(insn);
-
-    std::ostringstream os;
-    os << render_mnemonic(mnemonic) << render_reg(rs2) << ","
-       << render_base_disp(imm_s, rs1);
-
-    return os.str();
-}
-
-/**
- * render_btype() renders info about the B-Type instructions.
- *
- * Uses get() functions to grab the necessary values to be 
- * able to print out the information, like the register values
- * of rs1 and rs2, and the pcrel_13 value to render the address of
- * the next instruction.
- *
- * @param *mnemonic Char[] value of the instruction.
- * @param insn Instruction to be decoded.
- * @param addr Address of the instruction.
- *
- * @return Returns a string displaying the B-Type instruction information.
- *
- ********************************************************************************/
-
-std::string rv32i_decode::render_btype(uint32_t addr, uint32_t insn, const char *mnemonic)
-{
-    uint32_t pcrel_13 = get_imm_b(insn);
-    uint32_t rs1 = get_rs1(insn);
-    uint32_t rs2 = get_rs2(insn);
-
-    int32_t pcrel_signed = pcrel_13;
- 
-    std::ostringstream os;
-    os << render_mnemonic(mnemonic) << render_reg(rs1) << ","
-       << render_reg(rs2) << "," << to_hex0x32(addr+pcrel_signed);
-
-    return os.str();
-}
-
-/**
- * render_rtype() renders info about the R-Type instructions.
- *
- * Uses get() functions to grab the necessary values to be 
- * able to print out the information, like the register values
- * of rs1, rs2, and the rd value to render them.
- *
- * @param *mnemonic Char[] value of the instruction.
- * @param insn Instruction to be decoded.
- *
- * @return Returns a string displaying the R-Type instruction information.
- *
- ********************************************************************************/
-
-std::string rv32i_decode::render_rtype(uint32_t insn, const char *mnemonic)
-{
-    uint32_t rd = get_rd(insn);
-    uint32_t rs1 = get_rs1(insn);
-    uint32_t rs2 = get_rs2(insn);
-
-    std::ostringstream os;
-    os << render_mnemonic(mnemonic) << render_reg(rd) << "," 
-       << render_reg(rs1) << "," << render_reg(rs2);
-
-    return os.str();
-}
-
-/**
- * render_csrrx() renders info about the Csrrx-Type instructions.
- *
- * Uses get() functions to grab the necessary values to be 
- * able to print out the information, like the register values
- * of rs1, rd, and the imm_i value to render the 3 byte value.
- *
- * @param *mnemonic Char[] value of the instruction.
- * @param insn Instruction to be decoded.
- *
- * @return Returns a string displaying the Csrrx-Type instruction information.
- *
- ********************************************************************************/
-
-std::string rv32i_decode::render_csrrx(uint32_t insn, const char *mnemonic)
-{
-    uint32_t imm_i = get_imm_i(insn);
-    uint32_t rd = get_rd(insn);
-    uint32_t rs1 = get_rs1(insn);
-
-    std::ostringstream os;
-    os << render_mnemonic(mnemonic) << render_reg(rd) << "," 
-       << to_hex0x12((imm_i&0xfff)) << "," << render_reg(rs1);
-
-    return os.str();
-}
-
-/**
- * render_csrrxi() renders info about the Csrrxi-Type instructions.
- *
- * Uses get() functions to grab the necessary values to be 
- * able to print out the information, like the register values
- * of rs1 / zimm, rd, and the imm_i value to render the 3 byte value.
- *
- * @param *mnemonic Char[] value of the instruction.
- * @param insn Instruction to be decoded.
- *
- * @return Returns a string displaying the Csrrxi-Type instruction information.
- *
- ********************************************************************************/
-
-std::string rv32i_decode::render_csrrxi(uint32_t insn, const char *mnemonic)
-{
-    uint32_t imm_i = get_imm_i(insn);
-    uint32_t rd = get_rd(insn);
-    uint32_t zimm = get_rs1(insn);
-
-    std::ostringstream os;
-    os << render_mnemonic(mnemonic) << render_reg(rd) << "," 
-       << to_hex0x12((imm_i&0xfff)) << "," << zimm;
-    return os.str();
-}
-
-/**
- * render_base_disp() renders the base-displacement formatted values. 
- *
- * Renders the base register value as well as the displacement register. 
- *
- * @param base Base register.
- * @param disp Displacement register.
- *
- * @return Returns a string displaying the base displacement format.
- *
- ********************************************************************************/
-
-std::string rv32i_decode::render_base_disp(uint32_t base, int32_t disp)
-{
-    int32_t signedBase = base;
-
-    std::stringstream ss;
-    ss << signedBase << '(' << render_reg(disp) << ')';
-    std::string str = ss.str();
-    return str;
-}
-
-/**
- * render_ebreak() renders the value "ebreak". 
- *
- * @return Returns "ebreak".
- *
- ********************************************************************************/
-
-std::string rv32i_decode::render_ebreak()
-{
-    return "ebreak";
-}
-
-/**
- * render_ecall() renders the value "ecall". 
- *
- * @return Returns "ecall".
- *
- ********************************************************************************/
-
-std::string rv32i_decode::render_ecall()
-{
-    return "ecall";
-}
-
-/**
- * render_mnemonic() formats the mnemonic passed in.
+ * render_reg() formats the integer value of a register to a string.
  *
- * @return Returns the left-aligned mnemonic, formatted by 
- *         setw() using mnemonic_width, as a string.
+ * @return Returns the string value of 'x' followed by the register value.
  *
  ********************************************************************************/
 
-std::string rv32i_decode::render_mnemonic(const std::string &m)
+std::string rv32i_decode::render_reg(int r)
 {
     std::stringstream ss;
-    ss << std::setw(mnemonic_width) << std::left << m;
+    ss << 'x' << r;
     std::string str = ss.str();
     return str;
 }
 
 /**
- * render_reg() formats the integer value of a register to a string.
- *
- * @return Returns the string value of 'x' followed by the register value.
+ * operator<<() streams a register name, as render_reg() would format it,
+ * without allocating.
  *
  ********************************************************************************/
 
-std::string rv32i_decode::render_reg(int r)
+std::ostream &operator<<(std::ostream &os, const rv32i_decode::reg_name &r)
 {
-    std::stringstream ss;
-    ss << 'x' << r;
-    std::string str = ss.str();
-    return str;
+    os.put('x');
+    if (r.r >= 10)
+        os.put(char('0' + r.r / 10));
+    return os.put(char('0' + r.r % 10));
 }
@@ -9,15 +9,41 @@
 #define H_RV32I_DECODE
 
 #include "hex.h"
+#include "rv32i_isa.h"
 #include <cassert>
 
 class rv32i_decode : public hex
 {
 public:
+    /// An instruction split into its fields. Unused fields are 0.
+    struct decoded_insn
+    {
+        rv32i_isa::insn_id id;
+        rv32i_isa::insn_format fmt;
+        const char *mnemonic;
+        uint32_t rd;
+        uint32_t rs1;
+        uint32_t rs2;
+        int32_t imm;        ///< imm20, imm12, displacement, shamt, zimm
+        uint32_t csr;
+        uint32_t target;    ///< Branch or jal destination.
+    };
+
+    /// Longest render() output, including the terminating NUL.
+    static constexpr size_t render_size = 48;
 
     ///@parm addr The memory address where the insn is stored.
     static std::string decode(uint32_t addr, uint32_t insn);
 
+    ///@parm addr The memory address where the insn is stored.
+    static decoded_insn decode_insn(uint32_t addr, uint32_t insn);
+
+    static size_t render(const decoded_insn &d, char *buf, size_t size);
+
+    /// Streams a register name ("x10") without building a string.
+    struct reg_name { uint32_t r; };
+    static reg_name reg(uint32_t r) { return { r }; }
+
 protected:
     static constexpr int mnemonic_width             = 8;
 
@@ -64,6 +90,17 @@ protected:
     static constexpr uint32_t funct7_add            = 0b0000000;
     static constexpr uint32_t funct7_sub            = 0b0100000;
 
+    static constexpr uint32_t funct7_muldiv         = 0b0000001;
+
+    static constexpr uint32_t funct3_mul            = 0b000;
+    static constexpr uint32_t funct3_mulh           = 0b001;
+    static constexpr uint32_t funct3_mulhsu         = 0b010;
+    static constexpr uint32_t funct3_mulhu          = 0b011;
+    static constexpr uint32_t funct3_div            = 0b100;
+    static constexpr uint32_t funct3_divu           = 0b101;
+    static constexpr uint32_t funct3_rem            = 0b110;
+    static constexpr uint32_t funct3_remu           = 0b111;
+
     static constexpr uint32_t insn_ecall            = 0x00000073;
     static constexpr uint32_t insn_ebreak           = 0x00100073;
 
@@ -75,44 +112,24 @@ protected:
     static constexpr uint32_t funct3_csrrsi         = 0b110;
     static constexpr uint32_t funct3_csrrci         = 0b111;
 
-    static uint32_t get_opcode(uint32_t insn);
-    static uint32_t get_rd(uint32_t insn);
-    static uint32_t get_funct3(uint32_t insn);
-    static uint32_t get_rs1(uint32_t insn);
-    static uint32_t get_rs2(uint32_t insn);
-    static uint32_t get_funct7(uint32_t insn);
-    static int32_t get_imm_i(uint32_t insn);
-    static int32_t get_imm_u(uint32_t insn);
-    static int32_t get_imm_b(uint32_t insn);
-    static int32_t get_imm_s(uint32_t insn);
-    static int32_t get_imm_j(uint32_t insn);
+    static constexpr uint32_t get_opcode(uint32_t insn) { return rv32i_isa::get_opcode(insn); }
+    static constexpr uint32_t get_rd(uint32_t insn) { return rv32i_isa::get_rd(insn); }
+    static constexpr uint32_t get_funct3(uint32_t insn) { return rv32i_isa::get_funct3(insn); }
+    static constexpr uint32_t get_rs1(uint32_t insn) { return rv32i_isa::get_rs1(insn); }
+    static constexpr uint32_t get_rs2(uint32_t insn) { return rv32i_isa::get_rs2(insn); }
+    static constexpr uint32_t get_funct7(uint32_t insn) { return rv32i_isa::get_funct7(insn); }
+    static constexpr int32_t get_imm_i(uint32_t insn) { return rv32i_isa::get_imm_i(insn); }
+    static constexpr int32_t get_imm_u(uint32_t insn) { return rv32i_isa::get_imm_u(insn); }
+    static constexpr int32_t get_imm_b(uint32_t insn) { return rv32i_isa::get_imm_b(insn); }
+    static constexpr int32_t get_imm_s(uint32_t insn) { return rv32i_isa::get_imm_s(insn); }
+    static constexpr int32_t get_imm_j(uint32_t insn) { return rv32i_isa::get_imm_j(insn); }
 
     static constexpr uint32_t XLEN = 32;
 
     static std::string render_illegal_insn();
-    static std::string render_lui(uint32_t insn);
-    static std::string render_auipc(uint32_t insn);
-
-    ///@parm addr The memory address where the insn is stored.
-    static std::string render_jal(uint32_t addr, uint32_t insn);
-
-    static std::string render_jalr(uint32_t insn);
-
-    ///@parm addr The memory address where the insn is stored.
-    static std::string render_btype(uint32_t addr, uint32_t insn, const char *mnemonic);
-
-    static std::string render_itype_load(uint32_t insn, const char *mnemonic);
-    static std::string render_stype(uint32_t insn, const char *mnemonic);
-    static std::string render_itype_alu(uint32_t insn, const char *mnemonic, int32_t imm_i);
-    static std::string render_rtype(uint32_t insn, const char *mnemonic);
-    static std::string render_ecall();
-    static std::string render_ebreak();
-    static std::string render_csrrx(uint32_t insn, const char *mnemonic);
-    static std::string render_csrrxi(uint32_t insn, const char *mnemonic);
-
     static std::string render_reg(int r);
-    static std::string render_base_disp(uint32_t base, int32_t disp);
-    static std::string render_mnemonic(const std::string &m);
 };
 
+std::ostream &operator<<(std::ostream &os, const rv32i_decode::reg_name &r);
+
 #endif
@@ -0,0 +1,387 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#include "fuzz_harness.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <set>
+#include <sstream>
+#include <unistd.h>
+
+/**
+ * rv32i_fuzz.cpp fuzzes a guest program in process with fuzz_harness.
+ *
+ * Built by make it is rv32i-fuzz, which replays inputs or runs a simple
+ * coverage-guided mutation loop. Built with clang's -fsanitize=fuzzer
+ * and -DRV32I_LIBFUZZER, LLVMFuzzerTestOneInput() is the libFuzzer entry
+ * point: it is configured from RV32I_FUZZ_* environment variables, and
+ * the guest's edge counters are handed to libFuzzer as its coverage.
+ *
+ ********************************************************************************/
+
+/// What the harness is set up with, from options or the environment.
+struct fuzz_settings
+{
+    std::string image;
+    uint32_t mem_size = { 0x10000 };
+    bool rvc = { false };
+    std::string snapshot_pc;            ///< Hex, empty for the entry point.
+    std::string input;                  ///< Hex addr[:len], empty for after the image.
+    uint64_t limit = { 100000 };
+};
+
+static fuzz_harness *harness = nullptr;
+
+/**
+ * start_harness() makes the harness and takes its snapshot.
+ *
+ * @return false, with a message on std::cerr, if it cannot.
+ *
+ ********************************************************************************/
+
+static bool start_harness(const fuzz_settings &cfg)
+{
+    harness = new fuzz_harness(cfg.mem_size, cfg.rvc);     // lives until exit
+    harness->set_limit(cfg.limit);
+
+    if (!cfg.snapshot_pc.empty())
+    {
+        uint32_t pc;
+        std::istringstream iss(cfg.snapshot_pc);
+        if (!(iss >> std::hex >> pc))
+        {
+            std::cerr << "bad snapshot pc '" << cfg.snapshot_pc << "'" << std::endl;
+            return false;
+        }
+        harness->set_snapshot_pc(pc);
+    }
+
+    if (!cfg.input.empty())
+    {
+        uint32_t addr;
+        uint32_t len = 0x1000;
+        char colon;
+        std::istringstream iss(cfg.input);
+        if (!(iss >> std::hex >> addr) || ((iss >> colon) && (colon != ':' || !(iss >> std::hex >> len))))
+        {
+            std::cerr << "bad input buffer '" << cfg.input << "', expected addr[:len]" << std::endl;
+            return false;
+        }
+        harness->set_input(addr, len);
+    }
+
+    return harness->start(cfg.image);
+}
+
+#ifdef RV32I_LIBFUZZER
+extern "C" void __sanitizer_cov_8bit_counters_init(uint8_t *start, uint8_t *stop);
+#endif
+
+/**
+ * LLVMFuzzerInitialize() sets up the harness from the environment:
+ * RV32I_FUZZ_IMAGE (required), RV32I_FUZZ_MEM (hex), RV32I_FUZZ_RVC,
+ * RV32I_FUZZ_SNAPSHOT (hex pc), RV32I_FUZZ_INPUT (hex addr[:len]) and
+ * RV32I_FUZZ_LIMIT (instructions per input).
+ *
+ ********************************************************************************/
+
+extern "C" int LLVMFuzzerInitialize(int *, char ***)
+{
+    fuzz_settings cfg;
+    const char *v;
+
+    if ((v = getenv("RV32I_FUZZ_IMAGE")) == nullptr)
+    {
+        std::cerr << "RV32I_FUZZ_IMAGE must name the program to fuzz." << std::endl;
+        exit(1);
+    }
+    cfg.image = v;
+    if ((v = getenv("RV32I_FUZZ_MEM")) != nullptr)
+        cfg.mem_size = std::strtoul(v, nullptr, 16);
+    cfg.rvc = getenv("RV32I_FUZZ_RVC") != nullptr;
+    if ((v = getenv("RV32I_FUZZ_SNAPSHOT")) != nullptr)
+        cfg.snapshot_pc = v;
+    if ((v = getenv("RV32I_FUZZ_INPUT")) != nullptr)
+        cfg.input = v;
+    if ((v = getenv("RV32I_FUZZ_LIMIT")) != nullptr)
+        cfg.limit = std::strtoull(v, nullptr, 10);
+
+    if (!start_harness(cfg))
+        exit(1);
+
+#ifdef RV32I_LIBFUZZER
+    __sanitizer_cov_8bit_counters_init(harness->get_coverage(), harness->get_coverage() + fuzz_harness::coverage_size);
+#endif
+    return 0;
+}
+
+/**
+ * LLVMFuzzerTestOneInput() runs the guest on one input and aborts, as
+ * libFuzzer expects of a crash, if the guest crashes.
+ *
+ ********************************************************************************/
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    if (harness->run(data, size) == fuzz_harness::crashed)
+    {
+        std::cerr << "Guest crashed. Reason: " << harness->get_halt_reason() << std::endl;
+        abort();
+    }
+    return 0;
+}
+
+#ifndef RV32I_LIBFUZZER
+
+/**
+ * usage() tells the user how to run rv32i-fuzz.
+ *
+ ********************************************************************************/
+
+static void usage()
+{
+    std::cerr << "Usage: rv32i-fuzz [-c] [-e hex-pc] [-i hex-addr[:hex-len]] [-l limit] [-m hex-mem-size] [-n execs] [-S seed] infile [input ...]" << std::endl;
+    std::cerr << "    -c enable the RV32C compressed instruction extension" << std::endl;
+    std::cerr << "    -e take the snapshot when the program first reaches pc, within the -l limit" << std::endl;
+    std::cerr << "       (default = entry)" << std::endl;
+    std::cerr << "    -i the guest buffer the input is copied to (default = 4 KiB after the image)" << std::endl;
+    std::cerr << "    -l maximum number of instructions per input (default = 100000)" << std::endl;
+    std::cerr << "    -m specify memory size (default = 0x10000)" << std::endl;
+    std::cerr << "    -n mutate the inputs for execs runs, keeping those that reach new edges" << std::endl;
+    std::cerr << "       and saving those that crash in a new way as crash-N; without -n each input" << std::endl;
+    std::cerr << "       runs once" << std::endl;
+    std::cerr << "    -S seed the mutations (default = 1)" << std::endl;
+    exit(1);
+}
+
+static uint32_t count_edges(const uint8_t *map)
+{
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < fuzz_harness::coverage_size; ++i)
+        n += map[i] != 0;
+    return n;
+}
+
+/**
+ * add_coverage() merges map into seen. A run reaches few edges, so the
+ * map is skipped eight counters at a time while they are all zero.
+ *
+ * @return true if map reached an edge seen had not.
+ *
+ ********************************************************************************/
+
+static bool add_coverage(const uint8_t *map, std::vector<uint8_t> &seen)
+{
+    bool fresh = false;
+    for (uint32_t i = 0; i < fuzz_harness::coverage_size; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        std::memcpy(&word, map + i, sizeof(word));
+        if (word == 0)
+            continue;
+
+        for (uint32_t j = i; j < i + sizeof(uint64_t); ++j)
+        {
+            if (map[j] && !seen[j])
+            {
+                seen[j] = 1;
+                fresh = true;
+            }
+        }
+    }
+    return fresh;
+}
+
+/**
+ * mutate() applies one to four random byte flips, replacements,
+ * insertions or deletions to in, keeping it at most max_len long.
+ *
+ ********************************************************************************/
+
+static void mutate(std::vector<uint8_t> &in, std::mt19937 &rng, uint32_t max_len)
+{
+    static const uint8_t special[] = { 0x00, 0x01, 0x7f, 0x80, 0xff };
+
+    for (uint32_t count = 1 + rng() % 4; count > 0; --count)
+    {
+        switch (in.empty() ? 2 : rng() % 5)
+        {
+        case 0: in[rng() % in.size()] ^= 1 << (rng() % 8); break;
+        case 1: in[rng() % in.size()] = rng(); break;
+        case 2:
+            if (in.size() < max_len)
+                in.insert(in.begin() + rng() % (in.size() + 1), uint8_t(rng()));
+            break;
+        case 3: in.erase(in.begin() + rng() % in.size()); break;
+        default: in[rng() % in.size()] = special[rng() % sizeof(special)]; break;
+        }
+    }
+}
+
+/**
+ * crash_kind() is the halt reason without the address an access fault
+ * names, which changes with the input.
+ *
+ ********************************************************************************/
+
+static std::string crash_kind(const std::string &reason)
+{
+    return reason.substr(0, reason.find(" at 0x"));
+}
+
+static const char *outcome_name(fuzz_harness::outcome o)
+{
+    switch (o)
+    {
+    case fuzz_harness::finished: return "finished";
+    case fuzz_harness::timed_out: return "timed out";
+    default: return "crashed";
+    }
+}
+
+/**
+ * main() replays the inputs, or with -n fuzzes starting from them.
+ *
+ ********************************************************************************/
+
+int main(int argc, char **argv)
+{
+    fuzz_settings cfg;
+    uint64_t execs = 0;
+    uint32_t seed = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "ce:i:l:m:n:S:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'c':
+            cfg.rvc = true;
+            break;
+        case 'e':
+            cfg.snapshot_pc = optarg;
+            break;
+        case 'i':
+            cfg.input = optarg;
+            break;
+        case 'l':
+        {
+            std::istringstream iss(optarg);
+            iss >> cfg.limit;
+        }
+            break;
+        case 'm':
+        {
+            std::istringstream iss(optarg);
+            iss >> std::hex >> cfg.mem_size;
+        }
+            break;
+        case 'n':
+        {
+            std::istringstream iss(optarg);
+            iss >> execs;
+        }
+            break;
+        case 'S':
+        {
+            std::istringstream iss(optarg);
+            iss >> seed;
+        }
+            break;
+        default: /* '?' */
+            usage();
+        }
+    }
+
+    if (optind >= argc)
+        usage();
+    cfg.image = argv[optind++];
+    if (!start_harness(cfg))
+        return 1;
+
+    std::vector<std::vector<uint8_t>> corpus;
+    for (int i = optind; i < argc; ++i)
+    {
+        std::ifstream in(argv[i], std::ios::in|std::ios::binary);
+        if (!in.is_open())
+        {
+            std::cerr << "Can't open file '" << argv[i] << "' for reading.\n";
+            return 1;
+        }
+        corpus.emplace_back(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    if (execs == 0)
+    {
+        int status = 0;
+        for (size_t i = 0; i < corpus.size(); ++i)
+        {
+            fuzz_harness::outcome o = harness->run(corpus[i].data(), corpus[i].size());
+            std::cout << argv[optind + i] << ": " << outcome_name(o);
+            if (o != fuzz_harness::timed_out)
+                std::cout << " (" << harness->get_halt_reason() << ")";
+            std::cout << ", " << std::dec << harness->get_insns() << " instructions, "
+                      << count_edges(harness->get_coverage()) << " edges" << std::endl;
+            if (o == fuzz_harness::crashed)
+                status = 1;
+        }
+        return status;
+    }
+
+    if (corpus.empty())
+        corpus.push_back(std::vector<uint8_t>());
+
+    std::vector<uint8_t> seen(fuzz_harness::coverage_size);
+    for (const auto &in : corpus)
+    {
+        harness->run(in.data(), in.size());
+        add_coverage(harness->get_coverage(), seen);
+    }
+
+    std::mt19937 rng(seed);
+    uint32_t crashes = 0;
+    uint32_t saved = 0;
+    std::vector<uint8_t> crash_seen(fuzz_harness::coverage_size);     // edges reached by crashes
+    std::set<std::string> crash_kinds;
+    auto begin = std::chrono::steady_clock::now();
+    for (uint64_t n = 0; n < execs; ++n)
+    {
+        std::vector<uint8_t> in = corpus[rng() % corpus.size()];
+        mutate(in, rng, harness->get_input_len());
+
+        fuzz_harness::outcome o = harness->run(in.data(), in.size());
+        if (o == fuzz_harness::crashed)
+        {
+            ++crashes;
+            bool fresh = add_coverage(harness->get_coverage(), crash_seen);
+            if (crash_kinds.insert(crash_kind(harness->get_halt_reason())).second || fresh)
+            {
+                std::string name = "crash-" + std::to_string(saved++);
+                std::ofstream out(name, std::ios::out|std::ios::binary);
+                out.write(reinterpret_cast<const char*>(in.data()), in.size());
+                std::cout << name << ": " << harness->get_halt_reason() << std::endl;
+            }
+        }
+        else if (add_coverage(harness->get_coverage(), seen))
+        {
+            corpus.push_back(in);
+        }
+    }
+    std::chrono::duration<double> secs = std::chrono::steady_clock::now() - begin;
+
+    std::cout << std::dec << execs << " executions in " << secs.count() << " s ("
+              << uint64_t(execs / secs.count()) << "/s), " << count_edges(seen.data()) << " edges, "
+              << corpus.size() << " inputs kept, " << crashes << " crashes, " << saved << " saved" << std::endl;
+    return crashes != 0;
+}
+
+#endif
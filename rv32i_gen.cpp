@@ -0,0 +1,86 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#include "workload.h"
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+
+/**
+ * usage() tells the user how to pass arguments to the workload generator.
+ *
+ ********************************************************************************/
+
+static void usage()
+{
+	std::cerr << "Usage: rv32i-gen [-n size] [-t iterations] [-o outfile] " << workload::kinds() << std::endl;
+	std::cerr << "    -n workload size per iteration (default = 64)" << std::endl;
+	std::cerr << "        alu: instructions, chase: list nodes, memcpy/memset: bytes," << std::endl;
+	std::cerr << "        branch: conditional branches, call: calls" << std::endl;
+	std::cerr << "    -t number of iterations (default = 1000)" << std::endl;
+	std::cerr << "    -o output file (default = <workload>.bin)" << std::endl;
+	exit(1);
+}
+
+/**
+ * main() writes one synthetic RV32I workload image and prints the memory
+ * size needed to run it with rv32i.
+ *
+ ********************************************************************************/
+
+int main(int argc, char **argv)
+{
+	uint32_t size = 64;
+	uint32_t iterations = 1000;
+	std::string outfile;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:t:o:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n':
+		{
+			std::istringstream iss(optarg);
+			iss >> size;
+		}
+			break;
+		case 't':
+		{
+			std::istringstream iss(optarg);
+			iss >> iterations;
+		}
+			break;
+		case 'o':
+		{
+			outfile = optarg;
+		}
+			break;
+		default: /* '?' */
+			usage();
+		}
+	}
+
+	if (optind >= argc)
+		usage(); // missing workload name
+
+	std::string kind = argv[optind];
+	if (outfile.empty())
+		outfile = kind + ".bin";
+
+	workload w;
+	if (!w.generate(kind, size, iterations))
+		usage();
+
+	if (!w.save(outfile))
+		return 1;
+
+	std::cout << "Wrote " << std::dec << w.get_image_size() << " bytes to " << outfile
+			  << ", run with: rv32i -m" << std::hex << w.get_mem_size() << " " << outfile << std::endl;
+
+	return 0;
+}
@@ -6,6 +6,9 @@
 //******************************************************************
 
 #include "rv32i_hart.h"
+#include "rv32i_asm.h"
+#include "devices.h"
+#include "rv32i_cfg.h"
 
 void rv32i_hart::reset()
 {
@@ -15,27 +18,117 @@ void rv32i_hart::reset()
     insn_counter = 0;
     halt = false;
     halt_reason = "none";
+
+    mstatus = mie = mip = mtvec = mscratch = mepc = mcause = mtval = 0;
+    events.clear();
+    next_event = 0;
+    spin_break();
+}
+
+/**
+ * snapshot() takes a snapshot of the memory and saves the registers, pc,
+ * instruction count, CSRs and pending events with it.
+ *
+ ********************************************************************************/
+
+void rv32i_hart::snapshot()
+{
+    mem.snapshot();
+
+    saved.regs = regs;
+    saved.pc = pc;
+    saved.insn_counter = insn_counter;
+    saved.mstatus = mstatus;
+    saved.mie = mie;
+    saved.mip = mip;
+    saved.mtvec = mtvec;
+    saved.mscratch = mscratch;
+    saved.mepc = mepc;
+    saved.mcause = mcause;
+    saved.mtval = mtval;
+    saved.events = events;
+    saved.next_event = next_event;
+}
+
+/**
+ * reset_to_snapshot() restores the memory's pages written since the last
+ * snapshot() and the hart state saved with them, to run the same image
+ * again from there.
+ *
+ * @return false, having done nothing, if the memory has no snapshot.
+ *
+ ********************************************************************************/
+
+bool rv32i_hart::reset_to_snapshot()
+{
+    if (!mem.restore())
+        return false;
+
+    regs = saved.regs;
+    pc = saved.pc;
+    insn_counter = saved.insn_counter;
+    halt = false;
+    halt_reason = "none";
+
+    mstatus = saved.mstatus;
+    mie = saved.mie;
+    mip = saved.mip;
+    mtvec = saved.mtvec;
+    mscratch = saved.mscratch;
+    mepc = saved.mepc;
+    mcause = saved.mcause;
+    mtval = saved.mtval;
+    events = saved.events;
+    next_event = saved.next_event;
+    spin_break();
+    return true;
 }
 
 void rv32i_hart::dump(const std::string &hdr) const
 {
     regs.dump(hdr);
 
-    std::cout << " pc " << to_hex32(pc) << std::endl;
+    std::cout << " pc " << hex32(pc) << std::endl;
 }
 
 void rv32i_hart::tick(const std::string &hdr)
 {
-    if (pc % 4 != 0)
+    if (insn_counter >= next_event)
+    {
+        service_events();
+    }
+
+    if (pc % (rvc ? 2 : 4) != 0)
     {
         halt = true;
         halt_reason = "PC alignment error";  // Alignment error check
         return;
     }
 
+    if (hle_calls && hle_calls->is_bound(pc))
+    {
+        run_hle();
+        return;
+    }
+
+    if (fast_path && !show_instructions && exec_fast())
+    {
+        return;
+    }
+
     insn_counter++;
 
-    uint32_t getinsn = mem.get32(pc);  // Get the instruction from mem
+    uint32_t getinsn;
+
+    if (rvc)
+    {
+        getinsn = fetch_rvc();         // Get a 16 or 32 bit instruction from mem
+    }
+    else
+    {
+        getinsn = fetch32(pc);      // Get the instruction from mem
+        insn_size = 4;
+    }
 
     if (show_instructions == true && show_registers == true)
     {
@@ -47,7 +140,7 @@ void rv32i_hart::tick(const std::string &hdr)
         if (!halt)
         {
             regs.dump(hdr);
-            std::cout << " pc " << to_hex32(pc) << std::endl;
+            std::cout << " pc " << hex32(pc) << std::endl;
         }
     }
     else if (show_instructions == true)
@@ -61,118 +154,619 @@ void rv32i_hart::tick(const std::string &hdr)
     }
 }
 
+/**
+ * fetch_rvc() fetches the instruction at pc when the C extension is enabled.
+ *
+ * A 16-bit parcel whose two low bits are not 0b11 is a compressed
+ * instruction. It is expanded to the equivalent 32-bit instruction so
+ * that exec() can run it like any other, with insn_size set to 2 so that
+ * the pc and link values advance by the compressed length.
+ *
+ * Expanded forms are remembered in a small direct-mapped cache keyed by
+ * pc. An entry is only used if the parcel in memory still matches the
+ * one it was expanded from, so code that is rewritten is re-expanded.
+ *
+ * @return Returns the 32-bit instruction (or expansion) to execute.
+ *
+ ********************************************************************************/
+
+uint32_t rv32i_hart::fetch_rvc()
+{
+    uint16_t parcel = fetch16(pc);
+
+    if ((parcel & 0x3) == 0x3)
+    {
+        insn_size = 4;
+        return parcel | (fetch16(pc+2) << 16);
+    }
+
+    insn_size = 2;
+
+    rvc_entry &e = rvc_cache[(pc >> 1) & (rvc_cache_size-1)];
+    if (e.pc != pc || e.parcel != parcel)
+    {
+        e.pc = pc;
+        e.parcel = parcel;
+        e.insn = rv32i_asm::expand_compressed(parcel);
+    }
+
+    return e.insn;
+}
+
+/**
+ * exec() executes one instruction.
+ *
+ * The instruction is classified with rv32i_isa::lookup() and the exec
+ * function is chosen by a single switch on its id. All six CSR
+ * instructions go to exec_csr(). Instructions the hart does not
+ * implement are illegal.
+ *
+ ********************************************************************************/
+
 void rv32i_hart::exec(uint32_t insn, std::ostream* pos)
 {
-    switch(get_opcode(insn))
+    switch(rv32i_isa::lookup(insn).id)
     {
         default: exec_illegal_insn(pos); return;
-        case opcode_lui: exec_lui(insn, pos); return;
-        case opcode_auipc: exec_auipc(insn, pos); return;
-        case opcode_jal: exec_jal(insn, pos); return;
-        case opcode_jalr: exec_jalr(insn, pos); return;
+        case rv32i_isa::id_lui: exec_lui(insn, pos); return;
+        case rv32i_isa::id_auipc: exec_auipc(insn, pos); return;
+        case rv32i_isa::id_jal: exec_jal(insn, pos); return;
+        case rv32i_isa::id_jalr: exec_jalr(insn, pos); return;
+
+        case rv32i_isa::id_beq: exec_beq(insn, pos); return;
+        case rv32i_isa::id_bne: exec_bne(insn, pos); return;
+        case rv32i_isa::id_blt: exec_blt(insn, pos); return;
+        case rv32i_isa::id_bge: exec_bge(insn, pos); return;
+        case rv32i_isa::id_bltu: exec_bltu(insn, pos); return;
+        case rv32i_isa::id_bgeu: exec_bgeu(insn, pos); return;
+
+        case rv32i_isa::id_lb: exec_lb(insn, pos); return;
+        case rv32i_isa::id_lh: exec_lh(insn, pos); return;
+        case rv32i_isa::id_lw: exec_lw(insn, pos); return;
+        case rv32i_isa::id_lbu: exec_lbu(insn, pos); return;
+        case rv32i_isa::id_lhu: exec_lhu(insn, pos); return;
+
+        case rv32i_isa::id_sb: exec_sb(insn, pos); return;
+        case rv32i_isa::id_sh: exec_sh(insn, pos); return;
+        case rv32i_isa::id_sw: exec_sw(insn, pos); return;
+
+        case rv32i_isa::id_addi: exec_addi(insn, pos); return;
+        case rv32i_isa::id_slti: exec_slti(insn, pos); return;
+        case rv32i_isa::id_sltiu: exec_sltiu(insn, pos); return;
+        case rv32i_isa::id_xori: exec_xori(insn, pos); return;
+        case rv32i_isa::id_ori: exec_ori(insn, pos); return;
+        case rv32i_isa::id_andi: exec_andi(insn, pos); return;
+        case rv32i_isa::id_slli: exec_slli(insn, pos); return;
+        case rv32i_isa::id_srli: exec_srli(insn, pos); return;
+        case rv32i_isa::id_srai: exec_srai(insn, pos); return;
+
+        case rv32i_isa::id_add: exec_add(insn, pos); return;
+        case rv32i_isa::id_sub: exec_sub(insn, pos); return;
+        case rv32i_isa::id_sll: exec_sll(insn, pos); return;
+        case rv32i_isa::id_slt: exec_slt(insn, pos); return;
+        case rv32i_isa::id_sltu: exec_sltu(insn, pos); return;
+        case rv32i_isa::id_xor: exec_xor(insn, pos); return;
+        case rv32i_isa::id_srl: exec_srl(insn, pos); return;
+        case rv32i_isa::id_sra: exec_sra(insn, pos); return;
+        case rv32i_isa::id_or: exec_or(insn, pos); return;
+        case rv32i_isa::id_and: exec_and(insn, pos); return;
+
+        case rv32i_isa::id_mul: exec_mul(insn, pos); return;
+        case rv32i_isa::id_mulh: exec_mulh(insn, pos); return;
+        case rv32i_isa::id_mulhsu: exec_mulhsu(insn, pos); return;
+        case rv32i_isa::id_mulhu: exec_mulhu(insn, pos); return;
+        case rv32i_isa::id_div: exec_div(insn, pos); return;
+        case rv32i_isa::id_divu: exec_divu(insn, pos); return;
+        case rv32i_isa::id_rem: exec_rem(insn, pos); return;
+        case rv32i_isa::id_remu: exec_remu(insn, pos); return;
+
+        case rv32i_isa::id_ecall: exec_ecall(insn, pos); return;
+        case rv32i_isa::id_ebreak: exec_ebreak(insn, pos); return;
+        case rv32i_isa::id_mret: exec_mret(insn, pos); return;
+        case rv32i_isa::id_wfi: exec_wfi(insn, pos); return;
+
+        case rv32i_isa::id_csrrw:
+        case rv32i_isa::id_csrrs:
+        case rv32i_isa::id_csrrc:
+        case rv32i_isa::id_csrrwi:
+        case rv32i_isa::id_csrrsi:
+        case rv32i_isa::id_csrrci: exec_csr(insn, pos); return;
+    }
+}
 
-        case opcode_rtype:
-            switch(get_funct3(insn))
-            {
-                default: exec_illegal_insn(pos); return;
-
-                case funct3_add:
-                    switch(get_funct7(insn))
-                    {
-                        default: exec_illegal_insn(pos); return;
-                        case funct7_add: exec_add(insn, pos); return;
-                        case funct7_sub: exec_sub(insn, pos); return;
-                    }
-
-                case funct3_sll: exec_sll(insn, pos); return;
-                case funct3_slt: exec_slt(insn, pos); return;
-                case funct3_sltu: exec_sltu(insn, pos); return;
-                case funct3_xor: exec_xor(insn, pos); return;
-
-                case funct3_srx:
-                    switch(get_funct7(insn))
-                    {
-                        default: exec_illegal_insn(pos); return;
-                        case funct7_srl: exec_srl(insn, pos); return;
-                        case funct7_sra: exec_sra(insn, pos); return;
-                    }
-
-                case funct3_or: exec_or(insn, pos); return;
-                case funct3_and: exec_and(insn, pos); return;
-            }
+/**
+ * exec_fast() runs instructions from their predecoded uops, starting at
+ * pc.
+ *
+ * uops are kept in a direct-mapped cache indexed by pc. The words each
+ * uop is built from are marked as code in memory, and the uop is only
+ * used while their code generation is unchanged, so code that is
+ * rewritten is predecoded again. A fused pair is only run as one uop
+ * if retiring both instructions does not pass the next event or the
+ * instruction limit; otherwise its first instruction is run alone.
+ *
+ * With chaining on, uops are run one after another without going back
+ * through tick(), across branches, calls and returns alike, since the
+ * uop for any target pc is found the same way. The chain stops at the
+ * next event or the instruction limit, on a halt, at a misaligned pc or
+ * a bound HLE address, and after any instruction that had to go through
+ * exec(), so that tick() sees the state after it.
+ *
+ * @return false if pc is too close to the end of memory for the fast
+ *         path, in which case tick() runs the instruction as usual.
+ *
+ ********************************************************************************/
+
+bool rv32i_hart::exec_fast()
+{
+    if (uint64_t(pc) + 4 > mem.get_size())
+    {
+        spin_break();
+        return false;
+    }
 
-        case opcode_btype:
-            switch (get_funct3(insn))
-            {
-                default: exec_illegal_insn(pos); return;
-                case funct3_beq: exec_beq(insn, pos); return;
-                case funct3_bne: exec_bne(insn, pos); return;
-                case funct3_blt: exec_blt(insn, pos); return;
-                case funct3_bge: exec_bge(insn, pos); return;
-                case funct3_bltu: exec_bltu(insn, pos); return;
-                case funct3_bgeu: exec_bgeu(insn, pos); return;
-            }
+    uint32_t align = rvc ? 1 : 3;
+    bool more;
 
-        case opcode_system:
-            switch(get_funct3(insn))
-            {
-                default: exec_illegal_insn(pos); return;
+    do
+    {
+        rv32i_predecode::uop &u = uop_cache[(pc >> 1) & (uop_cache_size-1)];
+        if (u.pc != pc || u.gen != mem.get_code_gen(pc, u.size + u.size2))
+        {
+            fill_uop(u, pc);
+        }
 
-                case funct3_csrrs: exec_csrrs(insn, pos); return;
+        uint32_t from = pc;
+        uint64_t horizon = next_event < insn_limit ? next_event : insn_limit;
+        if (u.size2 && fusion && insn_counter + 2 <= horizon)
+        {
+            insn_counter += 2;
+            exec_fused(u);
+            more = true;
+        }
+        else
+        {
+            insn_counter++;
+            insn_size = u.size;
+            more = exec_uop(u);
+        }
 
-                case funct3_e:
-                    switch(get_imm_i(insn))
-                    {
-                        default: exec_illegal_insn(pos); return;
-                        case 1: return exec_ebreak(insn, pos); return;
-                        case 0: return exec_ecall(pos); return;
-                    }
-            }
+        if (pc <= from && fast_forward && !run_idiom(from))
+        {
+            check_spin();
+        }
 
-        case opcode_stype:
-            switch(get_funct3(insn))
-            {
-                default: exec_illegal_insn(pos); return;
-                case funct3_sb: exec_sb(insn, pos); return;
-                case funct3_sh: exec_sh(insn, pos); return;
-                case funct3_sw: exec_sw(insn, pos); return;
-            }
+        more = more && chaining && !halt
+            && insn_counter < next_event && insn_counter < insn_limit
+            && (pc & align) == 0 && uint64_t(pc) + 4 <= mem.get_size()
+            && !(hle_calls && hle_calls->is_bound(pc));
+    }
+    while (more);
 
-        case opcode_alu_imm:
-            switch (get_funct3(insn))
-            {
-                default: exec_illegal_insn(pos); return;
-                case funct3_add: exec_addi(insn, pos); return;
-                case funct3_sll: exec_slli(insn, pos); return;
-                case funct3_slt: exec_slti(insn, pos); return;
-                case funct3_sltu: exec_sltiu(insn, pos); return;
-                case funct3_xor: exec_xori(insn, pos); return;
-                case funct3_or: exec_ori(insn, pos); return;
-                case funct3_and: exec_andi(insn, pos); return;
-
-                case funct3_srx:
-                    switch(get_funct7(insn))
-                    {
-                        default: exec_illegal_insn(pos); return;
-                        case funct7_sra: exec_srai(insn, pos); return;
-                        case funct7_srl: exec_srli(insn, pos); return;
-                    }
-            }
+    return true;
+}
+
+/**
+ * fill_uop() predecodes the instruction at "at" into u and marks its
+ * words as code, so that u is dropped if they are written.
+ *
+ ********************************************************************************/
+
+void rv32i_hart::fill_uop(rv32i_predecode::uop &u, uint32_t at)
+{
+    u = rv32i_predecode::predecode(mem, at, rvc);
+    mem.mark_code(at, u.size + u.size2);
+    u.gen = mem.get_code_gen(at, u.size + u.size2);
+}
+
+/**
+ * pretranslate() fills the uop cache with the instructions of every block
+ * of cfg, so that the fast path starts out with its code predecoded.
+ * Blocks that map to the same entries replace each other; whichever is
+ * missing is predecoded when it runs, as usual.
+ *
+ ********************************************************************************/
+
+void rv32i_hart::pretranslate(const rv32i_cfg &cfg)
+{
+    for (const auto &e : cfg.get_blocks())
+    {
+        for (const rv32i_cfg::insn &i : e.second.code)
+        {
+            if (uint64_t(i.pc) + 4 <= mem.get_size())
+                fill_uop(uop_cache[(i.pc >> 1) & (uop_cache_size-1)], i.pc);
+        }
+    }
+}
+
+/**
+ * run_idiom() is called after a jump or branch backwards, and if it
+ * closed a copy or fill loop, runs the rest of the loop at once.
+ *
+ * The number of iterations left is worked out from the branch operands
+ * and their steps. As many of them as fit before the next event and the
+ * instruction limit are carried out with one memory::copy() or fill(),
+ * and the registers, instruction count and pc are left as if each
+ * iteration had run. Overlapping copies, stores over the loop's own
+ * code and anything memory::copy() or fill() turns down are left to run
+ * normally.
+ *
+ * @param from The address of the branch.
+ *
+ * @return true if any iterations were run.
+ *
+ ********************************************************************************/
+
+bool rv32i_hart::run_idiom(uint32_t from)
+{
+    rv32i_idiom::loop &l = idiom_cache[(from >> 1) & (idiom_cache_size-1)];
+    if (l.branch_pc != from || l.head != pc || (l.kind != rv32i_idiom::none && l.gen != mem.get_code_gen(l.head, l.size())))
+    {
+        l = rv32i_idiom::recognize(mem, pc, from, rvc);
+        if (l.kind != rv32i_idiom::none)
+        {
+            mem.mark_code(l.head, l.size());
+            l.gen = mem.get_code_gen(l.head, l.size());
+        }
+    }
+
+    if (l.kind == rv32i_idiom::none)
+    {
+        return false;
+    }
+
+    uint32_t a = regs.get(l.a);
+    uint32_t b = regs.get(l.b);
+    int64_t sa = l.step_of(l.a);
+    int64_t sb = l.step_of(l.b);
+    uint64_t left;                      // iterations until the branch falls through
+
+    switch (l.branch_op)
+    {
+        case rv32i_isa::id_bne:
+        {
+            int64_t delta = sa - sb;
+            uint32_t gap = delta > 0 ? b - a : a - b;
+            uint64_t m = delta > 0 ? delta : -delta;
+            if (m == 0 || gap == 0 || gap % m != 0)
+                return false;
+            left = gap / m;
+            break;
+        }
+
+        case rv32i_isa::id_bltu:
+            if (sb != 0 || sa <= 0 || a >= b)
+                return false;
+            left = (uint64_t(b) - a + sa - 1) / sa;
+            if (a + left * sa > 0xffffffff)
+                return false;
+            break;
+
+        default:                        // blt
+            if (sb != 0 || sa <= 0 || int32_t(a) >= int32_t(b))
+                return false;
+            left = (int64_t(int32_t(b)) - int32_t(a) + sa - 1) / sa;
+            if (int32_t(a) + int64_t(left) * sa > 0x7fffffff)
+                return false;
+            break;
+    }
+
+    uint64_t horizon = next_event < insn_limit ? next_event : insn_limit;
+    if (horizon <= insn_counter)
+    {
+        return false;
+    }
+    uint64_t fit = (horizon - insn_counter) / l.count;
+    uint64_t n = left < fit ? left : fit;
+    if (n == 0 || n * l.width > mem.get_size())
+    {
+        return false;
+    }
+
+    uint32_t w = l.width;
+    uint32_t len = n * w;
+    bool down = l.step_of(l.dst) < 0;
+    uint32_t dst = regs.get(l.dst) + l.dst_off;
+    uint32_t dst_lo = down ? dst - (len - w) : dst;
+    if (uint64_t(dst_lo) + len != uint64_t(dst) + (down ? w : len))
+    {
+        return false;                   // wraps around the address space
+    }
+    if (uint64_t(dst_lo) + len > l.head && uint64_t(l.head) + l.size() > dst_lo)
+    {
+        return false;                   // stores over the loop itself
+    }
+
+    if (l.kind == rv32i_idiom::copy)
+    {
+        uint32_t src = regs.get(l.src) + l.src_off;
+        uint32_t src_lo = down ? src - (len - w) : src;
+        if (uint64_t(src_lo) + len != uint64_t(src) + (down ? w : len)
+            || (uint64_t(src_lo) + len > dst_lo && uint64_t(dst_lo) + len > src_lo)
+            || !mem.copy(dst_lo, src_lo, len))
+        {
+            return false;
+        }
+
+        uint32_t last = down ? src_lo : src_lo + len - w;
+        switch (l.load_op)
+        {
+            case rv32i_isa::id_lb: regs.set(l.value, mem.get8_sx(last)); break;
+            case rv32i_isa::id_lbu: regs.set(l.value, mem.get8(last)); break;
+            case rv32i_isa::id_lh: regs.set(l.value, mem.get16_sx(last)); break;
+            case rv32i_isa::id_lhu: regs.set(l.value, mem.get16(last)); break;
+            default: regs.set(l.value, mem.get32(last)); break;
+        }
+    }
+    else if (!mem.fill(dst_lo, len, regs.get(l.value), w))
+    {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < l.steps; ++i)
+    {
+        regs.set(l.step_reg[i], regs.get(l.step_reg[i]) + uint32_t(n) * uint32_t(l.step[i]));
+    }
+
+    insn_counter += n * l.count;
+    pc = (n == left) ? l.branch_pc + l.branch_size : l.head;
+    spin_break();
+    return true;
+}
+
+/**
+ * check_spin() is called after a jump or branch backwards and skips
+ * ahead if the loop it closed cannot make progress on its own.
+ *
+ * If pc is reached again with the same registers, no store, CSR access or
+ * system instruction in between, and no load outside RAM, every later
+ * iteration will do exactly the same. Such a loop can only be left by an
+ * interrupt, so whole iterations are counted off without running them,
+ * up to the next event or the instruction limit. The loop is then left
+ * to run on its own from there.
+ *
+ * A loop that turns out to be making progress is snapshotted less and
+ * less often, so busy loops without stores do not pay for the check on
+ * every iteration.
+ *
+ ********************************************************************************/
+
+void rv32i_hart::check_spin()
+{
+    if (pc != spin_pc || insn_counter - spin_count > spin_max)
+    {
+        spin_pc = pc;
+        spin_count = insn_counter;
+        spin_saved = false;
+        return;
+    }
+
+    if (spin_skip)
+    {
+        --spin_skip;
+        spin_count = insn_counter;
+        spin_saved = false;
+        return;
+    }
+
+    if (!spin_saved || spin_io != mem.get_io_reads() || !(regs == spin_regs))
+    {
+        if (spin_saved)
+        {
+            spin_backoff = spin_backoff ? (spin_backoff < 1024 ? spin_backoff*2 : 1024) : 1;
+            spin_skip = spin_backoff;
+        }
+        spin_regs = regs;
+        spin_io = mem.get_io_reads();
+        spin_count = insn_counter;
+        spin_saved = true;
+        return;
+    }
+
+    uint64_t horizon = next_event < insn_limit ? next_event : insn_limit;
+    if (horizon == event_queue::never)
+    {
+        return;                     // nothing will ever end it
+    }
+
+    uint64_t n = insn_counter - spin_count;
+    insn_counter += (horizon - insn_counter) / n * n;
+    spin_count = insn_counter;
+    spin_backoff = 0;
+}
+
+/**
+ * exec_uop() executes the first instruction of a uop.
+ *
+ * The common integer operations are carried out from the predecoded
+ * fields. Everything else goes through exec() with the instruction word.
+ * Stores and anything run by exec() end idle loop detection.
+ *
+ * @return false if the instruction was run by exec().
+ *
+ ********************************************************************************/
+
+bool rv32i_hart::exec_uop(const rv32i_predecode::uop &u)
+{
+    uint32_t a = regs.get(u.rs1);
+    uint32_t b = regs.get(u.rs2);
+
+    switch (u.op)
+    {
+        case rv32i_isa::id_lui: regs.set(u.rd, u.imm); break;
+        case rv32i_isa::id_auipc: regs.set(u.rd, pc + u.imm); break;
+
+        case rv32i_isa::id_jal:
+            regs.set(u.rd, pc + u.size);
+            pc += u.imm;
+            return true;
+
+        case rv32i_isa::id_jalr:
+            regs.set(u.rd, pc + u.size);
+            pc = (a + u.imm) & 0xfffffffe;
+            return true;
+
+        case rv32i_isa::id_beq: pc += (a == b) ? u.imm : u.size; return true;
+        case rv32i_isa::id_bne: pc += (a != b) ? u.imm : u.size; return true;
+        case rv32i_isa::id_blt: pc += (int32_t(a) < int32_t(b)) ? u.imm : u.size; return true;
+        case rv32i_isa::id_bge: pc += (int32_t(a) >= int32_t(b)) ? u.imm : u.size; return true;
+        case rv32i_isa::id_bltu: pc += (a < b) ? u.imm : u.size; return true;
+        case rv32i_isa::id_bgeu: pc += (a >= b) ? u.imm : u.size; return true;
+
+        case rv32i_isa::id_lb: regs.set(u.rd, int8_t(load8(a + u.imm))); break;
+        case rv32i_isa::id_lh: regs.set(u.rd, int16_t(load16(a + u.imm))); break;
+        case rv32i_isa::id_lw: regs.set(u.rd, load32(a + u.imm)); break;
+        case rv32i_isa::id_lbu: regs.set(u.rd, load8(a + u.imm)); break;
+        case rv32i_isa::id_lhu: regs.set(u.rd, load16(a + u.imm)); break;
+
+        case rv32i_isa::id_sb: store8(a + u.imm, b); spin_break(); break;
+        case rv32i_isa::id_sh: store16(a + u.imm, b); spin_break(); break;
+        case rv32i_isa::id_sw: store32(a + u.imm, b); spin_break(); break;
+
+        case rv32i_isa::id_addi: regs.set(u.rd, a + u.imm); break;
+        case rv32i_isa::id_slti: regs.set(u.rd, int32_t(a) < u.imm); break;
+        case rv32i_isa::id_sltiu: regs.set(u.rd, a < uint32_t(u.imm)); break;
+        case rv32i_isa::id_xori: regs.set(u.rd, a ^ u.imm); break;
+        case rv32i_isa::id_ori: regs.set(u.rd, a | u.imm); break;
+        case rv32i_isa::id_andi: regs.set(u.rd, a & u.imm); break;
+        case rv32i_isa::id_slli: regs.set(u.rd, a << u.imm); break;
+        case rv32i_isa::id_srli: regs.set(u.rd, a >> u.imm); break;
+        case rv32i_isa::id_srai: regs.set(u.rd, int32_t(a) >> u.imm); break;
+
+        case rv32i_isa::id_add: regs.set(u.rd, a + b); break;
+        case rv32i_isa::id_sub: regs.set(u.rd, a - b); break;
+        case rv32i_isa::id_sll: regs.set(u.rd, a << (b & 0x1f)); break;
+        case rv32i_isa::id_slt: regs.set(u.rd, int32_t(a) < int32_t(b)); break;
+        case rv32i_isa::id_sltu: regs.set(u.rd, a < b); break;
+        case rv32i_isa::id_xor: regs.set(u.rd, a ^ b); break;
+        case rv32i_isa::id_srl: regs.set(u.rd, a >> (b & 0x1f)); break;
+        case rv32i_isa::id_sra: regs.set(u.rd, int32_t(a) >> (b & 0x1f)); break;
+        case rv32i_isa::id_or: regs.set(u.rd, a | b); break;
+        case rv32i_isa::id_and: regs.set(u.rd, a & b); break;
+
+        case rv32i_isa::id_wfi: break;
+
+        default:
+            spin_break();
+            exec(u.insn, nullptr);
+            return false;
+    }
+
+    pc += u.size;
+    return true;
+}
+
+/**
+ * exec_fused() executes both instructions of a fused uop. Only the second
+ * instruction can access memory, and pc is moved to it first, so that a
+ * watchpoint hit or an access fault names the instruction that caused it.
+ *
+ ********************************************************************************/
 
-        case opcode_load_imm:
-            switch(get_funct3(insn))
+void rv32i_hart::exec_fused(const rv32i_predecode::uop &u)
+{
+    uint32_t next = pc + u.size + u.size2;
+
+    switch (u.op)
+    {
+        case rv32i_predecode::fuse_li:
+            regs.set(u.rd, u.imm);
+            break;
+
+        case rv32i_predecode::fuse_la:
+            regs.set(u.rd, pc + u.imm);
+            break;
+
+        case rv32i_predecode::fuse_call:
+        {
+            uint32_t hi = pc + u.imm;
+            regs.set(u.rd, hi);
+            regs.set(u.rd2, next);
+            next = (hi + u.imm2) & 0xfffffffe;
+            break;
+        }
+
+        case rv32i_predecode::fuse_lw_pc:
+        {
+            uint32_t hi = pc + u.imm;
+            regs.set(u.rd, hi);
+            pc += u.size;               // the lw is the one accessing memory
+            regs.set(u.rd2, load32(hi + u.imm2));
+            break;
+        }
+
+        case rv32i_predecode::fuse_cmp_br:
+        {
+            uint32_t a = regs.get(u.rs1);
+            bool lt;
+            switch (u.cmp)
             {
-                default: exec_illegal_insn(pos); return;
-                case funct3_lbu: exec_lbu(insn, pos); return;
-                case funct3_lhu: exec_lhu(insn, pos); return;
-                case funct3_lb: exec_lb(insn, pos); return;
-                case funct3_lh: exec_lh(insn, pos); return;
-                case funct3_lw: exec_lw(insn, pos); return;
+                case rv32i_isa::id_slt: lt = int32_t(a) < regs.get(u.rs2); break;
+                case rv32i_isa::id_sltu: lt = a < uint32_t(regs.get(u.rs2)); break;
+                case rv32i_isa::id_slti: lt = int32_t(a) < u.imm; break;
+                default: lt = a < uint32_t(u.imm); break;
             }
+            regs.set(u.rd, lt);
+            if (lt == bool(u.br_on))
+                next = pc + u.size + u.imm2;
+            break;
+        }
+    }
+
+    pc = next;
+}
+
+/**
+ * run_hle() carries out the library function bound at pc and returns to
+ * ra, as if the function had run and returned.
+ *
+ ********************************************************************************/
+
+void rv32i_hart::run_hle()
+{
+    std::string comment;
+    uint32_t from = pc;
 
+    insn_counter += hle_calls->call(pc, regs, comment);
+    pc = regs.get(1) & ~1u;
+    spin_break();
+
+    if (show_instructions)
+    {
+        std::cout << "-- hle " << comment << " at " << hex0x32(from)
+                  << ", pc = " << hex0x32(pc) << std::endl;
     }
 }
 
+/**
+ * trace_insn() writes the pc, the instruction and its disassembly,
+ * padded to instruction_width, ahead of an exec_*() trace comment.
+ *
+ * The line is built in one buffer and written at once, so tracing
+ * does not allocate.
+ *
+ ********************************************************************************/
+
+void rv32i_hart::trace_insn(std::ostream *pos, uint32_t insn) const
+{
+    char buf[20 + render_size + instruction_width];
+    char *p = buf;
+
+    p = append_hex(p, pc, 8, false);
+    *p++ = ':';
+    *p++ = ' ';
+    p = append_hex(p, insn, 8, false);
+    *p++ = ' ';
+    *p++ = ' ';
+
+    char *text = p;
+    p += render(decode_insn(pc, insn), p, render_size);
+    while (p - text < instruction_width)
+        *p++ = ' ';
+
+    pos->write(buf, p - buf);
+}
+
 void rv32i_hart::exec_illegal_insn(std::ostream* pos)
 {
     if (pos)
@@ -187,9 +781,7 @@ void rv32i_hart::exec_ebreak(int32_t insn, std::ostream* pos)
 {
     if (pos)
     {
-        std::string s = render_ebreak();
-        *pos << hex::to_hex32(pc) << ": " << hex::to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
+        trace_insn(pos, insn);
         *pos << "// HALT";
     }
 
@@ -197,12 +789,52 @@ void rv32i_hart::exec_ebreak(int32_t insn, std::ostream* pos)
     halt_reason = "EBREAK instruction";
 }
 
-void rv32i_hart::exec_ecall(std::ostream* pos)
+/**
+ * exec_ecall() halts the hart, or when a syscall proxy is attached,
+ * performs the system call selected by a7 and continues. Without a
+ * proxy, a hart that has set mtvec takes an environment call trap.
+ *
+ ********************************************************************************/
+
+void rv32i_hart::exec_ecall(uint32_t insn, std::ostream* pos)
 {
+    if (syscalls)
+    {
+        std::string comment;
+        bool running = syscalls->dispatch(regs, comment);
+
+        if (pos)
+        {
+            trace_insn(pos, insn);
+            *pos << "// " << comment;
+        }
+
+        if (!running)
+        {
+            halt = true;
+            halt_reason = "exit(" + std::to_string(syscalls->get_exit_code()) + ")";
+            return;
+        }
+
+        pc += insn_size;
+        return;
+    }
+
+    if (mtvec != 0)
+    {
+        take_trap(11, 0);       // environment call from M-mode
+
+        if (pos)
+        {
+            trace_insn(pos, insn);
+            *pos << "// trap, pc = " << hex0x32(pc);
+        }
+        return;
+    }
+
     if (pos)
     {
-        std::string s = render_ecall();
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
+        trace_insn(pos, insn);
         *pos << "// ECALL";
     }
 
@@ -217,14 +849,12 @@ void rv32i_hart::exec_lui(uint32_t insn, std::ostream* pos)
 
     if (pos)
     {
-        std::string s = render_lui(insn);
-        *pos << hex::to_hex32(pc) << ": " << hex::to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(immu);
+        trace_insn(pos, insn);
+        *pos << "// " << reg(rd) << " = " << hex0x32(immu);
     }
 
     regs.set(rd, get_imm_u(insn));
-    pc += 4;
+    pc += insn_size;
 }
 
 void rv32i_hart::exec_auipc(uint32_t insn, std::ostream* pos)
@@ -235,15 +865,13 @@ void rv32i_hart::exec_auipc(uint32_t insn, std::ostream* pos)
 
     if (pos)
     {
-        std::string s = render_auipc(insn);
-        *pos << to_hex32(pc) << ": " << to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << to_hex0x32(pc) << " + "
-             << hex::to_hex0x32(immu) << " = " << hex::to_hex0x32(val); 
+        trace_insn(pos, insn);
+        *pos << "// " << reg(rd) << " = " << hex0x32(pc) << " + "
+             << hex0x32(immu) << " = " << hex0x32(val); 
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += insn_size;
 }
 
 void rv32i_hart::exec_jal(uint32_t insn, std::ostream* pos)
@@ -254,15 +882,14 @@ void rv32i_hart::exec_jal(uint32_t insn, std::ostream* pos)
 
     if (pos)
     {
-        std::string s = render_jal(pc, insn);
-        *pos << to_hex32(pc) << ": " << to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << to_hex0x32(pc+4) << ",  pc = "
-             << to_hex0x32(pc) << " + " << to_hex0x32(immj) << " = " << to_hex0x32(val);
+        trace_insn(pos, insn);
+        *pos << "// " << reg(rd) << " = " << hex0x32(pc+insn_size) << ",  pc = "
+             << hex0x32(pc) << " + " << hex0x32(immj) << " = " << hex0x32(val);
 
     }
 
-    regs.set(rd, pc+4);
+    regs.set(rd, pc+insn_size);
+    cover(pc, val);
     pc = val;
 }
 
@@ -275,15 +902,14 @@ void rv32i_hart::exec_jalr(uint32_t insn, std::ostream* pos)
 
     if (pos)
     {
-        std::string s = render_jalr(insn);
-        *pos << to_hex32(pc) << ": " << to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << to_hex0x32(pc+4) << ",  pc = ("
-             << to_hex0x32(immi) << " + " << to_hex0x32(regs.get(rs1)) 
-             << ") & 0xfffffffe = " << to_hex0x32(val);
+        trace_insn(pos, insn);
+        *pos << "// " << reg(rd) << " = " << hex0x32(pc+insn_size) << ",  pc = ("
+             << hex0x32(immi) << " + " << hex0x32(regs.get(rs1)) 
+             << ") & 0xfffffffe = " << hex0x32(val);
     }
 
-    regs.set(rd, pc+4);
+    regs.set(rd, pc+insn_size);
+    cover(pc, val);
     pc = val;
 }
 
@@ -300,18 +926,17 @@ void rv32i_hart::exec_beq(uint32_t insn, std::ostream* pos)
     }
     else
     {
-        val = 4;
+        val = insn_size;
     }
 
     if (pos)
     {
-        std::string s = render_btype(pc, insn, "beq     ");
-        *pos << to_hex32(pc) << ": " << to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// pc += (" << to_hex0x32(regs.get(rs1)) << " == "
-             << to_hex0x32(regs.get(rs2)) << " ? " << to_hex0x32(immb)
-             << " : 4) = " << to_hex0x32(pc+val);
+        trace_insn(pos, insn);
+        *pos << "// pc += (" << hex0x32(regs.get(rs1)) << " == "
+             << hex0x32(regs.get(rs2)) << " ? " << hex0x32(immb)
+             << " : " << insn_size << ") = " << hex0x32(pc+val);
     }
+    cover(pc, pc + val);
     pc += val;
 }
 
@@ -328,19 +953,18 @@ void rv32i_hart::exec_bne(uint32_t insn, std::ostream* pos)
     }
     else
     {
-        val = 4;
+        val = insn_size;
     }
 
     if (pos)
     {
-        std::string s = render_btype(pc, insn, "bne     ");
-        *pos << to_hex32(pc) << ": " << to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// pc += (" << to_hex0x32(regs.get(rs1)) << " != "
-             << to_hex0x32(regs.get(rs2)) << " ? " << to_hex0x32(immb)
-             << " : 4) = " << to_hex0x32(pc+val);
+        trace_insn(pos, insn);
+        *pos << "// pc += (" << hex0x32(regs.get(rs1)) << " != "
+             << hex0x32(regs.get(rs2)) << " ? " << hex0x32(immb)
+             << " : " << insn_size << ") = " << hex0x32(pc+val);
 
     }
+    cover(pc, pc + val);
     pc += val;
 }
 
@@ -357,18 +981,17 @@ void rv32i_hart::exec_blt(uint32_t insn, std::ostream* pos)
     }
     else
     {
-        val = 4;
+        val = insn_size;
     }
 
     if (pos)
     {
-        std::string s = render_btype(pc, insn, "blt     ");
-        *pos << to_hex32(pc) << ": " << to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// pc += (" << to_hex0x32(regs.get(rs1)) << " < "
-             << to_hex0x32(regs.get(rs2)) << " ? " << to_hex0x32(immb)
-             << " : 4) = " << to_hex0x32(pc+val);
+        trace_insn(pos, insn);
+        *pos << "// pc += (" << hex0x32(regs.get(rs1)) << " < "
+             << hex0x32(regs.get(rs2)) << " ? " << hex0x32(immb)
+             << " : " << insn_size << ") = " << hex0x32(pc+val);
     }
+    cover(pc, pc + val);
     pc += val;
 }
 
@@ -385,19 +1008,18 @@ void rv32i_hart::exec_bge(uint32_t insn, std::ostream* pos)
     }
     else
     {
-        val = 4;
+        val = insn_size;
     }
 
     if (pos)
     {
-        std::string s = render_btype(pc, insn, "bge     ");
-        *pos << to_hex32(pc) << ": " << to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// pc += (" << to_hex0x32(regs.get(rs1)) << " >= "
-             << to_hex0x32(regs.get(rs2)) << " ? " << to_hex0x32(immb)
-             << " : 4) = " << to_hex0x32(pc+val);
+        trace_insn(pos, insn);
+        *pos << "// pc += (" << hex0x32(regs.get(rs1)) << " >= "
+             << hex0x32(regs.get(rs2)) << " ? " << hex0x32(immb)
+             << " : " << insn_size << ") = " << hex0x32(pc+val);
     }
 
+    cover(pc, pc + val);
     pc += val;
 }
 
@@ -417,18 +1039,17 @@ void rv32i_hart::exec_bltu(uint32_t insn, std::ostream* pos)
     }
     else
     {
-        val = 4;
+        val = insn_size;
     }
 
     if (pos)
     {
-        std::string s = render_btype(pc, insn, "bltu    ");
-        *pos << to_hex32(pc) << ": " << to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// pc += (" << to_hex0x32(regs.get(rs1)) << " <U "
-             << to_hex0x32(regs.get(rs2)) << " ? " << to_hex0x32(immb)
-             << " : 4) = " << to_hex0x32(pc+val);
+        trace_insn(pos, insn);
+        *pos << "// pc += (" << hex0x32(regs.get(rs1)) << " <U "
+             << hex0x32(regs.get(rs2)) << " ? " << hex0x32(immb)
+             << " : " << insn_size << ") = " << hex0x32(pc+val);
     }
+    cover(pc, pc + val);
     pc += val;
 }
 
@@ -448,18 +1069,17 @@ void rv32i_hart::exec_bgeu(uint32_t insn, std::ostream* pos)
     }
     else
     {
-        val = 4;
+        val = insn_size;
     }
 
     if (pos)
     {
-        std::string s = render_btype(pc, insn, "bgeu    ");
-        *pos << to_hex32(pc) << ": " << to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// pc += (" << to_hex0x32(regs.get(rs1)) << " >=U "
-             << to_hex0x32(regs.get(rs2)) << " ? " << to_hex0x32(immb)
-             << " : 4) = " << to_hex0x32(pc+val);
+        trace_insn(pos, insn);
+        *pos << "// pc += (" << hex0x32(regs.get(rs1)) << " >=U "
+             << hex0x32(regs.get(rs2)) << " ? " << hex0x32(immb)
+             << " : " << insn_size << ") = " << hex0x32(pc+val);
     }
+    cover(pc, pc + val);
     pc += val;
 }
 
@@ -472,15 +1092,13 @@ void rv32i_hart::exec_addi(uint32_t insn, std::ostream* pos)
 
     if (pos)
     {
-        std::string s = render_itype_alu(insn, "addi    ", get_imm_i(insn));
-        *pos << hex::to_hex32(pc) << ": " << hex::to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(regs.get(rs1)) << " + "
-             << hex::to_hex0x32(immi) << " = " << hex::to_hex0x32(val);
+        trace_insn(pos, insn);
+        *pos << "// " << reg(rd) << " = " << hex0x32(regs.get(rs1)) << " + "
+             << hex0x32(immi) << " = " << hex0x32(val);
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += insn_size;
 }
 
 void rv32i_hart::exec_lbu(uint32_t insn, std::ostream* pos)
@@ -488,19 +1106,17 @@ void rv32i_hart::exec_lbu(uint32_t insn, std::ostream* pos)
     uint32_t rd = get_rd(insn);
     uint32_t rs1 = get_rs1(insn);
     uint32_t immi = get_imm_i(insn);
-    uint8_t val = mem.get8(regs.get(rs1)+immi)&0x000000ff;
+    uint8_t val = load8(regs.get(rs1)+immi)&0x000000ff;
 
     if (pos)
     {
-        std::string s = render_itype_load(insn, "lbu     ");
-        *pos << to_hex32(pc) << ": " << to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = zx(m8(" << hex::to_hex0x32(regs.get(rs1)) << " + "
-             << hex::to_hex0x32(immi) << ")) = " << hex::to_hex0x32(val);
+        trace_insn(pos, insn);
+        *pos << "// " << reg(rd) << " = zx(m8(" << hex0x32(regs.get(rs1)) << " + "
+             << hex0x32(immi) << ")) = " << hex0x32(val);
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += insn_size;
 }
 
 void rv32i_hart::exec_lhu(uint32_t insn, std::ostream* pos)
@@ -508,19 +1124,17 @@ void rv32i_hart::exec_lhu(uint32_t insn, std::ostream* pos)
     uint32_t rd = get_rd(insn);
     uint32_t rs1 = get_rs1(insn);
     uint32_t immi = get_imm_i(insn);
-    uint16_t val = mem.get16(regs.get(rs1)+immi)&0x0000ffff;
+    uint16_t val = load16(regs.get(rs1)+immi)&0x0000ffff;
 
     if (pos)
     {
-        std::string s = render_itype_load(insn, "lhu     ");
-        *pos << to_hex32(pc) << ": " << to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = zx(m16(" << hex::to_hex0x32(regs.get(rs1)) << " + "
-             << hex::to_hex0x32(immi) << ")) = " << hex::to_hex0x32(val);
+        trace_insn(pos, insn);
+        *pos << "// " << reg(rd) << " = zx(m16(" << hex0x32(regs.get(rs1)) << " + "
+             << hex0x32(immi) << ")) = " << hex0x32(val);
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += insn_size;
 }
 
 void rv32i_hart::exec_lb(uint32_t insn, std::ostream* pos)
@@ -528,19 +1142,17 @@ void rv32i_hart::exec_lb(uint32_t insn, std::ostream* pos)
     uint32_t rd = get_rd(insn);
     uint32_t rs1 = get_rs1(insn);
     int32_t immi = get_imm_i(insn);             // signed
-    int8_t val = mem.get8(regs.get(rs1)+immi);  // signed
+    int8_t val = load8(regs.get(rs1)+immi);  // signed
 
     if (pos)
     {
-        std::string s = render_itype_load(insn, "lb      ");
-        *pos << to_hex32(pc) << ": " << to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = sx(m8(" << hex::to_hex0x32(regs.get(rs1)) << " + "
-             << hex::to_hex0x32(immi) << ")) = " << hex::to_hex0x32(val);
+        trace_insn(pos, insn);
+        *pos << "// " << reg(rd) << " = sx(m8(" << hex0x32(regs.get(rs1)) << " + "
+             << hex0x32(immi) << ")) = " << hex0x32(val);
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += insn_size;
 }
 
 void rv32i_hart::exec_lh(uint32_t insn, std::ostream* pos)
@@ -548,19 +1160,17 @@ void rv32i_hart::exec_lh(uint32_t insn, std::ostream* pos)
     uint32_t rd = get_rd(insn);
     uint32_t rs1 = get_rs1(insn);
     int32_t immi = get_imm_i(insn);               // signed
-    int16_t val = mem.get16(regs.get(rs1)+immi);  // signed
+    int16_t val = load16(regs.get(rs1)+immi);  // signed
 
     if (pos)
     {
-        std::string s = render_itype_load(insn, "lh      ");
-        *pos << to_hex32(pc) << ": " << to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = sx(m16(" << hex::to_hex0x32(regs.get(rs1)) << " + "
-             << hex::to_hex0x32(immi) << ")) = " << hex::to_hex0x32(val);
+        trace_insn(pos, insn);
+        *pos << "// " << reg(rd) << " = sx(m16(" << hex0x32(regs.get(rs1)) << " + "
+             << hex0x32(immi) << ")) = " << hex0x32(val);
     }
     
     regs.set(rd, val);
-    pc += 4;
+    pc += insn_size;
 }
 
 void rv32i_hart::exec_lw(uint32_t insn, std::ostream* pos)
@@ -568,20 +1178,18 @@ void rv32i_hart::exec_lw(uint32_t insn, std::ostream* pos)
     uint32_t rd = get_rd(insn);
     uint32_t rs1 = get_rs1(insn);
     int32_t immi = get_imm_i(insn);
-    uint32_t val = mem.get32(regs.get(rs1)+immi);
+    uint32_t val = load32(regs.get(rs1)+immi);
 
     if (pos)
     {
-        std::string s = render_itype_load(insn, "lw      ");
-        *pos << to_hex32(pc) << ": " << to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = sx(m32(" << hex::to_hex0x32(regs.get(rs1)) << " + "
-             << hex::to_hex0x32(immi) << ")) = " << hex::to_hex0x32(val);
+        trace_insn(pos, insn);
+        *pos << "// " << reg(rd) << " = sx(m32(" << hex0x32(regs.get(rs1)) << " + "
+             << hex0x32(immi) << ")) = " << hex0x32(val);
 
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += insn_size;
 }
 
 void rv32i_hart::exec_sb(uint32_t insn, std::ostream* pos)
@@ -590,18 +1198,16 @@ void rv32i_hart::exec_sb(uint32_t insn, std::ostream* pos)
     uint32_t rs2 = get_rs2(insn);
     int32_t imms = get_imm_s(insn);
     uint32_t val = regs.get(rs1)+imms;
-    mem.set8(val, regs.get(rs2)&0x000000ff);
+    store8(val, regs.get(rs2)&0x000000ff);
 
     if (pos)
     {
-        std::string s = render_stype(insn, "sb      ");
-        *pos << to_hex32(pc) << ": " << to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// m8(" << hex::to_hex0x32(regs.get(rs1)) << " + "
-             << hex::to_hex0x32(imms) << ") = " << hex::to_hex0x32(mem.get8(val));
+        trace_insn(pos, insn);
+        *pos << "// m8(" << hex0x32(regs.get(rs1)) << " + "
+             << hex0x32(imms) << ") = " << hex0x32(regs.get(rs2)&0x000000ff);
     }
 
-    pc += 4;
+    pc += insn_size;
 }
 
 void rv32i_hart::exec_sh(uint32_t insn, std::ostream* pos)
@@ -610,18 +1216,16 @@ void rv32i_hart::exec_sh(uint32_t insn, std::ostream* pos)
     uint32_t rs2 = get_rs2(insn);
     int32_t imms = get_imm_s(insn);
     uint32_t val = regs.get(rs1)+imms;
-    mem.set16(val, regs.get(rs2)&0x0000ffff);
+    store16(val, regs.get(rs2)&0x0000ffff);
 
     if (pos)
     {
-        std::string s = render_stype(insn, "sh      ");
-        *pos << to_hex32(pc) << ": " << to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// m16(" << hex::to_hex0x32(regs.get(rs1)) << " + "
-             << hex::to_hex0x32(imms) << ") = " << hex::to_hex0x32(mem.get16(val));
+        trace_insn(pos, insn);
+        *pos << "// m16(" << hex0x32(regs.get(rs1)) << " + "
+             << hex0x32(imms) << ") = " << hex0x32(regs.get(rs2)&0x0000ffff);
     }
 
-    pc += 4;
+    pc += insn_size;
 }
 
 void rv32i_hart::exec_sw(uint32_t insn, std::ostream* pos)
@@ -630,18 +1234,16 @@ void rv32i_hart::exec_sw(uint32_t insn, std::ostream* pos)
     uint32_t rs2 = get_rs2(insn);
     int32_t imms = get_imm_s(insn);
     uint32_t val = regs.get(rs1)+imms;
-    mem.set32(val, regs.get(rs2));
+    store32(val, regs.get(rs2));
 
     if (pos)
     {
-        std::string s = render_stype(insn, "sw      ");
-        *pos << to_hex32(pc) << ": " << to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// m32(" << hex::to_hex0x32(regs.get(rs1)) << " + "
-             << hex::to_hex0x32(imms) << ") = " << hex::to_hex0x32(mem.get32(val));
+        trace_insn(pos, insn);
+        *pos << "// m32(" << hex0x32(regs.get(rs1)) << " + "
+             << hex0x32(imms) << ") = " << hex0x32(regs.get(rs2));
     }
 
-    pc += 4;
+    pc += insn_size;
 }
 
 void rv32i_hart::exec_slti(uint32_t insn, std::ostream* pos)
@@ -654,16 +1256,14 @@ void rv32i_hart::exec_slti(uint32_t insn, std::ostream* pos)
 
     if (pos)
     {
-        std::string s = render_itype_alu(insn, "slti    ", get_imm_i(insn));
-        *pos << to_hex32(pc) << ": " << to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = (" << hex::to_hex0x32(regs.get(rs1)) << " < "
-             << std::dec << immi << ") ? 1 : 0 = " << hex::to_hex0x32(val);
+        trace_insn(pos, insn);
+        *pos << "// " << reg(rd) << " = (" << hex0x32(regs.get(rs1)) << " < "
+             << std::dec << immi << ") ? 1 : 0 = " << hex0x32(val);
         
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += insn_size;
 }
 
 void rv32i_hart::exec_sltiu(uint32_t insn, std::ostream* pos)
@@ -677,15 +1277,13 @@ void rv32i_hart::exec_sltiu(uint32_t insn, std::ostream* pos)
 
     if (pos)
     {
-        std::string s = render_itype_alu(insn, "sltiu   ", get_imm_i(insn));
-        *pos << to_hex32(pc) << ": " << to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = (" << hex::to_hex0x32(regs.get(rs1)) << " <U "
-             << std::dec << immi << ") ? 1 : 0 = " << hex::to_hex0x32(val);
+        trace_insn(pos, insn);
+        *pos << "// " << reg(rd) << " = (" << hex0x32(regs.get(rs1)) << " <U "
+             << std::dec << immi << ") ? 1 : 0 = " << hex0x32(val);
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += insn_size;
 }
 
 void rv32i_hart::exec_xori(uint32_t insn, std::ostream* pos)
@@ -698,15 +1296,13 @@ void rv32i_hart::exec_xori(uint32_t insn, std::ostream* pos)
 
     if (pos)
     {
-        std::string s = render_itype_alu(insn, "xori    ", get_imm_i(insn));
-        *pos << to_hex32(pc) << ": " << to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(regs.get(rs1)) << " ^ "
-             << hex::to_hex0x32(immi) << " = " << hex::to_hex0x32(val);
+        trace_insn(pos, insn);
+        *pos << "// " << reg(rd) << " = " << hex0x32(regs.get(rs1)) << " ^ "
+             << hex0x32(immi) << " = " << hex0x32(val);
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += insn_size;
 }
 
 void rv32i_hart::exec_ori(uint32_t insn, std::ostream* pos)
@@ -719,15 +1315,13 @@ void rv32i_hart::exec_ori(uint32_t insn, std::ostream* pos)
 
     if (pos)
     {
-        std::string s = render_itype_alu(insn, "ori     ", get_imm_i(insn));
-        *pos << to_hex32(pc) << ": " << to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(regs.get(rs1)) << " | "
-             << hex::to_hex0x32(immi) << " = " << hex::to_hex0x32(val);
+        trace_insn(pos, insn);
+        *pos << "// " << reg(rd) << " = " << hex0x32(regs.get(rs1)) << " | "
+             << hex0x32(immi) << " = " << hex0x32(val);
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += insn_size;
 }
 
 void rv32i_hart::exec_andi(uint32_t insn, std::ostream* pos)
@@ -740,15 +1334,13 @@ void rv32i_hart::exec_andi(uint32_t insn, std::ostream* pos)
 
     if (pos)
     {
-        std::string s = render_itype_alu(insn, "andi    ", get_imm_i(insn));
-        *pos << to_hex32(pc) << ": " << to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(regs.get(rs1)) << " & "
-             << hex::to_hex0x32(immi) << " = " << hex::to_hex0x32(val);
+        trace_insn(pos, insn);
+        *pos << "// " << reg(rd) << " = " << hex0x32(regs.get(rs1)) << " & "
+             << hex0x32(immi) << " = " << hex0x32(val);
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += insn_size;
 }
 
 void rv32i_hart::exec_slli(uint32_t insn, std::ostream* pos)
@@ -761,15 +1353,13 @@ void rv32i_hart::exec_slli(uint32_t insn, std::ostream* pos)
 
     if (pos)
     {
-        std::string s = render_itype_alu(insn, "slli    ", get_imm_i(insn));
-        *pos << to_hex32(pc) << ": " << to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(regs.get(rs1)) << " << "
-             << shamt_i << " = " << hex::to_hex0x32(immiShift);
+        trace_insn(pos, insn);
+        *pos << "// " << reg(rd) << " = " << hex0x32(regs.get(rs1)) << " << "
+             << shamt_i << " = " << hex0x32(immiShift);
     }
 
     regs.set(rd, immiShift);
-    pc += 4;
+    pc += insn_size;
 }
 
 void rv32i_hart::exec_srli(uint32_t insn, std::ostream* pos)
@@ -783,15 +1373,13 @@ void rv32i_hart::exec_srli(uint32_t insn, std::ostream* pos)
 
     if (pos)
     {
-        std::string s = render_itype_alu(insn, "srli    ", get_imm_i(insn));
-        *pos << to_hex32(pc) << ": " << to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(regs.get(rs1)) << " >> "
-             << std::dec << shamt_i << " = " << hex::to_hex0x32(immiShift);
+        trace_insn(pos, insn);
+        *pos << "// " << reg(rd) << " = " << hex0x32(regs.get(rs1)) << " >> "
+             << std::dec << shamt_i << " = " << hex0x32(immiShift);
     }
 
     regs.set(rd, immiShift);
-    pc += 4;
+    pc += insn_size;
 }
 
 void rv32i_hart::exec_srai(uint32_t insn, std::ostream* pos)
@@ -804,15 +1392,13 @@ void rv32i_hart::exec_srai(uint32_t insn, std::ostream* pos)
 
     if (pos)
     {
-        std::string s = render_itype_alu(insn, "srai    ", get_imm_i(insn)%XLEN);
-        *pos << to_hex32(pc) << ": " << to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(regs.get(rs1)) << " >> "
-             << std::dec << shamt_i << " = " << hex::to_hex0x32(immiShift);
+        trace_insn(pos, insn);
+        *pos << "// " << reg(rd) << " = " << hex0x32(regs.get(rs1)) << " >> "
+             << std::dec << shamt_i << " = " << hex0x32(immiShift);
     }
 
     regs.set(rd, immiShift);
-    pc += 4;
+    pc += insn_size;
 }
 
 void rv32i_hart::exec_add(uint32_t insn, std::ostream* pos)
@@ -824,15 +1410,13 @@ void rv32i_hart::exec_add(uint32_t insn, std::ostream* pos)
 
     if (pos)
     {
-        std::string s = render_rtype(insn, "add     ");
-        *pos << to_hex32(pc) << ": " << to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(regs.get(rs1)) << " + "
-             << hex::to_hex0x32(regs.get(rs2)) << " = " << hex::to_hex0x32(val);
+        trace_insn(pos, insn);
+        *pos << "// " << reg(rd) << " = " << hex0x32(regs.get(rs1)) << " + "
+             << hex0x32(regs.get(rs2)) << " = " << hex0x32(val);
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += insn_size;
 }
 
 void rv32i_hart::exec_sub(uint32_t insn, std::ostream* pos)
@@ -844,15 +1428,13 @@ void rv32i_hart::exec_sub(uint32_t insn, std::ostream* pos)
 
     if (pos)
     {
-        std::string s = render_rtype(insn, "sub     ");
-        *pos << to_hex32(pc) << ": " << to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(regs.get(rs1)) << " - "
-             << hex::to_hex0x32(regs.get(rs2)) << " = " << hex::to_hex0x32(val);
+        trace_insn(pos, insn);
+        *pos << "// " << reg(rd) << " = " << hex0x32(regs.get(rs1)) << " - "
+             << hex0x32(regs.get(rs2)) << " = " << hex0x32(val);
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += insn_size;
 }
 
 void rv32i_hart::exec_sll(uint32_t insn, std::ostream* pos)
@@ -865,15 +1447,13 @@ void rv32i_hart::exec_sll(uint32_t insn, std::ostream* pos)
 
     if (pos)
     {
-        std::string s = render_rtype(insn, "sll     ");
-        *pos << to_hex32(pc) << ": " << to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(regs.get(rs1)) << " << "
-             << rs2Shifted << " = " << hex::to_hex0x32(sllShift);
+        trace_insn(pos, insn);
+        *pos << "// " << reg(rd) << " = " << hex0x32(regs.get(rs1)) << " << "
+             << rs2Shifted << " = " << hex0x32(sllShift);
     }
 
     regs.set(rd, sllShift);
-    pc += 4;
+    pc += insn_size;
 }
 
 void rv32i_hart::exec_slt(uint32_t insn, std::ostream* pos)
@@ -886,15 +1466,13 @@ void rv32i_hart::exec_slt(uint32_t insn, std::ostream* pos)
 
     if (pos)
     {
-        std::string s = render_rtype(insn, "slt     ");
-        *pos << hex::to_hex32(pc) << ": " << hex::to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = (" << hex::to_hex0x32(regs.get(rs1))
-             << " < " << hex::to_hex0x32(regs.get(rs2)) << ") ? 1 : 0 = " << hex::to_hex0x32(val);
+        trace_insn(pos, insn);
+        *pos << "// " << reg(rd) << " = (" << hex0x32(regs.get(rs1))
+             << " < " << hex0x32(regs.get(rs2)) << ") ? 1 : 0 = " << hex0x32(val);
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += insn_size;
 }
 
 void rv32i_hart::exec_sltu(uint32_t insn, std::ostream* pos)
@@ -909,15 +1487,13 @@ void rv32i_hart::exec_sltu(uint32_t insn, std::ostream* pos)
 
     if (pos)
     {
-        std::string s = render_rtype(insn, "sltu    ");
-        *pos << hex::to_hex32(pc) << ": " << hex::to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = (" << hex::to_hex0x32(rs1U)
-             << " <U " << hex::to_hex0x32(rs2U) << ") ? 1 : 0 = " << hex::to_hex0x32(val);
+        trace_insn(pos, insn);
+        *pos << "// " << reg(rd) << " = (" << hex0x32(rs1U)
+             << " <U " << hex0x32(rs2U) << ") ? 1 : 0 = " << hex0x32(val);
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += insn_size;
 }
 
 void rv32i_hart::exec_xor(uint32_t insn, std::ostream* pos)
@@ -932,15 +1508,13 @@ void rv32i_hart::exec_xor(uint32_t insn, std::ostream* pos)
 
     if (pos)
     {
-        std::string s = render_rtype(insn, "xor     ");
-        *pos << hex::to_hex32(pc) << ": " << hex::to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(rs1U)
-             << " ^ " << hex::to_hex0x32(rs2U) << " = " << hex::to_hex0x32(val);
+        trace_insn(pos, insn);
+        *pos << "// " << reg(rd) << " = " << hex0x32(rs1U)
+             << " ^ " << hex0x32(rs2U) << " = " << hex0x32(val);
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += insn_size;
 }
 
 void rv32i_hart::exec_srl(uint32_t insn, std::ostream* pos)
@@ -957,15 +1531,13 @@ void rv32i_hart::exec_srl(uint32_t insn, std::ostream* pos)
 
     if (pos)
     {
-        std::string s = render_rtype(insn, "srl     ");
-        *pos << to_hex32(pc) << ": " << to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(regs.get(rs1)) << " >> "
-             << rs2Shifted << " = " << hex::to_hex0x32(rs1Shift);
+        trace_insn(pos, insn);
+        *pos << "// " << reg(rd) << " = " << hex0x32(regs.get(rs1)) << " >> "
+             << rs2Shifted << " = " << hex0x32(rs1Shift);
     }
 
     regs.set(rd, rs1Shift);
-    pc += 4;
+    pc += insn_size;
 }
 
 void rv32i_hart::exec_sra(uint32_t insn, std::ostream* pos)
@@ -982,15 +1554,13 @@ void rv32i_hart::exec_sra(uint32_t insn, std::ostream* pos)
 
     if (pos)
     {
-        std::string s = render_rtype(insn, "sra     ");
-        *pos << to_hex32(pc) << ": " << to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(rs1U) << " >> "
-             << rs2Shifted << " = " << hex::to_hex0x32(rs1Shift);
+        trace_insn(pos, insn);
+        *pos << "// " << reg(rd) << " = " << hex0x32(rs1U) << " >> "
+             << rs2Shifted << " = " << hex0x32(rs1Shift);
     }
 
     regs.set(rd, rs1Shift);
-    pc += 4;
+    pc += insn_size;
 }
 
 void rv32i_hart::exec_or(uint32_t insn, std::ostream* pos)
@@ -1005,15 +1575,13 @@ void rv32i_hart::exec_or(uint32_t insn, std::ostream* pos)
 
     if (pos)
     {
-        std::string s = render_rtype(insn, "or      ");
-        *pos << to_hex32(pc) << ": " << to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(rs1U) << " | "
-             << hex::to_hex0x32(rs2U) << " = " << hex::to_hex0x32(val);
+        trace_insn(pos, insn);
+        *pos << "// " << reg(rd) << " = " << hex0x32(rs1U) << " | "
+             << hex0x32(rs2U) << " = " << hex0x32(val);
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += insn_size;
 }
 
 void rv32i_hart::exec_and(uint32_t insn, std::ostream* pos)
@@ -1028,37 +1596,526 @@ void rv32i_hart::exec_and(uint32_t insn, std::ostream* pos)
     
     if (pos)
     {
-        std::string s = render_rtype(insn, "and     ");
-        *pos << to_hex32(pc) << ": " << to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << hex::to_hex0x32(rs1U) << " & "
-             << hex::to_hex0x32(rs2U) << " = " << hex::to_hex0x32(val);
+        trace_insn(pos, insn);
+        *pos << "// " << reg(rd) << " = " << hex0x32(rs1U) << " & "
+             << hex0x32(rs2U) << " = " << hex0x32(val);
     }
 
     regs.set(rd, val);
-    pc += 4;
+    pc += insn_size;
 }
 
-void rv32i_hart::exec_csrrs(uint32_t insn, std::ostream* pos)
+void rv32i_hart::exec_mul(uint32_t insn, std::ostream* pos)
 {
     uint32_t rd = get_rd(insn);
     uint32_t rs1 = get_rs1(insn);
-    int32_t csrrs = (get_imm_i(insn) & 0x00000fff);
+    uint32_t rs2 = get_rs2(insn);
+    uint32_t rs1U = regs.get(rs1);
+    uint32_t rs2U = regs.get(rs2);
+
+    uint32_t val = rs1U * rs2U;
 
-    if (rs1 != 0 || csrrs != 0x00000f14)
+    if (pos)
     {
+        trace_insn(pos, insn);
+        *pos << "// " << reg(rd) << " = " << hex0x32(regs.get(rs1)) << " * "
+             << hex0x32(regs.get(rs2)) << " = " << hex0x32(val);
+    }
+
+    regs.set(rd, val);
+    pc += insn_size;
+}
+
+void rv32i_hart::exec_mulh(uint32_t insn, std::ostream* pos)
+{
+    uint32_t rd = get_rd(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+    int64_t rs1S = regs.get(rs1);
+    int64_t rs2S = regs.get(rs2);
+
+    uint32_t val = (rs1S * rs2S) >> 32;
+
+    if (pos)
+    {
+        trace_insn(pos, insn);
+        *pos << "// " << reg(rd) << " = (" << hex0x32(regs.get(rs1)) << " * "
+             << hex0x32(regs.get(rs2)) << ") >> 32 = " << hex0x32(val);
+    }
+
+    regs.set(rd, val);
+    pc += insn_size;
+}
+
+void rv32i_hart::exec_mulhsu(uint32_t insn, std::ostream* pos)
+{
+    uint32_t rd = get_rd(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+    int64_t rs1S = regs.get(rs1);
+    int64_t rs2U = static_cast<uint32_t>(regs.get(rs2));   // zero extended
+
+    uint32_t val = (rs1S * rs2U) >> 32;
+
+    if (pos)
+    {
+        trace_insn(pos, insn);
+        *pos << "// " << reg(rd) << " = (" << hex0x32(regs.get(rs1)) << " *SU "
+             << hex0x32(regs.get(rs2)) << ") >> 32 = " << hex0x32(val);
+    }
+
+    regs.set(rd, val);
+    pc += insn_size;
+}
+
+void rv32i_hart::exec_mulhu(uint32_t insn, std::ostream* pos)
+{
+    uint32_t rd = get_rd(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+    uint64_t rs1U = static_cast<uint32_t>(regs.get(rs1));
+    uint64_t rs2U = static_cast<uint32_t>(regs.get(rs2));
+
+    uint32_t val = (rs1U * rs2U) >> 32;
+
+    if (pos)
+    {
+        trace_insn(pos, insn);
+        *pos << "// " << reg(rd) << " = (" << hex0x32(regs.get(rs1)) << " *U "
+             << hex0x32(regs.get(rs2)) << ") >> 32 = " << hex0x32(val);
+    }
+
+    regs.set(rd, val);
+    pc += insn_size;
+}
+
+void rv32i_hart::exec_div(uint32_t insn, std::ostream* pos)
+{
+    uint32_t rd = get_rd(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+    int32_t rs1S = regs.get(rs1);
+    int32_t rs2S = regs.get(rs2);
+    int32_t val;
+
+    if (rs2S == 0)
+    {
+        val = -1;                       // Division by zero
+    }
+    else if (rs1S == INT32_MIN && rs2S == -1)
+    {
+        val = INT32_MIN;                // Signed overflow
+    }
+    else
+    {
+        val = rs1S / rs2S;
+    }
+
+    if (pos)
+    {
+        trace_insn(pos, insn);
+        *pos << "// " << reg(rd) << " = " << hex0x32(regs.get(rs1)) << " / "
+             << hex0x32(regs.get(rs2)) << " = " << hex0x32(val);
+    }
+
+    regs.set(rd, val);
+    pc += insn_size;
+}
+
+void rv32i_hart::exec_divu(uint32_t insn, std::ostream* pos)
+{
+    uint32_t rd = get_rd(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+    uint32_t rs1U = regs.get(rs1);
+    uint32_t rs2U = regs.get(rs2);
+
+    uint32_t val = (rs2U == 0) ? 0xffffffff : rs1U / rs2U;   // Division by zero gives all ones
+
+    if (pos)
+    {
+        trace_insn(pos, insn);
+        *pos << "// " << reg(rd) << " = " << hex0x32(regs.get(rs1)) << " /U "
+             << hex0x32(regs.get(rs2)) << " = " << hex0x32(val);
+    }
+
+    regs.set(rd, val);
+    pc += insn_size;
+}
+
+void rv32i_hart::exec_rem(uint32_t insn, std::ostream* pos)
+{
+    uint32_t rd = get_rd(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+    int32_t rs1S = regs.get(rs1);
+    int32_t rs2S = regs.get(rs2);
+    int32_t val;
+
+    if (rs2S == 0)
+    {
+        val = rs1S;                     // Division by zero
+    }
+    else if (rs1S == INT32_MIN && rs2S == -1)
+    {
+        val = 0;                        // Signed overflow
+    }
+    else
+    {
+        val = rs1S % rs2S;
+    }
+
+    if (pos)
+    {
+        trace_insn(pos, insn);
+        *pos << "// " << reg(rd) << " = " << hex0x32(regs.get(rs1)) << " % "
+             << hex0x32(regs.get(rs2)) << " = " << hex0x32(val);
+    }
+
+    regs.set(rd, val);
+    pc += insn_size;
+}
+
+void rv32i_hart::exec_remu(uint32_t insn, std::ostream* pos)
+{
+    uint32_t rd = get_rd(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t rs2 = get_rs2(insn);
+    uint32_t rs1U = regs.get(rs1);
+    uint32_t rs2U = regs.get(rs2);
+
+    uint32_t val = (rs2U == 0) ? rs1U : rs1U % rs2U;          // Division by zero gives the dividend
+
+    if (pos)
+    {
+        trace_insn(pos, insn);
+        *pos << "// " << reg(rd) << " = " << hex0x32(regs.get(rs1)) << " %U "
+             << hex0x32(regs.get(rs2)) << " = " << hex0x32(val);
+    }
+
+    regs.set(rd, val);
+    pc += insn_size;
+}
+
+/**
+ * exec_csr() executes the six CSR instructions.
+ *
+ * The old value of the CSR is written to rd. csrrw and csrrwi always
+ * write the CSR; the set and clear forms only write it when rs1 (or the
+ * immediate) is not zero. Accessing a CSR that does not exist, or
+ * writing a read-only one, halts the hart.
+ *
+ ********************************************************************************/
+
+void rv32i_hart::exec_csr(uint32_t insn, std::ostream* pos)
+{
+    uint32_t rd = get_rd(insn);
+    uint32_t rs1 = get_rs1(insn);
+    uint32_t csr = get_imm_i(insn) & 0x00000fff;
+    uint32_t funct3 = get_funct3(insn);
+
+    uint32_t src = (funct3 & 0x4) ? rs1 : regs.get(rs1);   // zimm or rs1
+    bool writes = (funct3 & 0x3) == 0x1 || rs1 != 0;
+
+    uint32_t old_val;
+    if (!csr_read(csr, old_val) || (writes && (csr >> 10) == 0x3))
+    {
+        std::string m = rv32i_isa::lookup(insn).mnemonic;
+        for (char &c : m)
+            c = toupper(c);
+
+        if (pos)
+        {
+            trace_insn(pos, insn);
+        }
         halt = true;
-        halt_reason = "Illegal CSR in CSRRS instruction";
+        halt_reason = "Illegal CSR in " + m + " instruction";
+        return;
     }
-    
+
+    uint32_t new_val = old_val;
+    switch (funct3 & 0x3)
+    {
+    case 0x1: new_val = src; break;
+    case 0x2: new_val = old_val | src; break;
+    case 0x3: new_val = old_val & ~src; break;
+    }
+
+    if (writes)
+    {
+        csr_write(csr, new_val);
+    }
+
     if (pos)
     {
-        std::string s = render_csrrx(insn, "csrrs   ");
-        *pos << to_hex32(pc) << ": " << to_hex32(insn) << "  ";
-        *pos << std::setw(instruction_width) << std::setfill(' ') << std::left << s;
-        *pos << "// " << render_reg(rd) << " = " << mhartid;
+        trace_insn(pos, insn);
+        *pos << "// " << reg(rd) << " = " << hex0x32(old_val);
+        if (writes)
+        {
+            uint32_t v;
+            csr_read(csr, v);
+            *pos << ",  " << hex0x12(csr) << " = " << hex0x32(v);
+        }
+    }
+
+    regs.set(rd, old_val);
+    pc += insn_size;
+}
+
+/**
+ * exec_mret() returns from a trap handler: pc = mepc and MIE is
+ * restored from MPIE.
+ *
+ ********************************************************************************/
+
+void rv32i_hart::exec_mret(uint32_t insn, std::ostream* pos)
+{
+    if (pos)
+    {
+        trace_insn(pos, insn);
+        *pos << "// pc = " << hex0x32(mepc);
+    }
+
+    mstatus = (mstatus & mstatus_mpie) ? (mstatus | mstatus_mie) : (mstatus & ~mstatus_mie);
+    mstatus |= mstatus_mpie;
+    pc = mepc;
+
+    check_interrupts();
+}
+
+/**
+ * exec_wfi() lets the hart wait for an interrupt. It is carried out as
+ * a no-op, which the specification allows.
+ *
+ ********************************************************************************/
+
+void rv32i_hart::exec_wfi(uint32_t insn, std::ostream* pos)
+{
+    if (pos)
+    {
+        trace_insn(pos, insn);
+        *pos << "// wait for interrupt";
+    }
+
+    pc += insn_size;
+}
+
+/**
+ * service_events() runs when the instruction count reaches next_event.
+ *
+ * Due events are taken from the queue and handled, then an enabled
+ * pending interrupt, if any, is taken before the next instruction.
+ * next_event is set to the due time of the earliest remaining event,
+ * so tick() does nothing more than one comparison until then.
+ *
+ ********************************************************************************/
+
+void rv32i_hart::service_events()
+{
+    uint32_t source;
+    while (events.pop_due(insn_counter, source))
+    {
+        if (source == ev_timer)
+            update_timer();
+    }
+
+    uint32_t pending = mip & mie;
+    if ((mstatus & mstatus_mie) && pending)
+    {
+        uint32_t code = (pending & mip_meip) ? 11 : (pending & mip_msip) ? 3 : 7;
+        uint32_t from = pc;
+
+        take_trap(0x80000000 | code, 0);
+
+        if (show_instructions)
+        {
+            std::cout << "-- interrupt " << hex0x32(mcause) << " at " << hex0x32(from)
+                      << ", pc = " << hex0x32(pc) << std::endl;
+        }
     }
 
-    regs.set(rd, mhartid);
-    pc += 4;
+    next_event = events.next_time();
+}
+
+/**
+ * update_timer() sets mip.MTIP and mip.MSIP from the CLINT. If mtime has
+ * not reached mtimecmp yet, a timer event is queued for the instruction
+ * count at which it will.
+ *
+ ********************************************************************************/
+
+void rv32i_hart::update_timer()
+{
+    events.cancel(ev_timer);
+    mip &= ~(mip_mtip | mip_msip);
+
+    if (!timer)
+        return;
+
+    if (timer->get_msip())
+        mip |= mip_msip;
+
+    uint64_t mtime = timer->get_mtime();
+    uint64_t mtimecmp = timer->get_mtimecmp();
+
+    if (mtime >= mtimecmp)
+        mip |= mip_mtip;
+    else if (mtimecmp - mtime < event_queue::never - insn_counter)
+        events.schedule(ev_timer, insn_counter + (mtimecmp - mtime));
+}
+
+/**
+ * clint_changed() is called by the CLINT when msip, mtimecmp or mtime is
+ * written, and re-evaluates the timer before the next instruction.
+ *
+ ********************************************************************************/
+
+void rv32i_hart::clint_changed()
+{
+    events.schedule(ev_timer, insn_counter);
+    check_interrupts();
+}
+
+/**
+ * take_trap() enters the trap handler at mtvec.
+ *
+ * @param cause The mcause value. Interrupts have bit 31 set and, when
+ *        mtvec is in vectored mode, go to mtvec + 4*cause.
+ * @param tval The mtval value.
+ *
+ ********************************************************************************/
+
+void rv32i_hart::take_trap(uint32_t cause, uint32_t tval)
+{
+    mepc = pc;
+    mcause = cause;
+    mtval = tval;
+
+    mstatus = (mstatus & mstatus_mie) ? (mstatus | mstatus_mpie) : (mstatus & ~mstatus_mpie);
+    mstatus &= ~mstatus_mie;
+
+    pc = mtvec & ~0x3u;
+    if ((mtvec & 0x1) && (cause & 0x80000000))
+        pc += 4 * (cause & 0x7fffffff);
+
+    spin_break();
+}
+
+/**
+ * step() is tick() for loops that step a hart on its own: a guest access
+ * fault (guard page builds) during it is passed to access_fault().
+ *
+ ********************************************************************************/
+
+void rv32i_hart::step()
+{
+    sigjmp_buf faulted;
+    memory::fault_scope scope(faulted);
+    if (sigsetjmp(faulted, 0) == 0)
+        tick();
+    else
+        access_fault(memory::get_fault_addr());
+}
+
+/**
+ * access_fault() is called by the run loop when a load or store of the
+ * instruction at pc fell outside RAM in a guard page build. Once mtvec is
+ * set it traps, as ECALL does, with mcause 5 (load) or 7 (store) and
+ * mtval = addr; otherwise the hart halts.
+ *
+ * The instruction is found again from memory; for a fused pair pc is
+ * already at the second instruction, the one accessing memory.
+ *
+ ********************************************************************************/
+
+void rv32i_hart::access_fault(uint32_t addr)
+{
+    uint32_t insn = 0;
+    uint8_t size = 4;
+    bool store = rv32i_predecode::fetch(mem, pc, rvc, insn, size)
+              && rv32i_isa::lookup(insn).fmt == rv32i_isa::fmt_s;
+
+    spin_break();
+    if (mtvec != 0)
+    {
+        take_trap(store ? 7 : 5, addr);
+        return;
+    }
+
+    halt = true;
+    halt_reason = std::string(store ? "Store" : "Load") + " access fault at " + to_hex0x32(addr);
+}
+
+/**
+ * csr_read() reads a CSR.
+ *
+ * @return false if the CSR does not exist.
+ *
+ ********************************************************************************/
+
+bool rv32i_hart::csr_read(uint32_t csr, uint32_t &val) const
+{
+    uint64_t time = timer ? timer->get_mtime() : insn_counter;
+
+    switch (csr)
+    {
+    case csr_mstatus: val = mstatus | mstatus_mpp; return true;
+    case csr_misa: val = 0x40001100 | (rvc ? 0x4 : 0); return true;     // RV32IM(C)
+    case csr_mie: val = mie; return true;
+    case csr_mtvec: val = mtvec; return true;
+    case csr_mscratch: val = mscratch; return true;
+    case csr_mepc: val = mepc; return true;
+    case csr_mcause: val = mcause; return true;
+    case csr_mtval: val = mtval; return true;
+    case csr_mip: val = mip; return true;
+
+    case csr_mcycle:
+    case csr_minstret:
+    case csr_cycle:
+    case csr_instret: val = insn_counter; return true;
+    case csr_mcycleh:
+    case csr_minstreth:
+    case csr_cycleh:
+    case csr_instreth: val = insn_counter >> 32; return true;
+    case csr_time: val = time; return true;
+    case csr_timeh: val = time >> 32; return true;
+
+    case csr_mvendorid:
+    case csr_marchid:
+    case csr_mimpid: val = 0; return true;
+    case csr_mhartid: val = mhartid; return true;
+
+    default: return false;
+    }
+}
+
+/**
+ * csr_write() writes a CSR that csr_read() knows. Read-only fields keep
+ * their values; mcycle and minstret follow the instruction counter and
+ * ignore writes. Changes to mstatus and mie are checked for a pending
+ * interrupt before the next instruction.
+ *
+ ********************************************************************************/
+
+void rv32i_hart::csr_write(uint32_t csr, uint32_t val)
+{
+    switch (csr)
+    {
+    case csr_mstatus:
+        mstatus = val & (mstatus_mie | mstatus_mpie);
+        check_interrupts();
+        break;
+
+    case csr_mie:
+        mie = val & (mip_msip | mip_mtip | mip_meip);
+        check_interrupts();
+        break;
+
+    case csr_mtvec: mtvec = val & ~0x2u; break;
+    case csr_mscratch: mscratch = val; break;
+    case csr_mepc: mepc = val & (rvc ? ~0x1u : ~0x3u); break;
+    case csr_mcause: mcause = val; break;
+    case csr_mtval: mtval = val; break;
+    default: break;
+    }
 }
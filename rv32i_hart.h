@@ -9,34 +9,178 @@
 #define H_RV32I_HART
 
 #include "rv32i_decode.h"
+#include "rv32i_predecode.h"
+#include "rv32i_idiom.h"
 #include "memory.h"
+#include "soft_tlb.h"
 #include "registerfile.h"
+#include "syscall_proxy.h"
+#include "hle.h"
+#include "event_queue.h"
 #include <string>
 #include <iostream>
 #include <iomanip>
 
+class clint;
+class rv32i_cfg;
+
 class rv32i_hart : public rv32i_decode
 {
 public:
-    rv32i_hart(memory &m) : mem(m) { }
+    static constexpr uint32_t csr_mstatus = 0x300;
+    static constexpr uint32_t csr_misa = 0x301;
+    static constexpr uint32_t csr_mie = 0x304;
+    static constexpr uint32_t csr_mtvec = 0x305;
+    static constexpr uint32_t csr_mscratch = 0x340;
+    static constexpr uint32_t csr_mepc = 0x341;
+    static constexpr uint32_t csr_mcause = 0x342;
+    static constexpr uint32_t csr_mtval = 0x343;
+    static constexpr uint32_t csr_mip = 0x344;
+    static constexpr uint32_t csr_mcycle = 0xb00;
+    static constexpr uint32_t csr_minstret = 0xb02;
+    static constexpr uint32_t csr_mcycleh = 0xb80;
+    static constexpr uint32_t csr_minstreth = 0xb82;
+    static constexpr uint32_t csr_cycle = 0xc00;
+    static constexpr uint32_t csr_time = 0xc01;
+    static constexpr uint32_t csr_instret = 0xc02;
+    static constexpr uint32_t csr_cycleh = 0xc80;
+    static constexpr uint32_t csr_timeh = 0xc81;
+    static constexpr uint32_t csr_instreth = 0xc82;
+    static constexpr uint32_t csr_mvendorid = 0xf11;
+    static constexpr uint32_t csr_marchid = 0xf12;
+    static constexpr uint32_t csr_mimpid = 0xf13;
+    static constexpr uint32_t csr_mhartid = 0xf14;
+
+    static constexpr uint32_t mstatus_mie = 0x00000008;
+    static constexpr uint32_t mstatus_mpie = 0x00000080;
+    static constexpr uint32_t mstatus_mpp = 0x00001800;     ///< Always machine mode.
+
+    static constexpr uint32_t mip_msip = 0x00000008;
+    static constexpr uint32_t mip_mtip = 0x00000080;
+    static constexpr uint32_t mip_meip = 0x00000800;
+
+    rv32i_hart(memory &m) : tlb(m), mem(m) { }
     void set_show_instructions(bool b) { show_instructions = b; }
     void set_show_registers(bool b) { show_registers = b; }
     bool is_halted() const { return halt; }
     void set_halt(bool b) { halt = b; }
     const std::string &get_halt_reason() const { return halt_reason; }
+    void set_halt_reason(const std::string &s) { halt_reason = s; }
     uint64_t get_insn_counter() const { return insn_counter; }
+    uint32_t get_pc() const { return pc; }
+    int32_t get_reg(uint32_t r) const { return regs.get(r); }
+    void set_reg(uint32_t r, int32_t val) { regs.set(r, val); }
+    void set_insn_counter(uint64_t n) { insn_counter = n; }
     void set_mhartid(int i) { mhartid = i; }
+    void set_rvc(bool b) { rvc = b; }
+    void set_syscall_proxy(syscall_proxy *p) { syscalls = p; }
+    void set_hle(hle *h) { hle_calls = h; }
+    void set_pc(uint32_t addr) { pc = addr; }
+    void flush_output() { if (syscalls) syscalls->flush(); }
+    void set_clint(const clint *c) { timer = c; clint_changed(); }
+    void set_fast_path(bool b) { fast_path = b; }
+    void set_fusion(bool b) { fusion = b; }
+    void set_chaining(bool b) { chaining = b; }
+    void set_fast_forward(bool b) { fast_forward = b; }
+    void set_insn_limit(uint64_t n) { insn_limit = n ? n : event_queue::never; }
+
+    /// 1 << coverage_bits counters, one per hashed branch or jump edge, bumped
+    /// by the interpreter (not the fast path) while a map is attached.
+    static constexpr uint32_t coverage_bits = 16;
+    void set_coverage(uint8_t *map) { coverage = map; }
+    void clint_changed();
+    void pretranslate(const rv32i_cfg &cfg);
+    void access_fault(uint32_t addr);
 
     void tick(const std::string &hdr ="");
+    void step();
     void dump(const std::string &hdr ="") const;
     void reset();
+    void snapshot();
+    bool reset_to_snapshot();
 
 private:
     static constexpr int instruction_width = 35;
+    uint32_t fetch_rvc();
+    bool exec_fast();
+    void fill_uop(rv32i_predecode::uop &u, uint32_t at);
+    bool exec_uop(const rv32i_predecode::uop &u);
+    void exec_fused(const rv32i_predecode::uop &u);
+    bool run_idiom(uint32_t from);
+    void check_spin();
+    void run_hle();
+    void spin_break() { spin_pc = 0xffffffff; }
+
+    void cover(uint32_t from, uint32_t to)
+    {
+        if (coverage)
+            ++coverage[((from * 0x9e3779b1u) ^ (to * 0x85ebca6bu)) >> (32 - coverage_bits)];
+    }
+
+    /// Guest loads, stores and fetches, straight to host memory on a TLB hit.
+    uint8_t load8(uint32_t addr)
+    {
+        const uint8_t *p = tlb.lookup(addr, 1, memory::access_read);
+        return p ? p[0] : mem.get8(addr);
+    }
+    uint16_t load16(uint32_t addr)
+    {
+        const uint8_t *p = tlb.lookup(addr, 2, memory::access_read);
+        return p ? p[0] | (p[1] << 8) : mem.get16(addr);
+    }
+    uint32_t load32(uint32_t addr)
+    {
+        const uint8_t *p = tlb.lookup(addr, 4, memory::access_read);
+        return p ? p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24) : mem.get32(addr);
+    }
+    void store8(uint32_t addr, uint8_t val)
+    {
+        uint8_t *p = tlb.lookup(addr, 1, memory::access_write);
+        if (p)
+            p[0] = val;
+        else
+            mem.set8(addr, val);
+    }
+    void store16(uint32_t addr, uint16_t val)
+    {
+        uint8_t *p = tlb.lookup(addr, 2, memory::access_write);
+        if (!p)
+        {
+            mem.set16(addr, val);
+            return;
+        }
+        p[0] = val;
+        p[1] = val >> 8;
+    }
+    void store32(uint32_t addr, uint32_t val)
+    {
+        uint8_t *p = tlb.lookup(addr, 4, memory::access_write);
+        if (!p)
+        {
+            mem.set32(addr, val);
+            return;
+        }
+        p[0] = val;
+        p[1] = val >> 8;
+        p[2] = val >> 16;
+        p[3] = val >> 24;
+    }
+    uint16_t fetch16(uint32_t addr)
+    {
+        const uint8_t *p = tlb.lookup(addr, 2, memory::access_fetch);
+        return p ? p[0] | (p[1] << 8) : mem.peek16(addr);
+    }
+    uint32_t fetch32(uint32_t addr)
+    {
+        const uint8_t *p = tlb.lookup(addr, 4, memory::access_fetch);
+        return p ? p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24) : mem.peek32(addr);
+    }
+
+    void trace_insn(std::ostream *pos, uint32_t insn) const;
     void exec(uint32_t insn, std::ostream*);
     void exec_illegal_insn(std::ostream*);
     void exec_ebreak(int32_t insn, std::ostream*);
-    void exec_ecall(std::ostream*);
+    void exec_ecall(uint32_t insn, std::ostream*);
     void exec_lui(uint32_t insn, std::ostream*);
     void exec_auipc(uint32_t insn, std::ostream*);
     void exec_jal(uint32_t insn, std::ostream*);
@@ -74,7 +218,26 @@ private:
     void exec_sra(uint32_t insn, std::ostream*);
     void exec_or(uint32_t insn, std::ostream*);
     void exec_and(uint32_t insn, std::ostream*);
-    void exec_csrrs(uint32_t insn, std::ostream*);
+    void exec_mul(uint32_t insn, std::ostream*);
+    void exec_mulh(uint32_t insn, std::ostream*);
+    void exec_mulhsu(uint32_t insn, std::ostream*);
+    void exec_mulhu(uint32_t insn, std::ostream*);
+    void exec_div(uint32_t insn, std::ostream*);
+    void exec_divu(uint32_t insn, std::ostream*);
+    void exec_rem(uint32_t insn, std::ostream*);
+    void exec_remu(uint32_t insn, std::ostream*);
+    void exec_csr(uint32_t insn, std::ostream*);
+    void exec_mret(uint32_t insn, std::ostream*);
+    void exec_wfi(uint32_t insn, std::ostream*);
+
+    enum event_source { ev_timer, ev_source_count };
+
+    void service_events();
+    void update_timer();
+    void take_trap(uint32_t cause, uint32_t tval);
+    void check_interrupts() { if (next_event > insn_counter) next_event = insn_counter; }
+    bool csr_read(uint32_t csr, uint32_t &val) const;
+    void csr_write(uint32_t csr, uint32_t val);
     
     bool halt = { false };
     std::string halt_reason = { "none" };
@@ -87,6 +250,75 @@ private:
     uint32_t pc = { 0 };
     uint32_t mhartid = { 0 };
 
+    syscall_proxy *syscalls = { nullptr };   ///< Performs ECALLs when set.
+    hle *hle_calls = { nullptr };       ///< Runs bound library functions when set.
+    uint8_t *coverage = { nullptr };    ///< Edge counters, see set_coverage().
+
+    uint32_t mstatus = { 0 };
+    uint32_t mie = { 0 };
+    uint32_t mip = { 0 };
+    uint32_t mtvec = { 0 };
+    uint32_t mscratch = { 0 };
+    uint32_t mepc = { 0 };
+    uint32_t mcause = { 0 };
+    uint32_t mtval = { 0 };
+
+    const clint *timer = { nullptr };   ///< Source of mtime, mtimecmp and msip.
+    event_queue events = event_queue(ev_source_count);
+    uint64_t next_event = { 0 };        ///< tick() services events from here on.
+
+    bool rvc = { false };
+    uint32_t insn_size = { 4 };         ///< Length of the insn being executed.
+
+    struct rvc_entry
+    {
+        uint32_t pc = { 0xffffffff };   ///< Odd, so it never matches a fetch.
+        uint16_t parcel = { 0 };
+        uint32_t insn = { 0 };
+    };
+    static constexpr uint32_t rvc_cache_size = 1024;
+    std::vector<rvc_entry> rvc_cache = std::vector<rvc_entry>(rvc_cache_size);
+
+    bool fast_path = { false };         ///< Run predecoded uops when not tracing.
+    bool fusion = { true };             ///< Let the fast path retire fused pairs.
+    bool chaining = { true };           ///< Let the fast path run uops without returning to tick().
+    uint64_t insn_limit = { event_queue::never };   ///< Fused pairs stop short of this.
+    static constexpr uint32_t uop_cache_size = 4096;
+    std::vector<rv32i_predecode::uop> uop_cache = std::vector<rv32i_predecode::uop>(uop_cache_size);
+
+    bool fast_forward = { true };       ///< Let the fast path skip idle loops and bulk-run copy loops.
+    static constexpr uint32_t idiom_cache_size = 256;
+    std::vector<rv32i_idiom::loop> idiom_cache = std::vector<rv32i_idiom::loop>(idiom_cache_size);
+    static constexpr uint64_t spin_max = 64;    ///< Longest iteration checked for idling.
+    uint32_t spin_pc = { 0xffffffff };  ///< Target of the last backward jump, odd if none.
+    uint64_t spin_count = { 0 };        ///< insn_counter when it was last reached.
+    uint32_t spin_io = { 0 };
+    bool spin_saved = { false };        ///< spin_regs holds the state it was reached with.
+    uint32_t spin_skip = { 0 };         ///< Visits to let pass before the next snapshot.
+    uint32_t spin_backoff = { 0 };      ///< Grows while loops turn out not to be idle.
+    registerfile spin_regs;
+
+    soft_tlb tlb;                       ///< Host pages for loads, stores and fetches.
+
+    /// The hart state snapshot() saves along with the memory.
+    struct saved_state
+    {
+        registerfile regs;
+        uint32_t pc = { 0 };
+        uint64_t insn_counter = { 0 };
+        uint32_t mstatus = { 0 };
+        uint32_t mie = { 0 };
+        uint32_t mip = { 0 };
+        uint32_t mtvec = { 0 };
+        uint32_t mscratch = { 0 };
+        uint32_t mepc = { 0 };
+        uint32_t mcause = { 0 };
+        uint32_t mtval = { 0 };
+        event_queue events = event_queue(ev_source_count);
+        uint64_t next_event = { 0 };
+    };
+    saved_state saved;
+
 protected:
     registerfile regs;
     memory &mem;
@@ -0,0 +1,150 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#include "rv32i_idiom.h"
+
+/**
+ * step_of() is how much register r changes by each iteration.
+ *
+ ********************************************************************************/
+
+int32_t rv32i_idiom::loop::step_of(uint32_t r) const
+{
+    for (uint32_t i = 0; i < steps; ++i)
+    {
+        if (step_reg[i] == r)
+            return step[i];
+    }
+    return 0;
+}
+
+/**
+ * recognize() checks whether the loop from head to the backward branch
+ * at branch_pc is a copy or fill loop.
+ *
+ * @param mem The memory holding the code.
+ * @param head The branch target, where the body starts.
+ * @param branch_pc The address of the branch that closes the loop.
+ * @param rvc True if compressed instructions are enabled.
+ *
+ * @return The loop, of kind none if it is not one of the idioms.
+ *
+ ********************************************************************************/
+
+rv32i_idiom::loop rv32i_idiom::recognize(const memory &mem, uint32_t head, uint32_t branch_pc, bool rvc)
+{
+    loop l;
+    l.branch_pc = branch_pc;
+    l.head = head;
+
+    if (branch_pc < head || uint64_t(branch_pc) + 4 > mem.get_size()
+        || (branch_pc + 4 - head + 3) / 4 > max_body)
+    {
+        return l;
+    }
+
+    int32_t so_far[32] = { };           // steps taken so far in the body
+    uint32_t written = 0;               // one bit per register written in the body
+    bool loaded = false;
+    bool stored = false;
+    uint32_t load_width = 0;
+    uint32_t pc = head;
+
+    while (true)
+    {
+        rv32i_predecode::uop u = rv32i_predecode::predecode(mem, pc, rvc);
+        if (u.size2 || ++l.count > max_body)
+            return l;
+
+        if (pc == branch_pc)
+        {
+            if ((u.op != rv32i_isa::id_bne && u.op != rv32i_isa::id_blt && u.op != rv32i_isa::id_bltu)
+                || pc + u.imm != head)
+            {
+                return l;
+            }
+            l.branch_op = u.op;
+            l.a = u.rs1;
+            l.b = u.rs2;
+            l.branch_size = u.size;
+            break;
+        }
+
+        switch (u.op)
+        {
+            case rv32i_isa::id_lb:
+            case rv32i_isa::id_lbu:
+            case rv32i_isa::id_lh:
+            case rv32i_isa::id_lhu:
+            case rv32i_isa::id_lw:
+                if (loaded || stored || u.rd == 0 || (written & (1u << u.rd)))
+                    return l;
+                loaded = true;
+                l.load_op = u.op;
+                load_width = (u.op == rv32i_isa::id_lw) ? 4 : (u.op == rv32i_isa::id_lh || u.op == rv32i_isa::id_lhu) ? 2 : 1;
+                l.value = u.rd;
+                l.src = u.rs1;
+                l.src_off = u.imm + so_far[u.rs1];
+                written |= 1u << u.rd;
+                break;
+
+            case rv32i_isa::id_sb:
+            case rv32i_isa::id_sh:
+            case rv32i_isa::id_sw:
+                if (stored)
+                    return l;
+                stored = true;
+                l.width = (u.op == rv32i_isa::id_sw) ? 4 : (u.op == rv32i_isa::id_sh) ? 2 : 1;
+                if (loaded && u.rs2 != l.value)
+                    return l;
+                l.value = u.rs2;
+                l.dst = u.rs1;
+                l.dst_off = u.imm + so_far[u.rs1];
+                break;
+
+            case rv32i_isa::id_addi:
+                if (u.rd == 0 || u.rd != u.rs1 || (written & (1u << u.rd)) || l.steps == max_steps)
+                    return l;
+                l.step_reg[l.steps] = u.rd;
+                l.step[l.steps++] = u.imm;
+                so_far[u.rd] += u.imm;
+                written |= 1u << u.rd;
+                break;
+
+            default:
+                return l;
+        }
+
+        pc += u.size;
+        if (pc > branch_pc)
+            return l;
+    }
+
+    if (!stored)
+        return l;
+
+    int32_t w = l.width;
+    int32_t dst_step = l.step_of(l.dst);
+    if (dst_step != w && dst_step != -w)
+        return l;
+
+    if (loaded)
+    {
+        if (load_width != l.width || l.step_of(l.src) != dst_step
+            || l.a == l.value || l.b == l.value)
+        {
+            return l;
+        }
+    }
+    else if (written & (1u << l.value))
+    {
+        return l;
+    }
+
+    l.kind = loaded ? copy : fill;
+    return l;
+}
@@ -0,0 +1,69 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#ifndef H_RV32I_IDIOM
+#define H_RV32I_IDIOM
+
+#include "rv32i_predecode.h"
+#include "memory.h"
+
+/**
+ * rv32i_idiom recognizes loops that copy or fill memory one element at
+ * a time, so that the fast path can carry out many iterations at once
+ * with a single host memory operation.
+ *
+ * The body must be straight-line code ending in the backward branch:
+ *
+ *     lb/lbu/lh/lhu/lw  t,off(src)        copy only
+ *     sb/sh/sw          t,off(dst)        fill: t is not written in the loop
+ *     addi              r,r,step          any number, one per register
+ *     bne/blt/bltu      a,b,head
+ *
+ * in any order, with the store after the load. src and dst must step by
+ * the element width, up or down. The branch operands must each either
+ * step or not be written in the loop.
+ *
+ ********************************************************************************/
+
+class rv32i_idiom
+{
+public:
+    enum kind_t : uint8_t { none, copy, fill };
+
+    static constexpr uint32_t max_body = 8;     ///< Most instructions in a loop.
+    static constexpr uint32_t max_steps = 4;    ///< Most addi registers in a loop.
+
+    struct loop
+    {
+        uint32_t branch_pc = { 0xffffffff };    ///< Odd, so it never matches a branch.
+        uint32_t head = { 0 };
+        uint32_t gen = { 0 };           ///< memory::get_code_gen() of the loop when recognized.
+        uint8_t kind = { none };
+        uint8_t count = { 0 };          ///< Instructions in the body, branch included.
+        uint8_t branch_size = { 4 };
+        uint8_t width = { 0 };          ///< Bytes stored per iteration.
+        uint8_t load_op = { 0 };        ///< copy: insn_id of the load.
+        uint8_t value = { 0 };          ///< The stored register.
+        uint8_t src = { 0 };            ///< copy: base register of the load.
+        uint8_t dst = { 0 };            ///< Base register of the store.
+        int32_t src_off = { 0 };        ///< Load address minus src at head, first iteration.
+        int32_t dst_off = { 0 };        ///< Store address minus dst at head, first iteration.
+        uint8_t branch_op = { 0 };
+        uint8_t a = { 0 };              ///< Branch operands.
+        uint8_t b = { 0 };
+        uint8_t steps = { 0 };
+        uint8_t step_reg[max_steps] = { };
+        int32_t step[max_steps] = { };  ///< Added to step_reg each iteration.
+
+        int32_t step_of(uint32_t r) const;
+        uint32_t size() const { return branch_pc + branch_size - head; }
+    };
+
+    static loop recognize(const memory &mem, uint32_t head, uint32_t branch_pc, bool rvc);
+};
+
+#endif
@@ -0,0 +1,295 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#ifndef H_RV32I_ISA
+#define H_RV32I_ISA
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * rv32i_isa is the instruction set as compile-time data.
+ *
+ * Every supported instruction has one row in a table giving its
+ * mask/match encoding, an id, its mnemonic and its operand format. The
+ * decoder, the disassembler and the hart all classify instructions with
+ * lookup() and then switch on the id or format, so the opcode, funct3
+ * and funct7 values are only written down here.
+ *
+ * lookup() indexes a dense 2048-entry map, built from the table at
+ * compile time, with the opcode, funct3 and instruction bits 30, 25 and
+ * 20. Those bits tell every table row apart except a few SYSTEM
+ * encodings; the row found is confirmed with its mask/match and a miss
+ * falls back to a scan of the table.
+ *
+ ********************************************************************************/
+
+class rv32i_isa
+{
+public:
+    enum insn_id : uint8_t
+    {
+        id_illegal,
+        id_lui, id_auipc, id_jal, id_jalr,
+        id_beq, id_bne, id_blt, id_bge, id_bltu, id_bgeu,
+        id_lb, id_lh, id_lw, id_lbu, id_lhu,
+        id_sb, id_sh, id_sw,
+        id_addi, id_slti, id_sltiu, id_xori, id_ori, id_andi,
+        id_slli, id_srli, id_srai,
+        id_add, id_sub, id_sll, id_slt, id_sltu, id_xor, id_srl, id_sra, id_or, id_and,
+        id_mul, id_mulh, id_mulhsu, id_mulhu, id_div, id_divu, id_rem, id_remu,
+        id_ecall, id_ebreak, id_mret, id_wfi,
+        id_csrrw, id_csrrs, id_csrrc, id_csrrwi, id_csrrsi, id_csrrci,
+        id_count
+    };
+
+    enum insn_format : uint8_t
+    {
+        fmt_none,       ///< No operands (illegal, ecall, ebreak, mret, wfi).
+        fmt_u,          ///< rd,imm20
+        fmt_j,          ///< rd,target
+        fmt_jalr,       ///< rd,imm(rs1)
+        fmt_b,          ///< rs1,rs2,target
+        fmt_load,       ///< rd,imm(rs1)
+        fmt_s,          ///< rs2,imm(rs1)
+        fmt_i,          ///< rd,rs1,imm
+        fmt_shift,      ///< rd,rs1,shamt
+        fmt_r,          ///< rd,rs1,rs2
+        fmt_csr,        ///< rd,csr,rs1
+        fmt_csri        ///< rd,csr,zimm
+    };
+
+    struct insn_info
+    {
+        uint32_t mask;
+        uint32_t match;
+        insn_id id;
+        const char *mnemonic;
+        insn_format fmt;
+    };
+
+    static constexpr uint32_t get_opcode(uint32_t insn) { return insn & 0x0000007f; }
+    static constexpr uint32_t get_rd(uint32_t insn) { return (insn & 0x00000f80) >> 7; }
+    static constexpr uint32_t get_funct3(uint32_t insn) { return (insn & 0x00007000) >> 12; }
+    static constexpr uint32_t get_rs1(uint32_t insn) { return (insn & 0x000f8000) >> 15; }
+    static constexpr uint32_t get_rs2(uint32_t insn) { return (insn & 0x01f00000) >> 20; }
+    static constexpr uint32_t get_funct7(uint32_t insn) { return (insn & 0xfe000000) >> 25; }
+
+    static constexpr int32_t get_imm_i(uint32_t insn)
+    {
+        return static_cast<int32_t>(insn) >> 20;
+    }
+
+    static constexpr int32_t get_imm_u(uint32_t insn)
+    {
+        return insn & 0xfffff000;
+    }
+
+    static constexpr int32_t get_imm_b(uint32_t insn)
+    {
+        return ((static_cast<int32_t>(insn) >> (31-12)) & 0xfffff000)   // a, sign-extended
+             | ((insn & 0x7e000000) >> (25-5))                          // b, c, d, e, f, g
+             | ((insn & 0x00000f00) >> (8-1))                           // u, v, w, x
+             | ((insn & 0x00000080) << (11-7));                         // y
+    }
+
+    static constexpr int32_t get_imm_s(uint32_t insn)
+    {
+        return ((static_cast<int32_t>(insn) >> (25-5)) & 0xffffffe0)    // abcdefg, sign-extended
+             | ((insn & 0x00000f80) >> (7-0));                          // uvwxy
+    }
+
+    static constexpr int32_t get_imm_j(uint32_t insn)
+    {
+        return ((static_cast<int32_t>(insn) >> (31-20)) & 0xfff00000)   // a, sign-extended
+             | (insn & 0x000ff000)                                      // mnopqrst
+             | ((insn & 0x00100000) >> (20-11))                         // l
+             | ((insn & 0x7fe00000) >> (21-1));                         // bcdefghijk
+    }
+
+    /// The dispatch key: opcode[6:2], funct3, bit 30, bit 25, bit 20.
+    static constexpr uint32_t key(uint32_t insn)
+    {
+        return ((insn >> 2) & 0x1f) << 6 | ((insn >> 12) & 0x7) << 3
+             | ((insn >> 30) & 1) << 2 | ((insn >> 25) & 1) << 1 | ((insn >> 20) & 1);
+    }
+
+    /// The M extension results, with the spec's values for division by zero and overflow.
+    static constexpr uint32_t mulh(uint32_t a, uint32_t b) { return (int64_t(int32_t(a)) * int32_t(b)) >> 32; }
+    static constexpr uint32_t mulhsu(uint32_t a, uint32_t b) { return (int64_t(int32_t(a)) * int64_t(b)) >> 32; }
+    static constexpr uint32_t mulhu(uint32_t a, uint32_t b) { return (uint64_t(a) * b) >> 32; }
+
+    static constexpr uint32_t div(uint32_t a, uint32_t b)
+    {
+        return b == 0 ? 0xffffffff
+             : (a == 0x80000000 && b == 0xffffffff) ? a
+             : uint32_t(int32_t(a) / int32_t(b));
+    }
+
+    static constexpr uint32_t rem(uint32_t a, uint32_t b)
+    {
+        return b == 0 ? a
+             : (a == 0x80000000 && b == 0xffffffff) ? 0
+             : uint32_t(int32_t(a) % int32_t(b));
+    }
+
+    static constexpr uint32_t divu(uint32_t a, uint32_t b) { return b ? a / b : 0xffffffff; }
+    static constexpr uint32_t remu(uint32_t a, uint32_t b) { return b ? a % b : a; }
+
+    static constexpr uint32_t key_bits = 0x4210707c;    ///< The insn bits key() looks at.
+    static constexpr uint32_t key_count = 2048;
+
+    static const insn_info &lookup(uint32_t insn);
+    static const insn_info &info(insn_id id);
+
+private:
+    struct dispatch_map
+    {
+        uint8_t row[key_count];
+    };
+
+    template <typename T> struct tables;
+
+    static constexpr uint32_t insn_for_key(uint32_t k)
+    {
+        return 0x3 | ((k >> 6) & 0x1f) << 2 | ((k >> 3) & 0x7) << 12
+             | ((k >> 2) & 1) << 30 | ((k >> 1) & 1) << 25 | (k & 1) << 20;
+    }
+
+    static constexpr dispatch_map make_dispatch(const insn_info *rows, size_t n)
+    {
+        dispatch_map m = {};
+        for (uint32_t k = 0; k < key_count; ++k)
+        {
+            uint32_t insn = insn_for_key(k);
+            for (size_t i = 1; i < n; ++i)
+            {
+                uint32_t mask = rows[i].mask & key_bits;
+                if ((insn & mask) == (rows[i].match & mask))
+                {
+                    m.row[k] = i;
+                    break;
+                }
+            }
+        }
+        return m;
+    }
+};
+
+/**
+ * The table rows, in insn_id order. Row 0 is the illegal instruction and
+ * matches nothing.
+ *
+ ********************************************************************************/
+
+template <typename T>
+struct rv32i_isa::tables
+{
+    static constexpr insn_info rows[id_count] =
+    {
+        { 0x00000000, 0xffffffff, id_illegal, "illegal", fmt_none },
+
+        { 0x0000007f, 0x00000037, id_lui,    "lui",    fmt_u },
+        { 0x0000007f, 0x00000017, id_auipc,  "auipc",  fmt_u },
+        { 0x0000007f, 0x0000006f, id_jal,    "jal",    fmt_j },
+        { 0x0000707f, 0x00000067, id_jalr,   "jalr",   fmt_jalr },
+
+        { 0x0000707f, 0x00000063, id_beq,    "beq",    fmt_b },
+        { 0x0000707f, 0x00001063, id_bne,    "bne",    fmt_b },
+        { 0x0000707f, 0x00004063, id_blt,    "blt",    fmt_b },
+        { 0x0000707f, 0x00005063, id_bge,    "bge",    fmt_b },
+        { 0x0000707f, 0x00006063, id_bltu,   "bltu",   fmt_b },
+        { 0x0000707f, 0x00007063, id_bgeu,   "bgeu",   fmt_b },
+
+        { 0x0000707f, 0x00000003, id_lb,     "lb",     fmt_load },
+        { 0x0000707f, 0x00001003, id_lh,     "lh",     fmt_load },
+        { 0x0000707f, 0x00002003, id_lw,     "lw",     fmt_load },
+        { 0x0000707f, 0x00004003, id_lbu,    "lbu",    fmt_load },
+        { 0x0000707f, 0x00005003, id_lhu,    "lhu",    fmt_load },
+
+        { 0x0000707f, 0x00000023, id_sb,     "sb",     fmt_s },
+        { 0x0000707f, 0x00001023, id_sh,     "sh",     fmt_s },
+        { 0x0000707f, 0x00002023, id_sw,     "sw",     fmt_s },
+
+        { 0x0000707f, 0x00000013, id_addi,   "addi",   fmt_i },
+        { 0x0000707f, 0x00002013, id_slti,   "slti",   fmt_i },
+        { 0x0000707f, 0x00003013, id_sltiu,  "sltiu",  fmt_i },
+        { 0x0000707f, 0x00004013, id_xori,   "xori",   fmt_i },
+        { 0x0000707f, 0x00006013, id_ori,    "ori",    fmt_i },
+        { 0x0000707f, 0x00007013, id_andi,   "andi",   fmt_i },
+
+        { 0xfe00707f, 0x00001013, id_slli,   "slli",   fmt_shift },
+        { 0xfe00707f, 0x00005013, id_srli,   "srli",   fmt_shift },
+        { 0xfe00707f, 0x40005013, id_srai,   "srai",   fmt_shift },
+
+        { 0xfe00707f, 0x00000033, id_add,    "add",    fmt_r },
+        { 0xfe00707f, 0x40000033, id_sub,    "sub",    fmt_r },
+        { 0xfe00707f, 0x00001033, id_sll,    "sll",    fmt_r },
+        { 0xfe00707f, 0x00002033, id_slt,    "slt",    fmt_r },
+        { 0xfe00707f, 0x00003033, id_sltu,   "sltu",   fmt_r },
+        { 0xfe00707f, 0x00004033, id_xor,    "xor",    fmt_r },
+        { 0xfe00707f, 0x00005033, id_srl,    "srl",    fmt_r },
+        { 0xfe00707f, 0x40005033, id_sra,    "sra",    fmt_r },
+        { 0xfe00707f, 0x00006033, id_or,     "or",     fmt_r },
+        { 0xfe00707f, 0x00007033, id_and,    "and",    fmt_r },
+
+        { 0xfe00707f, 0x02000033, id_mul,    "mul",    fmt_r },
+        { 0xfe00707f, 0x02001033, id_mulh,   "mulh",   fmt_r },
+        { 0xfe00707f, 0x02002033, id_mulhsu, "mulhsu", fmt_r },
+        { 0xfe00707f, 0x02003033, id_mulhu,  "mulhu",  fmt_r },
+        { 0xfe00707f, 0x02004033, id_div,    "div",    fmt_r },
+        { 0xfe00707f, 0x02005033, id_divu,   "divu",   fmt_r },
+        { 0xfe00707f, 0x02006033, id_rem,    "rem",    fmt_r },
+        { 0xfe00707f, 0x02007033, id_remu,   "remu",   fmt_r },
+
+        { 0xffffffff, 0x00000073, id_ecall,  "ecall",  fmt_none },
+        { 0xffffffff, 0x00100073, id_ebreak, "ebreak", fmt_none },
+        { 0xffffffff, 0x30200073, id_mret,   "mret",   fmt_none },
+        { 0xffffffff, 0x10500073, id_wfi,    "wfi",    fmt_none },
+
+        { 0x0000707f, 0x00001073, id_csrrw,  "csrrw",  fmt_csr },
+        { 0x0000707f, 0x00002073, id_csrrs,  "csrrs",  fmt_csr },
+        { 0x0000707f, 0x00003073, id_csrrc,  "csrrc",  fmt_csr },
+        { 0x0000707f, 0x00005073, id_csrrwi, "csrrwi", fmt_csri },
+        { 0x0000707f, 0x00006073, id_csrrsi, "csrrsi", fmt_csri },
+        { 0x0000707f, 0x00007073, id_csrrci, "csrrci", fmt_csri },
+    };
+
+    static constexpr dispatch_map dispatch = make_dispatch(rows, id_count);
+};
+
+template <typename T> constexpr rv32i_isa::insn_info rv32i_isa::tables<T>::rows[id_count];
+template <typename T> constexpr rv32i_isa::dispatch_map rv32i_isa::tables<T>::dispatch;
+
+/**
+ * lookup() classifies an instruction.
+ *
+ * @return The table row of the instruction, or row 0 (id_illegal) if
+ *         it is not a supported instruction.
+ *
+ ********************************************************************************/
+
+inline const rv32i_isa::insn_info &rv32i_isa::lookup(uint32_t insn)
+{
+    const insn_info &r = tables<void>::rows[tables<void>::dispatch.row[key(insn)]];
+    if ((insn & r.mask) == r.match)
+        return r;
+
+    for (const insn_info &s : tables<void>::rows)      // shared keys and illegal insns
+    {
+        if ((insn & s.mask) == s.match)
+            return s;
+    }
+    return tables<void>::rows[id_illegal];
+}
+
+inline const rv32i_isa::insn_info &rv32i_isa::info(insn_id id)
+{
+    return tables<void>::rows[id];
+}
+
+#endif
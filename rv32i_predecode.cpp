@@ -0,0 +1,145 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#include "rv32i_predecode.h"
+#include "rv32i_asm.h"
+
+/**
+ * predecode() builds the uop for the instruction at pc, fused with the
+ * instruction after it when the pair is one of the recognized idioms.
+ *
+ * @param mem The memory holding the code. [pc, pc+4) must be inside it.
+ * @param pc Address of the instruction.
+ * @param rvc True if compressed instructions are enabled.
+ *
+ * @return The uop, tagged with pc. The caller sets its gen.
+ *
+ ********************************************************************************/
+
+rv32i_predecode::uop rv32i_predecode::predecode(const memory &mem, uint32_t pc, bool rvc)
+{
+    uop u;
+    fetch(mem, pc, rvc, u.insn, u.size);
+    u.pc = pc;
+
+    const rv32i_isa::insn_info &i = rv32i_isa::lookup(u.insn);
+    u.op = i.id;
+    u.rd = get_rd(u.insn);
+    u.rs1 = get_rs1(u.insn);
+    u.rs2 = get_rs2(u.insn);
+
+    switch (i.fmt)
+    {
+        case rv32i_isa::fmt_u: u.imm = get_imm_u(u.insn); break;
+        case rv32i_isa::fmt_j: u.imm = get_imm_j(u.insn); break;
+        case rv32i_isa::fmt_b: u.imm = get_imm_b(u.insn); break;
+        case rv32i_isa::fmt_s: u.imm = get_imm_s(u.insn); break;
+        case rv32i_isa::fmt_shift: u.imm = get_imm_i(u.insn) & 0x1f; break;
+        case rv32i_isa::fmt_jalr:
+        case rv32i_isa::fmt_load:
+        case rv32i_isa::fmt_i: u.imm = get_imm_i(u.insn); break;
+        default: break;
+    }
+
+    uint32_t insn2;
+    uint8_t size2;
+    if (fetch(mem, pc + u.size, rvc, insn2, size2))
+    {
+        fuse(u, insn2, size2);
+    }
+
+    return u;
+}
+
+/**
+ * fetch() reads the instruction at pc, expanding it if it is compressed.
+ *
+ * @return false if [pc, pc+4) is not inside memory. Nothing is read then,
+ *         so no out-of-range warnings are printed.
+ *
+ ********************************************************************************/
+
+bool rv32i_predecode::fetch(const memory &mem, uint32_t pc, bool rvc, uint32_t &insn, uint8_t &size)
+{
+    if (uint64_t(pc) + 4 > mem.get_size())
+        return false;
+
+    uint32_t w = mem.peek32(pc);
+    if (rvc && (w & 0x3) != 0x3)
+    {
+        insn = rv32i_asm::expand_compressed(w & 0xffff);
+        size = 2;
+    }
+    else
+    {
+        insn = w;
+        size = 4;
+    }
+    return true;
+}
+
+/**
+ * fuse() turns u into a fused uop if it and the instruction after it
+ * form one of the idioms. Otherwise u is left as it is.
+ *
+ * @param u The uop of the first instruction.
+ * @param insn2 The second instruction, expanded.
+ * @param size2 Its length.
+ *
+ ********************************************************************************/
+
+void rv32i_predecode::fuse(uop &u, uint32_t insn2, uint8_t size2)
+{
+    rv32i_isa::insn_id id2 = rv32i_isa::lookup(insn2).id;
+    uint32_t rd2 = get_rd(insn2);
+    uint32_t rs1_2 = get_rs1(insn2);
+    uint32_t rs2_2 = get_rs2(insn2);
+
+    switch (u.op)
+    {
+        case rv32i_isa::id_lui:
+            if (id2 == rv32i_isa::id_addi && rs1_2 == u.rd && rd2 == u.rd)
+            {
+                u.op = fuse_li;
+                u.imm += get_imm_i(insn2);
+            }
+            break;
+
+        case rv32i_isa::id_auipc:
+            if (id2 == rv32i_isa::id_addi && rs1_2 == u.rd && rd2 == u.rd && u.rd != 0)
+            {
+                u.op = fuse_la;
+                u.imm += get_imm_i(insn2);
+            }
+            else if ((id2 == rv32i_isa::id_jalr || id2 == rv32i_isa::id_lw) && rs1_2 == u.rd && u.rd != 0)
+            {
+                u.op = (id2 == rv32i_isa::id_jalr) ? fuse_call : fuse_lw_pc;
+                u.rd2 = rd2;
+                u.imm2 = get_imm_i(insn2);
+            }
+            break;
+
+        case rv32i_isa::id_slt:
+        case rv32i_isa::id_sltu:
+        case rv32i_isa::id_slti:
+        case rv32i_isa::id_sltiu:
+            if ((id2 == rv32i_isa::id_beq || id2 == rv32i_isa::id_bne) && rs1_2 == u.rd && rs2_2 == 0 && u.rd != 0)
+            {
+                u.cmp = u.op;
+                u.op = fuse_cmp_br;
+                u.br_on = (id2 == rv32i_isa::id_bne);
+                u.imm2 = get_imm_b(insn2);
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    if (u.op >= rv32i_isa::id_count)
+        u.size2 = size2;
+}
@@ -0,0 +1,67 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#ifndef H_RV32I_PREDECODE
+#define H_RV32I_PREDECODE
+
+#include "rv32i_decode.h"
+#include "memory.h"
+
+/**
+ * rv32i_predecode turns the instruction at a pc into a uop: its operation
+ * and operand fields, extracted once so that the fast path does not
+ * decode the instruction again each time it runs.
+ *
+ * Common pairs of adjacent instructions are fused into one uop that
+ * retires both:
+ *
+ *     lui   rd,hi ; addi rd,rd,lo          fuse_li     rd = constant
+ *     auipc rd,hi ; addi rd,rd,lo          fuse_la     rd = pc + offset
+ *     auipc rd,hi ; jalr rd2,lo(rd)        fuse_call   far call or jump
+ *     auipc rd,hi ; lw   rd2,lo(rd)        fuse_lw_pc  pc-relative load
+ *     slt[i][u] rd,... ; beq/bne rd,x0,L   fuse_cmp_br compare and branch
+ *
+ ********************************************************************************/
+
+class rv32i_predecode : public rv32i_decode
+{
+public:
+    enum fused_id : uint8_t
+    {
+        fuse_li = rv32i_isa::id_count,
+        fuse_la,
+        fuse_call,
+        fuse_lw_pc,
+        fuse_cmp_br
+    };
+
+    struct uop
+    {
+        uint32_t pc = { 0xffffffff };   ///< Odd, so it never matches a fetch.
+        uint32_t gen = { 0 };           ///< memory::get_code_gen() of its words when predecoded.
+        uint32_t insn = { 0 };          ///< The first instruction, expanded if compressed.
+        int32_t imm = { 0 };
+        int32_t imm2 = { 0 };           ///< Second instruction's immediate, if fused.
+        uint8_t op = { rv32i_isa::id_illegal };  ///< insn_id, or fused_id.
+        uint8_t rd = { 0 };
+        uint8_t rs1 = { 0 };
+        uint8_t rs2 = { 0 };
+        uint8_t rd2 = { 0 };            ///< Second instruction's rd, if fused.
+        uint8_t cmp = { 0 };            ///< fuse_cmp_br: the compare's insn_id.
+        uint8_t br_on = { 0 };          ///< fuse_cmp_br: branch if the compare gave this.
+        uint8_t size = { 4 };           ///< Length of the first instruction.
+        uint8_t size2 = { 0 };          ///< Length of the second, 0 if not fused.
+    };
+
+    static uop predecode(const memory &mem, uint32_t pc, bool rvc);
+    static bool fetch(const memory &mem, uint32_t pc, bool rvc, uint32_t &insn, uint8_t &size);
+
+private:
+    static void fuse(uop &u, uint32_t insn2, uint8_t size2);
+};
+
+#endif
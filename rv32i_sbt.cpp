@@ -0,0 +1,105 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#include "sbt_translator.h"
+#include "rv32i_cfg.h"
+#include "elf_file.h"
+#include "memory.h"
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+
+/**
+ * usage() tells the user how to pass arguments to the translator.
+ *
+ ********************************************************************************/
+
+static void usage()
+{
+	std::cerr << "Usage: rv32i-sbt [-c] [-m hex-mem-size] [-o outfile] infile" << std::endl;
+	std::cerr << "    -c enable the RV32C compressed instruction extension" << std::endl;
+	std::cerr << "    -m specify memory size (default = 0x100), also the default when run" << std::endl;
+	std::cerr << "    -o output file (default = infile with its extension replaced by .sbt.cpp)" << std::endl;
+	exit(1);
+}
+
+/**
+ * main() translates a flat or ELF RV32I image to C++ source and prints
+ * how to build it.
+ *
+ ********************************************************************************/
+
+int main(int argc, char **argv)
+{
+	uint32_t memory_limit = 0x100;
+	bool cFlag = false;
+	std::string outfile;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "cm:o:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'c':
+		{
+			cFlag = true;
+		}
+			break;
+		case 'm':
+		{
+			std::istringstream iss(optarg);
+			iss >> std::hex >> memory_limit;
+		}
+			break;
+		case 'o':
+		{
+			outfile = optarg;
+		}
+			break;
+		default: /* '?' */
+			usage();
+		}
+	}
+
+	if (optind >= argc)
+		usage(); // missing filename
+
+	std::string infile = argv[optind];
+	if (outfile.empty())
+	{
+		size_t dot = infile.find_last_of('.');
+		size_t slash = infile.find_last_of('/');
+		if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+			dot = infile.size();
+		outfile = infile.substr(0, dot) + ".sbt.cpp";	// never prog.cpp, which may be a source
+	}
+
+	memory mem(memory_limit);
+	elf_file elf;
+	if (!(elf_file::is_elf(infile) ? elf.load(infile, mem) : mem.load_file(infile)))
+		usage();
+
+	rv32i_cfg cfg;
+	cfg.add_root(elf.get_entry());
+	for (const auto &f : elf.get_functions())
+		cfg.add_root(f.second, f.first);
+	cfg.build(mem, cFlag);
+
+	sbt_translator sbt(mem, cFlag);
+	sbt.translate(cfg, elf.get_entry(), infile);
+	if (!sbt.save(outfile))
+		return 1;
+
+	std::string prog = outfile;
+	if (prog.size() > 4 && prog.compare(prog.size() - 4, 4, ".cpp") == 0)
+		prog.resize(prog.size() - 4);
+
+	std::cout << "Translated " << std::dec << sbt.get_block_count() << " blocks (" << sbt.get_insn_count()
+			  << " instructions) to " << outfile << ", build with: make sbt SBT=" << prog << std::endl;
+
+	return 0;
+}
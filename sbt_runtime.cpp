@@ -0,0 +1,239 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#include "sbt_runtime.h"
+#include "elf_file.h"
+#include "syscall_proxy.h"
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+
+/**
+ * sbt_runtime() indexes the translated blocks and marks their code, so
+ * that a block whose code is written later is no longer called.
+ *
+ ********************************************************************************/
+
+sbt_runtime::sbt_runtime(memory &m, const sbt_image &i) : mem(m), img(i), core(m)
+{
+    core.set_rvc(img.rvc);
+    core.set_pc(img.entry);
+
+    if (img.count != 0)
+    {
+        lo = img.blocks[0].pc;          // the blocks are in address order
+        slot.resize(((img.blocks[img.count - 1].pc - lo) >> 1) + 1, -1);
+    }
+
+    gens.resize(img.count);
+    for (uint32_t b = 0; b < img.count; ++b)
+    {
+        const sbt_block &blk = img.blocks[b];
+        slot[(blk.pc - lo) >> 1] = b;
+        mem.mark_code(blk.pc, blk.bytes);
+        gens[b] = mem.get_code_gen(blk.pc, blk.bytes);
+    }
+}
+
+/**
+ * run() runs the program until it halts or has executed exec_limit
+ * instructions, and prints the same summary as cpu_single_hart::run().
+ *
+ * @param exec_limit Maximum number of instructions to execute, 0 = no limit.
+ *
+ ********************************************************************************/
+
+void sbt_runtime::run(uint64_t exec_limit)
+{
+    uint64_t n = core.get_insn_counter();
+    uint32_t pc = core.get_pc();
+
+    while (!core.is_halted())
+    {
+        if (exec_limit != 0 && n >= exec_limit)
+        {
+            core.set_halt(true);
+            break;
+        }
+
+        uint32_t i = (pc - lo) >> 1;
+        if (i < slot.size() && slot[i] >= 0 && (pc & 1) == 0)
+        {
+            const sbt_block &b = img.blocks[slot[i]];
+            if (gens[slot[i]] == mem.get_code_gen(b.pc, b.bytes)
+                && (exec_limit == 0 || n + b.insns <= exec_limit))
+            {
+                if (in_core)
+                    from_core();
+                pc = b.fn(state, mem);
+                n += b.insns;
+                native_insns += b.insns;
+                continue;
+            }
+        }
+
+        if (!in_core)
+            to_core();
+        core.set_pc(pc);
+        core.set_insn_counter(n);
+        core.step();
+        pc = core.get_pc();
+        n = core.get_insn_counter();
+    }
+
+    if (!in_core)
+        to_core();
+    core.set_pc(pc);
+    core.set_insn_counter(n);
+    core.flush_output();
+
+    if (exec_limit != 0 && n < exec_limit)
+    {
+        return;                         // as cpu_single_hart::run(), which only reports at the limit
+    }
+    if (core.get_halt_reason() != "none")
+    {
+        std::cout << "Execution terminated. Reason: " << core.get_halt_reason() << "\n";
+    }
+    std::cout << std::dec << n << " instructions executed" << std::endl;
+}
+
+/**
+ * to_core() and from_core() hand the registers between the translated
+ * code and the interpreter hart.
+ *
+ ********************************************************************************/
+
+void sbt_runtime::to_core()
+{
+    for (uint32_t r = 1; r < 32; ++r)
+        core.set_reg(r, state.x[r]);
+    in_core = true;
+}
+
+void sbt_runtime::from_core()
+{
+    for (uint32_t r = 1; r < 32; ++r)
+        state.x[r] = core.get_reg(r);
+    in_core = false;
+}
+
+/**
+ * usage() tells the user how to run a translated program.
+ *
+ ********************************************************************************/
+
+static void usage(const char *prog)
+{
+    std::cerr << "Usage: " << prog << " [-l exec-limit] [-m hex-mem-size] [-s sandbox-dir] [-v] [-z] infile" << std::endl;
+    std::cerr << "    -l maximum number of instructions to exec" << std::endl;
+    std::cerr << "    -m specify memory size (default = the size it was translated with)" << std::endl;
+    std::cerr << "    -s carry out ECALLs as host system calls, opening files in sandbox-dir" << std::endl;
+    std::cerr << "    -v show how many instructions ran as translated code" << std::endl;
+    std::cerr << "    -z show a dump of the regs & memory after simulation" << std::endl;
+    std::cerr << "    infile must be the program it was translated from" << std::endl;
+    exit(1);
+}
+
+/**
+ * main() is the main() of a translated program. It loads infile as rv32i
+ * does, checks that it holds the code that was translated, and runs it.
+ *
+ ********************************************************************************/
+
+int sbt_runtime::main(int argc, char **argv, const sbt_image &img)
+{
+    uint32_t memory_limit = img.mem_size;
+    uint64_t limiter = 0;
+    bool sFlag = false;
+    bool vFlag = false;
+    bool zFlag = false;
+    std::string sandbox;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "l:m:s:vz")) != -1)
+    {
+        switch (opt)
+        {
+        case 'l':
+        {
+            std::istringstream iss(optarg);
+            iss >> limiter;
+        }
+            break;
+        case 'm':
+        {
+            std::istringstream iss(optarg);
+            iss >> std::hex >> memory_limit;
+        }
+            break;
+        case 's':
+            sFlag = true;
+            sandbox = optarg;
+            break;
+        case 'v':
+            vFlag = true;
+            break;
+        case 'z':
+            zFlag = true;
+            break;
+        default: /* '?' */
+            usage(argv[0]);
+        }
+    }
+
+    if (optind >= argc)
+        usage(argv[0]);
+
+    memory mem(memory_limit);
+    elf_file elf;
+    std::string fname = argv[optind];
+    if (!(elf_file::is_elf(fname) ? elf.load(fname, mem) : mem.load_file(fname)))
+        usage(argv[0]);
+
+    uint32_t h = hash_basis;
+    for (uint32_t b = 0; b < img.count; ++b)
+    {
+        if (uint64_t(img.blocks[b].pc) + img.blocks[b].bytes > mem.get_size())
+        {
+            h = ~img.hash;
+            break;
+        }
+        h = hash(h, mem, img.blocks[b].pc, img.blocks[b].bytes);
+    }
+    if (h != img.hash)
+    {
+        std::cerr << "'" << fname << "' is not the program this was translated from." << std::endl;
+        return 1;
+    }
+
+    sbt_runtime rt(mem, img);
+
+    syscall_proxy syscalls(mem, sandbox);
+    if (sFlag)
+    {
+        rt.get_core().reset();      // programs using syscalls expect a valid sp
+        rt.get_core().set_pc(img.entry);
+        syscalls.set_brk((mem.get_image_size()+15)&0xfffffff0);
+        rt.get_core().set_syscall_proxy(&syscalls);
+    }
+
+    rt.run(limiter);
+
+    if (vFlag)
+        std::cerr << std::dec << rt.get_native_insns() << " instructions ran as translated code" << std::endl;
+
+    if (zFlag)
+    {
+        rt.dump();
+        mem.dump();
+    }
+
+    if (syscalls.has_exited())
+        return syscalls.get_exit_code();
+    return 0;
+}
@@ -0,0 +1,94 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#ifndef H_SBT_RUNTIME
+#define H_SBT_RUNTIME
+
+#include "cpu_single_hart.h"
+#include "memory.h"
+#include <vector>
+
+/// The guest registers as translated code sees them. x[0] is never written.
+struct sbt_state
+{
+    uint32_t x[32] = { };
+};
+
+/// A translated block: runs it and returns the pc to continue at.
+typedef uint32_t (*sbt_fn)(sbt_state &s, memory &m);
+
+struct sbt_block
+{
+    uint32_t pc;
+    uint32_t bytes;             ///< Length of the code it was translated from.
+    uint32_t insns;             ///< Instructions it retires, always all of them.
+    sbt_fn fn;
+};
+
+/// Everything rv32i-sbt writes out about a program.
+struct sbt_image
+{
+    const sbt_block *blocks;
+    uint32_t count;
+    uint32_t hash;              ///< sbt_runtime::hash() of the translated code.
+    uint32_t entry;
+    uint32_t mem_size;          ///< Memory size it was translated with, the default.
+    bool rvc;
+};
+
+/**
+ * sbt_runtime runs a program translated to C++ by rv32i-sbt.
+ *
+ * Whenever the pc is the start of a translated block whose code is still
+ * the same in memory, the block is called. Everything else is run one
+ * instruction at a time by an interpreter hart, which the registers are
+ * handed to and taken back from: untranslated instructions (system, CSR
+ * and illegal ones), jalr targets not found at translation time, code
+ * rewritten since it was loaded, and the instructions that would take a
+ * block past the execution limit.
+ *
+ ********************************************************************************/
+
+class sbt_runtime : public hex
+{
+public:
+    sbt_runtime(memory &m, const sbt_image &img);
+
+    void run(uint64_t exec_limit);
+    void dump() const { core.dump(""); }
+
+    cpu_single_hart &get_core() { return core; }
+    uint64_t get_native_insns() const { return native_insns; }
+
+    static int main(int argc, char **argv, const sbt_image &img);
+
+    /// FNV-1a of [addr, addr+len), continuing from h.
+    static uint32_t hash(uint32_t h, const memory &mem, uint32_t addr, uint32_t len)
+    {
+        for (uint32_t i = 0; i < len; ++i)
+            h = (h ^ mem.peek8(addr + i)) * 16777619u;
+        return h;
+    }
+    static constexpr uint32_t hash_basis = 2166136261u;
+
+private:
+    void to_core();
+    void from_core();
+
+    memory &mem;
+    const sbt_image &img;
+    cpu_single_hart core;
+    sbt_state state;
+    bool in_core = { true };            ///< The hart holds the current registers.
+
+    uint32_t lo = { 0 };                ///< Lowest block start.
+    std::vector<int32_t> slot;          ///< Per halfword from lo on, its block's place in img.blocks, or -1.
+    std::vector<uint32_t> gens;         ///< Code generation of each block when loaded.
+    uint64_t native_insns = { 0 };
+};
+
+#endif
@@ -0,0 +1,271 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#include "sbt_translator.h"
+#include "sbt_runtime.h"
+#include <fstream>
+
+/**
+ * translate() writes a function for every block of cfg that has any
+ * translatable code, then the table sbt_runtime looks them up in and a
+ * main() that runs the program.
+ *
+ * @param cfg The program's blocks, from rv32i_cfg::build().
+ * @param entry Where the program starts.
+ * @param source The name of the program, for the header comment.
+ *
+ ********************************************************************************/
+
+void sbt_translator::translate(const rv32i_cfg &cfg, uint32_t entry, const std::string &source)
+{
+    std::ostringstream os;
+    std::ostringstream table;
+    uint32_t h = sbt_runtime::hash_basis;
+
+    os << "// Translated from " << source << " by rv32i-sbt. Build with: make sbt SBT=<this file without .cpp>\n\n";
+    os << "#include \"sbt_runtime.h\"\n";
+
+    block_count = 0;
+    insn_count = 0;
+    for (const auto &e : cfg.get_blocks())
+    {
+        const rv32i_cfg::block &b = e.second;
+        if (b.end - b.start > memory::page_size)
+            continue;
+
+        std::string body;
+        uses u;
+        uint32_t n = 0;
+        bool ends = false;
+        uint32_t next = b.start;
+
+        for (uint32_t k = 0; k < b.code.size() && !ends; ++k)
+        {
+            next = (k + 1 < b.code.size()) ? b.code[k + 1].pc : b.end;
+            if (!emit_insn(body, b.code[k], next, u, ends))
+            {
+                next = b.code[k].pc;
+                break;
+            }
+            ++n;
+        }
+        if (n == 0)
+            continue;
+        if (!ends)
+            body += "    return " + imm(next) + ";\n";
+
+        os << "\nstatic uint32_t b" << hex32(b.start) << "(sbt_state &" << (u.s ? "s" : "")
+           << ", memory &" << (u.m ? "m" : "") << ")\n{\n" << body << "}\n";
+        table << "    { " << hex0x32(b.start) << ", " << std::dec << next - b.start << ", " << n
+              << ", b" << hex32(b.start) << " },\n";
+
+        h = sbt_runtime::hash(h, mem, b.start, next - b.start);
+        ++block_count;
+        insn_count += n;
+    }
+
+    os << "\nstatic const sbt_block blocks[] =\n{\n" << table.str();
+    if (block_count == 0)
+        os << "    { 0, 0, 0, nullptr },\n";
+    os << "};\n\n";
+    os << "static const sbt_image image = { blocks, " << std::dec << block_count << ", " << hex0x32(h) << "u, "
+       << hex0x32(entry) << ", " << hex0x32(mem.get_size()) << ", " << (rvc ? "true" : "false") << " };\n\n";
+    os << "int main(int argc, char **argv)\n{\n    return sbt_runtime::main(argc, argv, image);\n}\n";
+
+    text = os.str();
+}
+
+/**
+ * save() writes the translated source to fname.
+ *
+ * @return false if the file cannot be opened.
+ *
+ ********************************************************************************/
+
+bool sbt_translator::save(const std::string &fname) const
+{
+    std::ofstream out(fname);
+    if (!out.is_open())
+    {
+        std::cerr << "Can't open file '" << fname << "' for writing.\n";
+        return false;
+    }
+
+    out << text;
+    return true;
+}
+
+/**
+ * reg() is the expression for reading register r, marking s as used
+ * unless r is x0.
+ *
+ ********************************************************************************/
+
+std::string sbt_translator::reg(uint32_t r, uses &u)
+{
+    if (r == 0)
+        return "0u";
+
+    u.s = true;
+    return "s.x[" + std::to_string(r) + "]";
+}
+
+/**
+ * emit_insn() appends the C++ for one instruction, with its disassembly
+ * as a comment.
+ *
+ * @param next The address of the instruction after it.
+ * @param ends Set if it is a jump or branch, which returns the next pc.
+ *
+ * @return false if the instruction is not translated.
+ *
+ ********************************************************************************/
+
+bool sbt_translator::emit_insn(std::string &out, const rv32i_cfg::insn &i, uint32_t next, uses &u, bool &ends) const
+{
+    rv32i_decode::decoded_insn d = rv32i_decode::decode_insn(i.pc, i.bits);
+    int32_t im = d.imm;
+    uses src;                           // marked in u only if the sources are emitted
+    std::string a = reg(d.rs1, src);
+    std::string b = (d.fmt == rv32i_isa::fmt_r || d.fmt == rv32i_isa::fmt_b || d.fmt == rv32i_isa::fmt_s) ? reg(d.rs2, src) : "";
+    std::string val;                    // what is written to rd
+    std::string stmt;                   // or the whole statement
+
+    switch (d.id)
+    {
+        case rv32i_isa::id_lui: val = imm(rv32i_isa::get_imm_u(i.bits)); break;
+        case rv32i_isa::id_auipc: val = imm(i.pc + rv32i_isa::get_imm_u(i.bits)); break;
+
+        case rv32i_isa::id_jal:
+            if (d.rd)
+                stmt = reg(d.rd, u) + " = " + imm(next) + "; ";
+            stmt += "return " + imm(d.target) + ";";
+            ends = true;
+            break;
+
+        case rv32i_isa::id_jalr:
+            if (d.rd)
+                stmt = "{ uint32_t t = (" + a + " + " + imm(im) + ") & ~1u; " + reg(d.rd, u) + " = " + imm(next) + "; return t; }";
+            else
+                stmt = "return (" + a + " + " + imm(im) + ") & ~1u;";
+            ends = true;
+            break;
+
+        case rv32i_isa::id_beq: stmt = "return " + a + " == " + b; break;
+        case rv32i_isa::id_bne: stmt = "return " + a + " != " + b; break;
+        case rv32i_isa::id_blt: stmt = "return int32_t(" + a + ") < int32_t(" + b + ")"; break;
+        case rv32i_isa::id_bge: stmt = "return int32_t(" + a + ") >= int32_t(" + b + ")"; break;
+        case rv32i_isa::id_bltu:
+            if (d.rs2 == 0)             // never taken; "< 0u" would not compile with -Werror
+            {
+                stmt = "return " + imm(next) + ";";
+                src = uses();
+                ends = true;
+            }
+            else
+                stmt = "return " + a + " < " + b;
+            break;
+        case rv32i_isa::id_bgeu:
+            if (d.rs2 == 0)             // always taken
+            {
+                stmt = "return " + imm(d.target) + ";";
+                src = uses();
+                ends = true;
+            }
+            else
+                stmt = "return " + a + " >= " + b;
+            break;
+
+        case rv32i_isa::id_lb: val = "m.get8_sx(" + a + " + " + imm(im) + ")"; break;
+        case rv32i_isa::id_lh: val = "m.get16_sx(" + a + " + " + imm(im) + ")"; break;
+        case rv32i_isa::id_lw: val = "m.get32(" + a + " + " + imm(im) + ")"; break;
+        case rv32i_isa::id_lbu: val = "m.get8(" + a + " + " + imm(im) + ")"; break;
+        case rv32i_isa::id_lhu: val = "m.get16(" + a + " + " + imm(im) + ")"; break;
+
+        case rv32i_isa::id_sb: stmt = "m.set8(" + a + " + " + imm(im) + ", " + b + ");"; break;
+        case rv32i_isa::id_sh: stmt = "m.set16(" + a + " + " + imm(im) + ", " + b + ");"; break;
+        case rv32i_isa::id_sw: stmt = "m.set32(" + a + " + " + imm(im) + ", " + b + ");"; break;
+
+        case rv32i_isa::id_addi: val = a + " + " + imm(im); break;
+        case rv32i_isa::id_slti: val = "int32_t(" + a + ") < " + std::to_string(im); break;
+        case rv32i_isa::id_sltiu:
+            if (im == 0)
+            {
+                val = "0u";
+                src = uses();
+            }
+            else
+                val = a + " < " + imm(im);
+            break;
+        case rv32i_isa::id_xori: val = a + " ^ " + imm(im); break;
+        case rv32i_isa::id_ori: val = a + " | " + imm(im); break;
+        case rv32i_isa::id_andi: val = a + " & " + imm(im); break;
+        case rv32i_isa::id_slli: val = a + " << " + std::to_string(im); break;
+        case rv32i_isa::id_srli: val = a + " >> " + std::to_string(im); break;
+        case rv32i_isa::id_srai: val = "uint32_t(int32_t(" + a + ") >> " + std::to_string(im) + ")"; break;
+
+        case rv32i_isa::id_add: val = a + " + " + b; break;
+        case rv32i_isa::id_sub: val = a + " - " + b; break;
+        case rv32i_isa::id_sll: val = a + " << (" + b + " & 31)"; break;
+        case rv32i_isa::id_slt: val = "int32_t(" + a + ") < int32_t(" + b + ")"; break;
+        case rv32i_isa::id_sltu:
+            if (d.rs2 == 0)
+            {
+                val = "0u";
+                src = uses();
+            }
+            else
+                val = a + " < " + b;
+            break;
+        case rv32i_isa::id_xor: val = a + " ^ " + b; break;
+        case rv32i_isa::id_srl: val = a + " >> (" + b + " & 31)"; break;
+        case rv32i_isa::id_sra: val = "uint32_t(int32_t(" + a + ") >> (" + b + " & 31))"; break;
+        case rv32i_isa::id_or: val = a + " | " + b; break;
+        case rv32i_isa::id_and: val = a + " & " + b; break;
+
+        case rv32i_isa::id_mul: val = a + " * " + b; break;
+        case rv32i_isa::id_mulh: val = "rv32i_isa::mulh(" + a + ", " + b + ")"; break;
+        case rv32i_isa::id_mulhsu: val = "rv32i_isa::mulhsu(" + a + ", " + b + ")"; break;
+        case rv32i_isa::id_mulhu: val = "rv32i_isa::mulhu(" + a + ", " + b + ")"; break;
+        case rv32i_isa::id_div: val = "rv32i_isa::div(" + a + ", " + b + ")"; break;
+        case rv32i_isa::id_divu: val = "rv32i_isa::divu(" + a + ", " + b + ")"; break;
+        case rv32i_isa::id_rem: val = "rv32i_isa::rem(" + a + ", " + b + ")"; break;
+        case rv32i_isa::id_remu: val = "rv32i_isa::remu(" + a + ", " + b + ")"; break;
+
+        default:
+            return false;               // system, CSR and illegal instructions
+    }
+
+    if (d.fmt == rv32i_isa::fmt_b && !ends)
+    {
+        stmt += " ? " + imm(d.target) + " : " + imm(next) + ";";
+        ends = true;
+    }
+    if (d.fmt == rv32i_isa::fmt_s || d.fmt == rv32i_isa::fmt_load)
+        u.m = true;
+
+    if (stmt.empty())
+    {
+        if (d.rd != 0)
+            stmt = reg(d.rd, u) + " = " + val + ";";
+        else if (d.fmt == rv32i_isa::fmt_load)
+            stmt = val + ";";           // a load from a device may still matter
+        else
+            stmt = ";";
+    }
+    if (stmt != ";")
+        u.s = u.s || src.s;
+
+    char text[rv32i_decode::render_size];
+    rv32i_decode::render(d, text, sizeof(text));
+
+    std::string line = "    " + stmt;
+    if (line.size() < 60)
+        line.resize(60, ' ');
+    out += line + " // " + to_hex32(i.pc) + ": " + text + "\n";
+    return true;
+}
@@ -0,0 +1,57 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#ifndef H_SBT_TRANSLATOR
+#define H_SBT_TRANSLATOR
+
+#include "rv32i_cfg.h"
+#include "memory.h"
+#include <string>
+
+/**
+ * sbt_translator writes the blocks of a control-flow graph out as C++
+ * source, for sbt_runtime to run.
+ *
+ * Each block becomes one function taking the registers (sbt_state) and
+ * the memory, which it accesses through the memory API, and returning
+ * the next pc. A block is cut short before the first instruction that is
+ * not translated (system, CSR and illegal instructions); those are left
+ * to the interpreter. Blocks longer than a page are not translated.
+ *
+ ********************************************************************************/
+
+class sbt_translator : public hex
+{
+public:
+    sbt_translator(const memory &m, bool c) : mem(m), rvc(c) { }
+
+    void translate(const rv32i_cfg &cfg, uint32_t entry, const std::string &source);
+    bool save(const std::string &fname) const;
+
+    uint32_t get_block_count() const { return block_count; }
+    uint32_t get_insn_count() const { return insn_count; }
+
+private:
+    struct uses
+    {
+        bool s = { false };
+        bool m = { false };
+    };
+
+    bool emit_insn(std::string &out, const rv32i_cfg::insn &i, uint32_t next, uses &u, bool &ends) const;
+
+    static std::string reg(uint32_t r, uses &u);
+    static std::string imm(int32_t v) { return to_hex0x32(v) + "u"; }
+
+    const memory &mem;
+    bool rvc;
+    std::string text;
+    uint32_t block_count = { 0 };
+    uint32_t insn_count = { 0 };
+};
+
+#endif
@@ -0,0 +1,67 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#include "soft_tlb.h"
+
+/**
+ * soft_tlb() attaches the TLB to m, so that m can flush it. It must be
+ * destroyed before m.
+ *
+ ********************************************************************************/
+
+soft_tlb::soft_tlb(memory &m) : mem(m)
+{
+    mem.attach_tlb(this);
+}
+
+soft_tlb::~soft_tlb()
+{
+    mem.detach_tlb(this);
+}
+
+/**
+ * refill() asks memory whether accesses of kind a may use page directly.
+ * A page that may not is not entered, so later accesses ask again.
+ *
+ * @return false if the access must go through the memory API.
+ *
+ ********************************************************************************/
+
+bool soft_tlb::refill(entry &e, uint32_t page, memory::access a)
+{
+    uint8_t *host = mem.host_page(page, a);
+    if (!host)
+        return false;
+
+    e.page = page;
+    e.host = host;
+    return true;
+}
+
+/**
+ * flush() drops every entry; flush_page() drops those for one page.
+ *
+ ********************************************************************************/
+
+void soft_tlb::flush()
+{
+    for (auto &set : sets)
+    {
+        for (entry &e : set)
+            e = entry();
+    }
+}
+
+void soft_tlb::flush_page(uint32_t page)
+{
+    for (auto &set : sets)
+    {
+        entry &e = set[page & (size-1)];
+        if (e.page == page)
+            e = entry();
+    }
+}
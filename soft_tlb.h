@@ -0,0 +1,65 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#ifndef H_SOFT_TLB
+#define H_SOFT_TLB
+
+#include "memory.h"
+
+/**
+ * soft_tlb caches, for one hart, which guest pages its loads, stores and
+ * fetches may access directly in host memory, and where.
+ *
+ * Each access kind has its own small direct-mapped set of entries, each
+ * the page number and the host address of the page. lookup() is a tag
+ * compare; on a miss memory::host_page() decides, so that watched pages,
+ * pages holding cached code (for stores), devices and anything outside
+ * RAM keep going through the memory API. memory flushes the TLBs attached
+ * to it whenever its answer for a page may change.
+ *
+ ********************************************************************************/
+
+class soft_tlb
+{
+public:
+    static constexpr uint32_t size = 64;        ///< Entries per access kind.
+
+    soft_tlb(memory &m);
+    soft_tlb(const soft_tlb&) = delete;
+    soft_tlb &operator=(const soft_tlb&) = delete;
+    ~soft_tlb();
+
+    /// The host address of [addr, addr+len), or nullptr if the access must use the memory API.
+    uint8_t *lookup(uint32_t addr, uint32_t len, memory::access a)
+    {
+        uint32_t page = addr >> memory::page_shift;
+        uint32_t offset = addr & (memory::page_size - 1);
+        entry &e = sets[a][page & (size-1)];
+        if (e.page != page && !refill(e, page, a))
+            return nullptr;
+        if (offset + len > memory::page_size)
+            return nullptr;                     // crosses into the next page
+        return e.host + offset;
+    }
+
+    void flush();
+    void flush_page(uint32_t page);
+
+private:
+    struct entry
+    {
+        uint32_t page = { 0xffffffff };         ///< Never a page number.
+        uint8_t *host = { nullptr };
+    };
+
+    bool refill(entry &e, uint32_t page, memory::access a);
+
+    memory &mem;
+    entry sets[memory::access_count][size];
+};
+
+#endif
@@ -0,0 +1,396 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#include "syscall_proxy.h"
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sstream>
+#include <unistd.h>
+
+// open() flags as the guest passes them (RISC-V Linux values)
+static constexpr int32_t guest_o_accmode = 0003;
+static constexpr int32_t guest_o_creat = 0100;
+static constexpr int32_t guest_o_excl = 0200;
+static constexpr int32_t guest_o_trunc = 01000;
+static constexpr int32_t guest_o_append = 02000;
+
+static constexpr int32_t guest_at_fdcwd = -100;
+
+/**
+ * syscall_proxy() attaches the proxy to a guest memory.
+ *
+ * Guest fds 0, 1 and 2 are the simulator's own stdin, stdout and stderr.
+ *
+ * @param m The guest memory that buffer and path arguments point into.
+ * @param sandbox Host directory that guest paths are resolved against.
+ *
+ ********************************************************************************/
+
+syscall_proxy::syscall_proxy(memory &m, const std::string &sandbox) : mem(m), sandbox(sandbox)
+{
+    fds = { 0, 1, 2 };
+    brk_start = brk_cur = mem.get_size();
+}
+
+/**
+ * ~syscall_proxy() writes out any buffered output and closes the files
+ * the guest left open.
+ *
+ ********************************************************************************/
+
+syscall_proxy::~syscall_proxy()
+{
+    flush();
+
+    for (size_t i = 3; i < fds.size(); ++i)
+    {
+        if (fds[i] >= 0)
+            ::close(fds[i]);
+    }
+}
+
+/**
+ * flush() writes the buffered guest stdout to the host stdout.
+ *
+ ********************************************************************************/
+
+void syscall_proxy::flush()
+{
+    if (!stdout_buf.empty())
+    {
+        std::cout.write(stdout_buf.data(), stdout_buf.size());
+        stdout_buf.clear();
+    }
+    std::cout.flush();
+}
+
+/**
+ * dispatch() performs the system call requested by an ECALL.
+ *
+ * @param regs The hart's registers. a7 selects the call, a0-a3 are the
+ *        arguments and a0 receives the result.
+ * @param comment Set to a rendering of the call and its result for the
+ *        instruction trace.
+ *
+ * @return false if the guest has exited and the hart should halt.
+ *
+ ********************************************************************************/
+
+bool syscall_proxy::dispatch(registerfile &regs, std::string &comment)
+{
+    uint32_t num = regs.get(17);
+    int32_t a0 = regs.get(10);
+    int32_t a1 = regs.get(11);
+    int32_t a2 = regs.get(12);
+    int32_t a3 = regs.get(13);
+
+    std::ostringstream os;
+    int32_t ret;
+
+    switch (num)
+    {
+    case sys_read:
+        os << "read(" << std::dec << a0 << ", " << to_hex0x32(a1) << ", " << a2 << ")";
+        ret = do_read(a0, a1, a2);
+        break;
+
+    case sys_write:
+        os << "write(" << std::dec << a0 << ", " << to_hex0x32(a1) << ", " << a2 << ")";
+        ret = do_write(a0, a1, a2);
+        break;
+
+    case sys_openat:
+        os << "openat(" << std::dec << a0 << ", " << to_hex0x32(a1) << ", " << to_hex0x32(a2) << ")";
+        ret = (a0 == guest_at_fdcwd) ? do_open(a1, a2, a3) : -EBADF;
+        break;
+
+    case sys_open:
+        os << "open(" << to_hex0x32(a0) << ", " << to_hex0x32(a1) << ")";
+        ret = do_open(a0, a1, a2);
+        break;
+
+    case sys_close:
+        os << "close(" << std::dec << a0 << ")";
+        ret = do_close(a0);
+        break;
+
+    case sys_lseek:
+        os << "lseek(" << std::dec << a0 << ", " << a1 << ", " << a2 << ")";
+        ret = do_lseek(a0, a1, a2);
+        break;
+
+    case sys_brk:
+        os << "brk(" << to_hex0x32(a0) << ")";
+        ret = do_brk(a0);
+        break;
+
+    case sys_exit:
+    case sys_exit_group:
+        flush();
+        exited = true;
+        exit_code = a0;
+        os << "exit(" << std::dec << a0 << ")";
+        comment = os.str();
+        return false;
+
+    default:
+        os << "syscall " << std::dec << num << " not implemented";
+        ret = -ENOSYS;
+        break;
+    }
+
+    regs.set(10, ret);
+
+    os << " = " << std::dec << ret;
+    comment = os.str();
+    return true;
+}
+
+/**
+ * do_read() reads into a guest buffer. Buffered output is written out
+ * first so that prompts appear before the program waits for input.
+ *
+ ********************************************************************************/
+
+int32_t syscall_proxy::do_read(int32_t fd, uint32_t buf, uint32_t count)
+{
+    int hfd = host_fd(fd);
+    if (hfd < 0)
+        return -EBADF;
+    if (!check_buffer(buf, count))
+        return -EFAULT;
+
+    flush();
+
+    std::vector<uint8_t> tmp(count);
+    ssize_t n = ::read(hfd, tmp.data(), count);
+    if (n < 0)
+        return -errno;
+
+    for (ssize_t i = 0; i < n; ++i)
+        mem.set8(buf + i, tmp[i]);
+
+    return n;
+}
+
+/**
+ * do_write() writes a guest buffer. stdout is buffered until
+ * flush_threshold bytes are pending; stderr and files are written
+ * through immediately.
+ *
+ ********************************************************************************/
+
+int32_t syscall_proxy::do_write(int32_t fd, uint32_t buf, uint32_t count)
+{
+    int hfd = host_fd(fd);
+    if (hfd < 0)
+        return -EBADF;
+    if (!check_buffer(buf, count))
+        return -EFAULT;
+
+    std::string tmp(count, '\0');
+    for (uint32_t i = 0; i < count; ++i)
+        tmp[i] = mem.get8(buf + i);
+
+    if (fd == 1)
+    {
+        stdout_buf += tmp;
+        if (stdout_buf.size() >= flush_threshold)
+            flush();
+        return count;
+    }
+
+    if (fd == 2)
+    {
+        flush();                        // keep stdout and stderr in order
+        std::cerr.write(tmp.data(), tmp.size());
+        std::cerr.flush();
+        return count;
+    }
+
+    ssize_t n = ::write(hfd, tmp.data(), tmp.size());
+    return n < 0 ? -errno : n;
+}
+
+/**
+ * do_open() opens a file below the sandbox directory. The file itself
+ * may not be a symlink; sandbox_path() checks the directories above it.
+ *
+ ********************************************************************************/
+
+int32_t syscall_proxy::do_open(uint32_t path, int32_t flags, int32_t mode)
+{
+    std::string guest_path;
+    std::string host_path;
+
+    if (!read_string(path, guest_path))
+        return -EFAULT;
+    if (!sandbox_path(guest_path, host_path))
+        return -EACCES;
+
+    int hflags = O_NOFOLLOW;
+    switch (flags & guest_o_accmode)
+    {
+    case 0: hflags |= O_RDONLY; break;
+    case 1: hflags |= O_WRONLY; break;
+    case 2: hflags |= O_RDWR; break;
+    default: return -EINVAL;
+    }
+    if (flags & guest_o_creat)
+        hflags |= O_CREAT;
+    if (flags & guest_o_excl)
+        hflags |= O_EXCL;
+    if (flags & guest_o_trunc)
+        hflags |= O_TRUNC;
+    if (flags & guest_o_append)
+        hflags |= O_APPEND;
+
+    int hfd = ::open(host_path.c_str(), hflags, mode & 0777);
+    if (hfd < 0)
+        return -errno;
+
+    for (size_t i = 3; i < fds.size(); ++i)
+    {
+        if (fds[i] < 0)
+        {
+            fds[i] = hfd;
+            return i;
+        }
+    }
+    fds.push_back(hfd);
+    return fds.size() - 1;
+}
+
+/**
+ * do_close() closes a guest file. The standard streams are left open.
+ *
+ ********************************************************************************/
+
+int32_t syscall_proxy::do_close(int32_t fd)
+{
+    int hfd = host_fd(fd);
+    if (hfd < 0)
+        return -EBADF;
+
+    if (fd > 2)
+    {
+        ::close(hfd);
+        fds[fd] = -1;
+    }
+    return 0;
+}
+
+int32_t syscall_proxy::do_lseek(int32_t fd, int32_t offset, int32_t whence)
+{
+    int hfd = host_fd(fd);
+    if (hfd < 0)
+        return -EBADF;
+    if (fd <= 2)
+        return -ESPIPE;
+
+    off_t r = ::lseek(hfd, offset, whence);
+    return r < 0 ? -errno : r;
+}
+
+/**
+ * do_brk() moves the end of the heap. The heap starts at the end of the
+ * loaded image and may grow up to the end of memory; the guest's stack
+ * is below that and it is up to the guest not to collide with it.
+ *
+ * @return The new break, or the current one if addr is 0 or out of range.
+ *
+ ********************************************************************************/
+
+int32_t syscall_proxy::do_brk(uint32_t addr)
+{
+    if (addr >= brk_start && addr <= mem.get_size())
+        brk_cur = addr;
+
+    return brk_cur;
+}
+
+/**
+ * check_buffer() is true if [addr, addr+len) lies within guest memory.
+ *
+ ********************************************************************************/
+
+bool syscall_proxy::check_buffer(uint32_t addr, uint32_t len) const
+{
+    return addr <= mem.get_size() && len <= mem.get_size() - addr;
+}
+
+/**
+ * read_string() copies a NUL-terminated guest string.
+ *
+ * @return false if the string runs off the end of memory.
+ *
+ ********************************************************************************/
+
+bool syscall_proxy::read_string(uint32_t addr, std::string &s) const
+{
+    s.clear();
+    for (; addr < mem.get_size(); ++addr)
+    {
+        char c = mem.get8(addr);
+        if (c == '\0')
+            return true;
+        s += c;
+    }
+    return false;
+}
+
+/**
+ * sandbox_path() maps a guest path to a host path below the sandbox
+ * directory. The directory the path names a file in is resolved, symlinks
+ * and all, and must still be below the sandbox.
+ *
+ * @return false if the path is empty, absolute, has a ".." component or
+ *         leads out of the sandbox through a symlink.
+ *
+ ********************************************************************************/
+
+bool syscall_proxy::sandbox_path(const std::string &path, std::string &host_path) const
+{
+    if (sandbox.empty() || path.empty() || path[0] == '/')
+        return false;
+
+    std::istringstream iss(path);
+    std::string part;
+    while (std::getline(iss, part, '/'))
+    {
+        if (part == "..")
+            return false;
+    }
+
+    host_path = sandbox + "/" + path;
+
+    char root[PATH_MAX];
+    char dir[PATH_MAX];
+    if (!realpath(sandbox.c_str(), root) || !realpath(host_path.substr(0, host_path.find_last_of('/')).c_str(), dir))
+        return false;
+
+    std::string prefix = root;
+    if (prefix.back() != '/')
+        prefix += '/';
+    return (std::string(dir) + "/").compare(0, prefix.size(), prefix) == 0;
+}
+
+/**
+ * host_fd() looks up the host fd for a guest fd.
+ *
+ * @return The host fd, or -1 if the guest fd is not open.
+ *
+ ********************************************************************************/
+
+int syscall_proxy::host_fd(int32_t fd) const
+{
+    if (fd < 0 || static_cast<size_t>(fd) >= fds.size())
+        return -1;
+    return fds[fd];
+}
@@ -0,0 +1,81 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#ifndef H_SYSCALL_PROXY
+#define H_SYSCALL_PROXY
+
+#include "hex.h"
+#include "memory.h"
+#include "registerfile.h"
+#include <iostream>
+#include <string>
+#include <vector>
+
+/**
+ * syscall_proxy carries out ECALLs on the host.
+ *
+ * The system call number is taken from a7 and the arguments from a0-a5,
+ * following the Linux/newlib RISC-V convention. The result (or -errno) is
+ * returned in a0. Files can only be opened below the sandbox directory.
+ *
+ * Guest writes to stdout are collected in a host-side buffer and written
+ * out in large pieces rather than once per call.
+ *
+ ********************************************************************************/
+
+class syscall_proxy : public hex
+{
+public:
+    syscall_proxy(memory &m, const std::string &sandbox);
+    ~syscall_proxy();
+
+    bool dispatch(registerfile &regs, std::string &comment);
+    void flush();
+
+    void set_brk(uint32_t addr) { brk_start = brk_cur = addr; }
+    bool has_exited() const { return exited; }
+    int32_t get_exit_code() const { return exit_code; }
+
+    static constexpr uint32_t sys_openat = 56;
+    static constexpr uint32_t sys_close = 57;
+    static constexpr uint32_t sys_lseek = 62;
+    static constexpr uint32_t sys_read = 63;
+    static constexpr uint32_t sys_write = 64;
+    static constexpr uint32_t sys_exit = 93;
+    static constexpr uint32_t sys_exit_group = 94;
+    static constexpr uint32_t sys_brk = 214;
+    static constexpr uint32_t sys_open = 1024;
+
+private:
+    int32_t do_read(int32_t fd, uint32_t buf, uint32_t count);
+    int32_t do_write(int32_t fd, uint32_t buf, uint32_t count);
+    int32_t do_open(uint32_t path, int32_t flags, int32_t mode);
+    int32_t do_close(int32_t fd);
+    int32_t do_lseek(int32_t fd, int32_t offset, int32_t whence);
+    int32_t do_brk(uint32_t addr);
+
+    bool check_buffer(uint32_t addr, uint32_t len) const;
+    bool read_string(uint32_t addr, std::string &s) const;
+    bool sandbox_path(const std::string &path, std::string &host_path) const;
+    int host_fd(int32_t fd) const;
+
+    static constexpr size_t flush_threshold = 64*1024;
+
+    memory &mem;
+    std::string sandbox;
+
+    std::string stdout_buf;
+    std::vector<int> fds;               ///< Host fd for each guest fd, -1 if free.
+
+    uint32_t brk_start = { 0 };
+    uint32_t brk_cur = { 0 };
+
+    bool exited = { false };
+    int32_t exit_code = { 0 };
+};
+
+#endif
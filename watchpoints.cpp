@@ -0,0 +1,155 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#include "watchpoints.h"
+#include "rv32i_asm.h"
+#include "rv32i_hart.h"
+#include <sstream>
+
+/**
+ * add() parses a -w argument.
+ *
+ * The argument is kind:addr[:len] with addr and len in hex (len defaults
+ * to 4). kind is r (any read), w (any write) or c (a write that changes
+ * the value).
+ *
+ * @param spec The watchpoint, e.g. "w:400" or "c:1000:40".
+ * @param error Set to a message when the spec cannot be parsed.
+ *
+ * @return false if the spec is not valid.
+ *
+ ********************************************************************************/
+
+bool watchpoints::add(const std::string &spec, std::string &error)
+{
+    std::istringstream iss(spec);
+    std::string k, a, l;
+    range r;
+
+    std::getline(iss, k, ':');
+    std::getline(iss, a, ':');
+    std::getline(iss, l);
+
+    if (k == "r")
+        r.k = watch_read;
+    else if (k == "w")
+        r.k = watch_write;
+    else if (k == "c")
+        r.k = watch_change;
+    else
+    {
+        error = "bad watchpoint kind '" + k + "', expected r, w or c";
+        return false;
+    }
+
+    std::istringstream as(a);
+    if (a.empty() || !(as >> std::hex >> r.addr) || !as.eof())
+    {
+        error = "bad watchpoint address '" + a + "'";
+        return false;
+    }
+
+    r.len = 4;
+    std::istringstream ls(l);
+    if (!l.empty() && (!(ls >> std::hex >> r.len) || !ls.eof() || r.len == 0))
+    {
+        error = "bad watchpoint length '" + l + "'";
+        return false;
+    }
+
+    ranges.push_back(r);
+    return true;
+}
+
+/**
+ * attach() marks the watched pages in a memory and directs hits to a hart.
+ *
+ ********************************************************************************/
+
+void watchpoints::attach(memory &m, rv32i_hart &h)
+{
+    mem = &m;
+    hart = &h;
+
+    mem->set_watcher(this);
+    for (const range &r : ranges)
+    {
+        mem->watch_pages(r.addr, r.len, r.k == watch_read ? memory::page_watch_read : memory::page_watch_write);
+    }
+}
+
+void watchpoints::on_read(uint32_t addr, uint32_t len, uint32_t val)
+{
+    if (overlaps(addr, len, watch_read))
+    {
+        std::ostringstream os;
+        os << "read m" << len*8 << "(" << hex::to_hex0x32(addr) << ") = " << hex::to_hex0x32(val);
+        hit(os.str());
+    }
+}
+
+void watchpoints::on_write(uint32_t addr, uint32_t len, uint32_t old_val, uint32_t new_val)
+{
+    if (overlaps(addr, len, watch_write) || changed(addr, len, old_val, new_val))
+    {
+        std::ostringstream os;
+        os << "write m" << len*8 << "(" << hex::to_hex0x32(addr) << ") "
+           << hex::to_hex0x32(old_val) << " -> " << hex::to_hex0x32(new_val);
+        hit(os.str());
+    }
+}
+
+/**
+ * overlaps() is true if [addr, addr+len) overlaps a watched range of kind k.
+ *
+ ********************************************************************************/
+
+bool watchpoints::overlaps(uint32_t addr, uint32_t len, kind k) const
+{
+    for (const range &r : ranges)
+    {
+        if (r.k == k && addr < r.addr + r.len && r.addr < addr + len)
+            return true;
+    }
+    return false;
+}
+
+/**
+ * changed() is true if a write changed a byte inside a change range.
+ *
+ ********************************************************************************/
+
+bool watchpoints::changed(uint32_t addr, uint32_t len, uint32_t old_val, uint32_t new_val) const
+{
+    for (uint32_t i = 0; i < len; ++i)
+    {
+        if (((old_val ^ new_val) >> (i*8)) & 0xff && overlaps(addr + i, 1, watch_change))
+            return true;
+    }
+    return false;
+}
+
+/**
+ * hit() halts the hart with the access, pc and instruction as the reason.
+ * The instruction still completes; only the first hit in it is reported.
+ *
+ ********************************************************************************/
+
+void watchpoints::hit(const std::string &access)
+{
+    if (hart->is_halted())
+        return;
+
+    uint32_t pc = hart->get_pc();
+    uint32_t insn = mem->peek32(pc);
+    if ((insn & 0x3) != 0x3)
+        insn = rv32i_asm::expand_compressed(insn & 0xffff);
+
+    hart->set_halt(true);
+    hart->set_halt_reason("Watchpoint: " + access + " by " + hex::to_hex0x32(pc) + ": "
+                          + rv32i_decode::decode(pc, insn));
+}
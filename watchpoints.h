@@ -0,0 +1,56 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#ifndef H_WATCHPOINTS
+#define H_WATCHPOINTS
+
+#include "memory.h"
+#include <string>
+#include <vector>
+
+class rv32i_hart;
+
+/**
+ * watchpoints halts a hart when it reads, writes or changes a watched
+ * address range.
+ *
+ * The pages holding the ranges are marked in the memory, which only
+ * reports accesses to those pages. Accesses to unwatched pages take
+ * the normal path.
+ *
+ ********************************************************************************/
+
+class watchpoints : public memory::watcher
+{
+public:
+    enum kind { watch_read, watch_write, watch_change };
+
+    bool add(const std::string &spec, std::string &error);
+    bool empty() const { return ranges.empty(); }
+    void attach(memory &m, rv32i_hart &h);
+
+    void on_read(uint32_t addr, uint32_t len, uint32_t val) override;
+    void on_write(uint32_t addr, uint32_t len, uint32_t old_val, uint32_t new_val) override;
+
+private:
+    struct range
+    {
+        uint32_t addr;
+        uint32_t len;
+        kind k;
+    };
+
+    bool overlaps(uint32_t addr, uint32_t len, kind k) const;
+    bool changed(uint32_t addr, uint32_t len, uint32_t old_val, uint32_t new_val) const;
+    void hit(const std::string &access);
+
+    std::vector<range> ranges;
+    memory *mem = { nullptr };
+    rv32i_hart *hart = { nullptr };
+};
+
+#endif
@@ -0,0 +1,501 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#include "workload.h"
+#include <fstream>
+#include <iostream>
+
+constexpr uint32_t workload::unbound;
+
+/**
+ * kinds() lists the workload names understood by generate().
+ *
+ * @return Returns a '|' separated list suitable for a usage message.
+ *
+ ********************************************************************************/
+
+const char *workload::kinds()
+{
+    return "alu|chase|memcpy|memset|branch|call";
+}
+
+/**
+ * generate() builds one of the synthetic benchmark programs.
+ *
+ * Every program is a flat RV32I image with its code at address 0, followed
+ * by its data and a small stack. It runs the workload's inner loop
+ * "iterations" times and then halts on an ebreak.
+ *
+ * @param kind The workload name, one of kinds().
+ * @param size Workload specific size: instructions, nodes, bytes or calls
+ *             per iteration.
+ * @param iterations Number of times the inner loop is repeated.
+ *
+ * @return false if the kind is unknown, a parameter is zero, or a branch
+ *         target is out of range.
+ *
+ ********************************************************************************/
+
+bool workload::generate(const std::string &kind, uint32_t size, uint32_t iterations)
+{
+    text.clear();
+    data.clear();
+    labels.clear();
+    fixups.clear();
+    data_base = 0;
+
+    if (size == 0 || iterations == 0)
+    {
+        return false;
+    }
+
+    if (kind == "alu")
+        return gen_alu(size, iterations);
+    else if (kind == "chase")
+        return gen_chase(size, iterations);
+    else if (kind == "memcpy")
+        return gen_memcpy(size, iterations);
+    else if (kind == "memset")
+        return gen_memset(size, iterations);
+    else if (kind == "branch")
+        return gen_branch(size, iterations);
+    else if (kind == "call")
+        return gen_call(size, iterations);
+
+    return false;
+}
+
+/**
+ * gen_alu() emits a tight loop of "size" dependent ALU operations.
+ *
+ ********************************************************************************/
+
+bool workload::gen_alu(uint32_t size, uint32_t iterations)
+{
+    emit_li(reg_t6, iterations);
+    emit_li(reg_a0, 0x12345678);
+    emit_li(reg_a1, 0x0badcafe);
+    emit_li(reg_a2, 3);
+
+    label loop = new_label();
+    bind(loop);
+    for (uint32_t i = 0; i < size; ++i)
+    {
+        switch (i % 8)
+        {
+            case 0: emit(encode_add(reg_a0, reg_a0, reg_a1)); break;
+            case 1: emit(encode_xor(reg_a1, reg_a1, reg_a0)); break;
+            case 2: emit(encode_sll(reg_a3, reg_a0, reg_a2)); break;
+            case 3: emit(encode_srli(reg_a4, reg_a1, 7)); break;
+            case 4: emit(encode_sub(reg_a0, reg_a0, reg_a4)); break;
+            case 5: emit(encode_or(reg_a1, reg_a1, reg_a3)); break;
+            case 6: emit(encode_addi(reg_a2, reg_a2, 1)); break;
+            case 7: emit(encode_and(reg_a2, reg_a2, reg_a0)); break;
+        }
+    }
+    emit(encode_addi(reg_t6, reg_t6, -1));
+    emit_branch(funct3_bne, reg_t6, reg_zero, loop);
+    emit(encode_ebreak());
+
+    return layout(0);
+}
+
+/**
+ * gen_chase() emits a pointer chase through a shuffled, circular list of
+ * "size" words. Each iteration follows the list once around.
+ *
+ ********************************************************************************/
+
+bool workload::gen_chase(uint32_t size, uint32_t iterations)
+{
+    emit_la(reg_a0, 0);
+    emit_li(reg_t6, iterations);
+
+    label outer = new_label();
+    label inner = new_label();
+    bind(outer);
+    emit_li(reg_t1, size);
+    bind(inner);
+    emit(encode_lw(reg_a0, reg_a0, 0));
+    emit(encode_addi(reg_t1, reg_t1, -1));
+    emit_branch(funct3_bne, reg_t1, reg_zero, inner);
+    emit(encode_addi(reg_t6, reg_t6, -1));
+    emit_branch(funct3_bne, reg_t6, reg_zero, outer);
+    emit(encode_ebreak());
+
+    if (!layout(size*4))
+        return false;
+
+    // Fisher-Yates shuffle of the visiting order with a fixed LCG seed, so
+    // that the same parameters always produce the same image.
+    std::vector<uint32_t> order(size);
+    for (uint32_t i = 0; i < size; ++i)
+        order[i] = i;
+
+    uint32_t seed = 0x2545f491;
+    for (uint32_t i = size-1; i > 0; --i)
+    {
+        seed = seed*1664525 + 1013904223;
+        uint32_t j = 1 + seed % i;      // keep node 0 at the head of the list
+        uint32_t t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+
+    for (uint32_t i = 0; i < size; ++i)
+    {
+        uint32_t node = order[i]*4;
+        uint32_t next = data_base + order[(i+1) % size]*4;
+        data[node+0] = next;
+        data[node+1] = next >> 8;
+        data[node+2] = next >> 16;
+        data[node+3] = next >> 24;
+    }
+    return true;
+}
+
+/**
+ * gen_memcpy() emits a word-at-a-time copy loop of "size" bytes
+ * (rounded up to a whole word) from one buffer to another.
+ *
+ ********************************************************************************/
+
+bool workload::gen_memcpy(uint32_t size, uint32_t iterations)
+{
+    size = (size+3)&0xfffffffc;
+
+    emit_la(reg_s0, 0);
+    emit_la(reg_s1, size);
+    emit_li(reg_t2, size);
+    emit_li(reg_t6, iterations);
+
+    label outer = new_label();
+    label inner = new_label();
+    bind(outer);
+    emit(encode_addi(reg_a0, reg_s0, 0));
+    emit(encode_addi(reg_a1, reg_s1, 0));
+    emit(encode_add(reg_a2, reg_a0, reg_t2));
+    bind(inner);
+    emit(encode_lw(reg_t0, reg_a0, 0));
+    emit(encode_sw(reg_t0, reg_a1, 0));
+    emit(encode_addi(reg_a0, reg_a0, 4));
+    emit(encode_addi(reg_a1, reg_a1, 4));
+    emit_branch(funct3_bne, reg_a0, reg_a2, inner);
+    emit(encode_addi(reg_t6, reg_t6, -1));
+    emit_branch(funct3_bne, reg_t6, reg_zero, outer);
+    emit(encode_ebreak());
+
+    if (!layout(size*2))
+        return false;
+
+    for (uint32_t i = 0; i < size; ++i)
+        data[i] = i*7 + 1;
+    return true;
+}
+
+/**
+ * gen_memset() emits a byte-at-a-time fill loop over a "size" byte buffer.
+ *
+ ********************************************************************************/
+
+bool workload::gen_memset(uint32_t size, uint32_t iterations)
+{
+    emit_la(reg_s0, 0);
+    emit_li(reg_t2, size);
+    emit_li(reg_t1, 0x5a);
+    emit_li(reg_t6, iterations);
+
+    label outer = new_label();
+    label inner = new_label();
+    bind(outer);
+    emit(encode_addi(reg_a0, reg_s0, 0));
+    emit(encode_add(reg_a2, reg_a0, reg_t2));
+    bind(inner);
+    emit(encode_sb(reg_t1, reg_a0, 0));
+    emit(encode_addi(reg_a0, reg_a0, 1));
+    emit_branch(funct3_bne, reg_a0, reg_a2, inner);
+    emit(encode_addi(reg_t1, reg_t1, 1));
+    emit(encode_addi(reg_t6, reg_t6, -1));
+    emit_branch(funct3_bne, reg_t6, reg_zero, outer);
+    emit(encode_ebreak());
+
+    return layout(size);
+}
+
+/**
+ * gen_branch() emits "size" data dependent conditional branches per
+ * iteration. Each one tests a different bit of a xorshift32 sequence,
+ * so the outcomes are effectively random.
+ *
+ ********************************************************************************/
+
+bool workload::gen_branch(uint32_t size, uint32_t iterations)
+{
+    emit_li(reg_t6, iterations);
+    emit_li(reg_a0, 0x2545f491);
+    emit_li(reg_a1, 0);
+
+    label loop = new_label();
+    bind(loop);
+    emit(encode_slli(reg_t0, reg_a0, 13));
+    emit(encode_xor(reg_a0, reg_a0, reg_t0));
+    emit(encode_srli(reg_t0, reg_a0, 17));
+    emit(encode_xor(reg_a0, reg_a0, reg_t0));
+    emit(encode_slli(reg_t0, reg_a0, 5));
+    emit(encode_xor(reg_a0, reg_a0, reg_t0));
+    for (uint32_t i = 0; i < size; ++i)
+    {
+        emit(encode_srli(reg_t1, reg_a0, i % XLEN));
+        emit(encode_andi(reg_t1, reg_t1, 1));
+        emit(encode_beq(reg_t1, reg_zero, 8));      // skip the increment
+        emit(encode_addi(reg_a1, reg_a1, 1));
+    }
+    emit(encode_addi(reg_t6, reg_t6, -1));
+    emit_branch(funct3_bne, reg_t6, reg_zero, loop);
+    emit(encode_ebreak());
+
+    return layout(0);
+}
+
+/**
+ * gen_call() emits "size" calls per iteration to a set of small functions.
+ * Every other callee is a non-leaf that saves ra on the stack and makes a
+ * nested call, so both direct returns and stack traffic are exercised.
+ *
+ ********************************************************************************/
+
+bool workload::gen_call(uint32_t size, uint32_t iterations)
+{
+    std::vector<label> funcs;
+    for (uint32_t i = 0; i < size; ++i)
+        funcs.push_back(new_label());
+    label leaf = new_label();
+
+    emit_la(reg_sp, stack_size);
+    emit_li(reg_t6, iterations);
+    emit_li(reg_a0, 0);
+
+    label loop = new_label();
+    bind(loop);
+    for (uint32_t i = 0; i < size; ++i)
+        emit_jal(reg_ra, funcs[i]);
+    emit(encode_addi(reg_t6, reg_t6, -1));
+    emit_branch(funct3_bne, reg_t6, reg_zero, loop);
+    emit(encode_ebreak());
+
+    for (uint32_t i = 0; i < size; ++i)
+    {
+        bind(funcs[i]);
+        if (i % 2)
+        {
+            emit(encode_addi(reg_sp, reg_sp, -16));
+            emit(encode_sw(reg_ra, reg_sp, 12));
+            emit_jal(reg_ra, leaf);
+            emit(encode_lw(reg_ra, reg_sp, 12));
+            emit(encode_addi(reg_sp, reg_sp, 16));
+        }
+        emit(encode_addi(reg_a0, reg_a0, i+1));
+        emit(encode_jalr(reg_zero, reg_ra, 0));
+    }
+
+    bind(leaf);
+    emit(encode_xori(reg_a0, reg_a0, 1));
+    emit(encode_jalr(reg_zero, reg_ra, 0));
+
+    return layout(0);
+}
+
+/**
+ * emit_li() loads a 32-bit constant into rd using addi, or lui + addi.
+ *
+ * The lui immediate is rounded so that the sign-extended addi immediate
+ * adds back the low 12 bits.
+ *
+ ********************************************************************************/
+
+void workload::emit_li(uint32_t rd, int32_t val)
+{
+    if (val >= -2048 && val < 2048)
+    {
+        emit(encode_addi(rd, reg_zero, val));
+        return;
+    }
+
+    uint32_t uval = val;
+    int32_t lo = ((uval & 0xfff) ^ 0x800) - 0x800;
+    emit(encode_lui(rd, (uval - lo) >> 12));
+    if (lo != 0)
+        emit(encode_addi(rd, rd, lo));
+}
+
+/**
+ * emit_la() loads the address of the data area plus "data_offset" into rd.
+ *
+ * The data area is placed after the code, so its address is not known
+ * yet. A lui + addi pair is emitted and patched by layout().
+ *
+ ********************************************************************************/
+
+void workload::emit_la(uint32_t rd, uint32_t data_offset)
+{
+    fixup f = { static_cast<uint32_t>(text.size()), data_offset, true };
+    fixups.push_back(f);
+    emit(encode_lui(rd, 0));
+    emit(encode_addi(rd, rd, 0));
+}
+
+/**
+ * emit_branch() emits a B-Type branch to a label that is patched by layout().
+ *
+ * A backward branch to a label more than 4 KiB away is emitted as the
+ * inverted branch over a jal to the label.
+ *
+ ********************************************************************************/
+
+void workload::emit_branch(uint32_t funct3, uint32_t rs1, uint32_t rs2, label l)
+{
+    if (labels.at(l) != unbound && here() - labels.at(l) > 4096)
+    {
+        emit(encode_btype(funct3 ^ 1, rs1, rs2, 8));
+        emit_jal(reg_zero, l);
+        return;
+    }
+
+    fixup f = { static_cast<uint32_t>(text.size()), l, false };
+    fixups.push_back(f);
+    emit(encode_btype(funct3, rs1, rs2, 0));
+}
+
+/**
+ * emit_jal() emits a jal to a label that is patched by layout().
+ *
+ ********************************************************************************/
+
+void workload::emit_jal(uint32_t rd, label l)
+{
+    fixup f = { static_cast<uint32_t>(text.size()), l, false };
+    fixups.push_back(f);
+    emit(encode_jal(rd, 0));
+}
+
+workload::label workload::new_label()
+{
+    labels.push_back(unbound);
+    return labels.size()-1;
+}
+
+void workload::bind(label l)
+{
+    labels.at(l) = here();
+}
+
+/**
+ * layout() places the data area and resolves all fixups.
+ *
+ * The data area starts at the first 16-byte boundary after the code and
+ * is "data_size" bytes long, initialized to zero. It is followed by
+ * stack_size bytes of stack.
+ *
+ * @param data_size Number of bytes of data the workload needs.
+ *
+ * @return false if a branch or jal target is out of range.
+ *
+ ********************************************************************************/
+
+bool workload::layout(uint32_t data_size)
+{
+    data_base = (here()+15)&0xfffffff0;
+    data.assign(data_size, 0);
+
+    for (const fixup &f : fixups)
+    {
+        uint32_t insn = text[f.index];
+
+        if (f.data)
+        {
+            uint32_t addr = data_base + f.target;
+            int32_t lo = ((addr & 0xfff) ^ 0x800) - 0x800;
+            text[f.index] = encode_lui(get_rd(insn), (addr - lo) >> 12);
+            text[f.index+1] = encode_addi(get_rd(insn), get_rd(insn), lo);
+        }
+        else
+        {
+            int32_t pcrel = labels.at(f.target) - f.index*4;
+            bool jal = (get_opcode(insn) == opcode_jal);
+            int32_t range = jal ? 0x100000 : 0x1000;
+
+            if (pcrel < -range || pcrel >= range)
+            {
+                std::cerr << (jal ? "Jump" : "Branch") << " at 0x" << std::hex << f.index*4
+                          << " to 0x" << labels.at(f.target) << std::dec << " is out of range." << std::endl;
+                return false;
+            }
+
+            if (jal)
+                text[f.index] = encode_jal(get_rd(insn), pcrel);
+            else
+                text[f.index] = encode_btype(get_funct3(insn), get_rs1(insn), get_rs2(insn), pcrel);
+        }
+    }
+    return true;
+}
+
+/**
+ * get_image_size() is the number of bytes save() writes.
+ *
+ ********************************************************************************/
+
+uint32_t workload::get_image_size() const
+{
+    return data_base + data.size();
+}
+
+/**
+ * get_mem_size() is the smallest memory size (-m) that holds the image
+ * and its stack.
+ *
+ ********************************************************************************/
+
+uint32_t workload::get_mem_size() const
+{
+    return (get_image_size() + stack_size + 15)&0xfffffff0;
+}
+
+/**
+ * save() writes the image, little-endian, in the flat format read by
+ * memory::load_file().
+ *
+ * @param fname The file to be written.
+ *
+ * @return false if the file cannot be written.
+ *
+ ********************************************************************************/
+
+bool workload::save(const std::string &fname) const
+{
+    std::ofstream outfile(fname, std::ios::out|std::ios::binary|std::ios::trunc);
+
+    if (outfile.is_open() == false)
+    {
+        std::cerr << "Can't open file '" << fname << "' for writing.\n";
+
+        return false;
+    }
+
+    for (uint32_t insn : text)
+    {
+        for (int i = 0; i < 4; ++i)
+            outfile.put(static_cast<char>(insn >> (8*i)));
+    }
+
+    for (uint32_t addr = here(); addr < data_base; ++addr)
+        outfile.put(0);
+
+    outfile.write(reinterpret_cast<const char*>(data.data()), data.size());
+
+    return outfile.good();
+}
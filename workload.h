@@ -0,0 +1,66 @@
+//******************************************************************
+//
+// Author: Daniel Bendik
+// RISC-V Simulator
+//
+//******************************************************************
+
+#ifndef H_WORKLOAD
+#define H_WORKLOAD
+
+#include "rv32i_asm.h"
+#include <string>
+#include <vector>
+
+class workload : public rv32i_asm
+{
+public:
+    workload() { }
+
+    bool generate(const std::string &kind, uint32_t size, uint32_t iterations);
+    bool save(const std::string &fname) const;
+
+    uint32_t get_image_size() const;
+    uint32_t get_mem_size() const;
+
+    static const char *kinds();
+
+private:
+    typedef uint32_t label;
+
+    bool gen_alu(uint32_t size, uint32_t iterations);
+    bool gen_chase(uint32_t size, uint32_t iterations);
+    bool gen_memcpy(uint32_t size, uint32_t iterations);
+    bool gen_memset(uint32_t size, uint32_t iterations);
+    bool gen_branch(uint32_t size, uint32_t iterations);
+    bool gen_call(uint32_t size, uint32_t iterations);
+
+    uint32_t here() const { return text.size()*4; }
+    void emit(uint32_t insn) { text.push_back(insn); }
+    void emit_li(uint32_t rd, int32_t val);
+    void emit_la(uint32_t rd, uint32_t data_offset);
+    void emit_branch(uint32_t funct3, uint32_t rs1, uint32_t rs2, label l);
+    void emit_jal(uint32_t rd, label l);
+
+    label new_label();
+    void bind(label l);
+    bool layout(uint32_t data_size);
+
+    struct fixup
+    {
+        uint32_t index;         ///< Index into text of the insn to patch.
+        uint32_t target;        ///< Label number, or data offset for emit_la().
+        bool data;
+    };
+
+    std::vector<uint32_t> text;
+    std::vector<uint8_t> data;
+    std::vector<uint32_t> labels;
+    std::vector<fixup> fixups;
+    uint32_t data_base = { 0 };
+
+    static constexpr uint32_t unbound = 0xffffffff;
+    static constexpr uint32_t stack_size = 0x100;
+};
+
+#endif